@@ -2,39 +2,217 @@
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFuture>
+#include <QtCore/QQueue>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QtConcurrentRun>
+
+#include <stdio.h>
+
+static void usage()
+{
+    printf("Usage: mimetypefinder [-c|-f] <file>|-\n"
+           "       mimetypefinder --bulk [-0] [--json] [--jobs <n>] [--window <n>] [-c|-f]\n"
+           "       mimetypefinder --daemon <socket>\n"
+           "\n"
+           "  -c          Use the content only\n"
+           "  -f          Use the file name only\n"
+           "  -           Read the content from stdin\n"
+           "  --bulk      Read the paths of the files from stdin, one per line,\n"
+           "              and write \"path<TAB>type\" lines in the same order\n"
+           "  -0          The paths on stdin are separated by NUL characters\n"
+           "  --json      Write {\"path\": ..., \"type\": ...} lines\n"
+           "  --jobs      Number of files looked at in parallel\n"
+           "  --window    Number of files in flight, waiting to be written in order\n"
+           "  --daemon    Answer the other invocations on the Unix socket, which they\n"
+           "              find in QT_MIME_DAEMON_SOCKET\n");
+}
+
+// The stages for one file of the bulk mode: stat, read the beginning, match.
+// Only the last one takes the lock of the database, the others run in parallel.
+static QString classify(const QMimeDatabase *db, const QByteArray &path, QMimeDatabase::MatchMode mode)
+{
+    const QString fileName = QFile::decodeName(path);
+    if (mode == QMimeDatabase::MatchExtension)
+        return db->mimeTypeForFile(fileName, mode).name();
+
+    const QFileInfo fileInfo(fileName);
+    if (fileInfo.isDir())
+        return QLatin1String("inode/directory");
+    if (!fileInfo.isFile()) // doesn't exist, or a device, fifo or socket
+        return db->mimeTypeForFile(fileName, mode).name();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return db->mimeTypeForFile(fileName, mode).name();
+    const QByteArray data = file.read(16384);
+    file.close();
+
+    if (mode == QMimeDatabase::MatchContent)
+        return db->mimeTypeForData(data).name();
+    return db->mimeTypeForFileNameAndData(fileName, data).name();
+}
+
+static bool readRecord(FILE *input, char separator, QByteArray *record)
+{
+    record->clear();
+    int c;
+    while ((c = getc(input)) != EOF) {
+        if (c == separator)
+            return true;
+        record->append(char(c));
+    }
+    return !record->isEmpty();
+}
+
+static QByteArray jsonString(const QString &string)
+{
+    QByteArray result = "\"";
+    for (int i = 0; i < string.size(); ++i) {
+        const ushort c = string.at(i).unicode();
+        switch (c) {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        default:
+            if (c < 0x20 || (c >= 0xd800 && c < 0xe000)) {
+                char escaped[7];
+                qsnprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                result += escaped;
+            } else {
+                result += QString(QChar(c)).toUtf8();
+            }
+        }
+    }
+    result += '"';
+    return result;
+}
+
+static void writeResult(const QByteArray &path, const QString &mimeType, bool json)
+{
+    QByteArray line;
+    if (json) {
+        line = "{\"path\": " + jsonString(QFile::decodeName(path))
+            + ", \"type\": " + jsonString(mimeType) + "}\n";
+    } else {
+        line = path + '\t' + mimeType.toLatin1() + '\n';
+    }
+    fwrite(line.constData(), 1, line.size(), stdout);
+}
+
+// The files are classified by the thread pool; the results are written in the
+// order of the input, with at most window files in flight.
+static int bulk(char separator, bool json, int jobs, int window, QMimeDatabase::MatchMode mode)
+{
+    QMimeDatabase db;
+    db.warmUp();
+    QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+
+    QQueue<QByteArray> paths;
+    QQueue<QFuture<QString> > results;
+    QByteArray path;
+    while (readRecord(stdin, separator, &path)) {
+        if (path.isEmpty())
+            continue;
+        if (results.size() == window)
+            writeResult(paths.dequeue(), results.dequeue().result(), json);
+        paths.enqueue(path);
+        results.enqueue(QtConcurrent::run(classify, static_cast<const QMimeDatabase *>(&db), path, mode));
+    }
+    while (!results.isEmpty())
+        writeResult(paths.dequeue(), results.dequeue().result(), json);
+    fflush(stdout);
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
 
-    if (argc <= 1) {
-        printf( "No filename specified\n" );
+    QMimeDatabase::MatchMode mode = QMimeDatabase::MatchDefault;
+    bool bulkMode = false;
+    char separator = '\n';
+    bool json = false;
+    int jobs = QThread::idealThreadCount();
+    int window = 0;
+    QString daemonSocket;
+    QString fileName;
+    for (int i = 1; i < argc; ++i) {
+        const QByteArray arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "-c") {
+            mode = QMimeDatabase::MatchContent;
+        } else if (arg == "-f") {
+            mode = QMimeDatabase::MatchExtension;
+        } else if (arg == "--bulk") {
+            bulkMode = true;
+        } else if (arg == "-0") {
+            separator = '\0';
+        } else if (arg == "--json") {
+            json = true;
+        } else if (arg == "--jobs" && hasValue) {
+            jobs = QByteArray(argv[++i]).toInt();
+        } else if (arg == "--window" && hasValue) {
+            window = QByteArray(argv[++i]).toInt();
+        } else if (arg == "--daemon" && hasValue) {
+            daemonSocket = QFile::decodeName(argv[++i]);
+        } else if (arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        } else {
+            fileName = QFile::decodeName(arg);
+        }
+    }
+
+    if (!daemonSocket.isEmpty()) {
+        // Answers the other invocations, which find it in QT_MIME_DAEMON_SOCKET
+        QMimeDatabase db;
+        QString errorMessage;
+        db.serve(daemonSocket, &errorMessage);
+        fprintf(stderr, "%s\n", qPrintable(errorMessage));
         return 1;
     }
-    QString option;
-    int fnPos = 1;
-    if (argc > 2) {
-        option = QString::fromLatin1(argv[1]);
-        ++fnPos;
+
+    if (bulkMode) {
+        jobs = qMax(jobs, 1);
+        if (window <= 0)
+            window = 4 * jobs;
+        return bulk(separator, json, jobs, window, mode);
+    }
+
+    if (fileName.isEmpty()) {
+        printf( "No filename specified\n" );
+        return 1;
     }
-    const QString fileName = QFile::decodeName(argv[fnPos]);
+
     //int accuracy;
-    QMimeDatabase db;
-    QMimeType mime;
+    QMimeDatabaseClient client;
+    QString mime;
     if (fileName == QLatin1String("-")) {
         QFile qstdin;
         qstdin.open(stdin, QIODevice::ReadOnly);
         const QByteArray data = qstdin.readAll();
-        mime = db.mimeTypeForData(data);
-    } else if (option == QLatin1String("-c")) {
-        mime = db.mimeTypeForFile(fileName, QMimeDatabase::MatchContent);
-    } else if (option == QLatin1String("-f")) {
-        mime = db.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension);
+        mime = client.mimeTypeNameForData(data);
     } else {
-        mime = db.mimeTypeForFile(fileName);
+        mime = client.mimeTypeNameForFile(fileName, mode);
     }
-    if ( mime.isValid() /*&& !mime.isDefault()*/ ) {
-        printf("%s\n", mime.name().toLatin1().constData());
+    if ( !mime.isEmpty() /*&& !mime.isDefault()*/ ) {
+        printf("%s\n", mime.toLatin1().constData());
         //printf("(accuracy %d)\n", accuracy);
     } else {
         return 1; // error
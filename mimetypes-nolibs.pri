@@ -7,6 +7,9 @@ INCLUDEPATH += $$PWD/include/QtMimeTypes
 INCLUDEPATH += $$PWD/src/mimetypes/inqt5
 INCLUDEPATH += $$PWD/src/mimetypes
 
+# Debug builds, or CONFIG+=mime_build_internal, export QMIME_AUTOTEST_EXPORT symbols
+CONFIG(debug, debug|release)|mime_build_internal: DEFINES += QMIME_BUILD_INTERNAL
+
 mac|darwin: {
     QMAKE_CXXFLAGS += -ansi
 } else:false {
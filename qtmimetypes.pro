@@ -21,6 +21,10 @@ module_tests.file = tests/tests.pro
 module_tests.target = module_tests
 module_tests.depends = module_src
 
+module_tools.file = tools/tools.pro
+module_tools.target = module_tools
+module_tools.depends = module_src
+
 module_examples.file = examples/examples.pro
 module_examples.target = module_examples
 module_examples.depends = module_src
@@ -28,4 +32,5 @@ module_examples.depends = module_src
 exists(include/include.pro): SUBDIRS += module_include
 exists(src/src.pro): SUBDIRS += module_src
 exists(tests/tests.pro): SUBDIRS += module_tests
+exists(tools/tools.pro): SUBDIRS += module_tools
 exists(examples/examples.pro): SUBDIRS += module_examples
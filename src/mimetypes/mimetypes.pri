@@ -0,0 +1,76 @@
+# Sources of the QtMimeTypes library, included by mimetypes.pro.
+
+INCLUDEPATH *= $$PWD
+DEPENDPATH *= $$PWD
+
+SOURCES += $$PWD/qmimedatabase.cpp \
+           $$PWD/qmimetype.cpp \
+           $$PWD/qmimemagicrulematcher.cpp \
+           $$PWD/qmimetypeparser.cpp \
+           $$PWD/qmimemagicrule.cpp \
+           $$PWD/qmimeglobpattern.cpp \
+           $$PWD/qmimenameindex.cpp \
+           $$PWD/qmimeprovider.cpp \
+           $$PWD/qmimestatistics.cpp \
+           $$PWD/qmimecachewriter.cpp \
+           $$PWD/qmimezipcontainer.cpp \
+           $$PWD/qmimedecompressor.cpp \
+           $$PWD/qmimememoryusage.cpp \
+           $$PWD/qmimedaemon.cpp \
+           $$PWD/qmimedetectionbudget.cpp \
+           $$PWD/qmimeglobfilter.cpp \
+           $$PWD/qmimemagicorder.cpp \
+           $$PWD/qmimemagiccorpus.cpp
+
+HEADERS += $$PWD/qmime_global.h \
+           $$PWD/qmimedatabase.h \
+           $$PWD/qmimetype.h \
+           $$PWD/qmimemagicrulematcher_p.h \
+           $$PWD/qmimetype_p.h \
+           $$PWD/qmimetypeparser_p.h \
+           $$PWD/qmimedatabase_p.h \
+           $$PWD/qmimemagicrule_p.h \
+           $$PWD/qmimeglobpattern_p.h \
+           $$PWD/qmimenameindex_p.h \
+           $$PWD/qmimeprovider_p.h \
+           $$PWD/qmimestatistics_p.h \
+           $$PWD/qmimetrace_p.h \
+           $$PWD/qmimecachewriter_p.h \
+           $$PWD/qmimezipcontainer_p.h \
+           $$PWD/qmimedecompressor_p.h \
+           $$PWD/qmimememoryusage_p.h \
+           $$PWD/qmimedaemon_p.h \
+           $$PWD/qmimedetectionbudget_p.h \
+           $$PWD/qmimeglobfilter_p.h \
+           $$PWD/qmimemagicorder_p.h \
+           $$PWD/qmimemagiccorpus_p.h
+
+SOURCES += $$PWD/inqt5/qstandardpaths.cpp
+win32: SOURCES += $$PWD/inqt5/qstandardpaths_win.cpp
+unix: {
+    macx-*: {
+        SOURCES += $$PWD/inqt5/qstandardpaths_mac.cpp
+        LIBS += -framework Carbon
+    } else {
+        SOURCES += $$PWD/inqt5/qstandardpaths_unix.cpp
+    }
+}
+
+# Decompressors for the inner type of compressed data (see qmimedecompressor.cpp).
+# zlib is used when Qt itself links the system zlib, or with CONFIG+=mime_zlib;
+# CONFIG+=mime_bzip2 and CONFIG+=mime_lzma add bzip2 and xz.
+!no_mime_zlib:if(mime_zlib|contains(QT_CONFIG, system-zlib)) {
+    DEFINES += QMIME_HAVE_ZLIB
+    LIBS += -lz
+}
+mime_bzip2 {
+    DEFINES += QMIME_HAVE_BZIP2
+    LIBS += -lbz2
+}
+mime_lzma {
+    DEFINES += QMIME_HAVE_LZMA
+    LIBS += -llzma
+}
+
+RESOURCES += \
+    $$PWD/mimetypes.qrc
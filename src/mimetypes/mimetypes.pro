@@ -27,41 +27,18 @@ QT     = core
 
 QMAKE_CXXFLAGS += -W -Wall -Wextra -Wshadow -Wnon-virtual-dtor
 
-SOURCES += qmimedatabase.cpp \
-           qmimetype.cpp \
-           qmimemagicrulematcher.cpp \
-           qmimetypeparser.cpp \
-           qmimemagicrule.cpp \
-           qmimeglobpattern.cpp \
-           qmimeprovider.cpp
+# USDT probes for perf/bpftrace/SystemTap (see qmimetrace_p.h), needs <sys/sdt.h>
+mime_usdt {
+    linux-*: DEFINES += QMIME_USDT
+    else: warning("mime_usdt is only supported on Linux, probes disabled")
+}
+
+include(mimetypes.pri)
 
 the_includes.files += qmime_global.h \
                       qmimedatabase.h \
                       qmimetype.h \
 
-HEADERS += $$the_includes.files \
-           qmimemagicrulematcher_p.h \
-           qmimetype_p.h \
-           qmimetypeparser_p.h \
-           qmimedatabase_p.h \
-           qmimemagicrule_p.h \
-           qmimeglobpattern_p.h \
-           qmimeprovider_p.h
-
-SOURCES += inqt5/qstandardpaths.cpp
-win32: SOURCES += inqt5/qstandardpaths_win.cpp
-unix: {
-    macx-*: {
-        SOURCES += inqt5/qstandardpaths_mac.cpp
-        LIBS += -framework Carbon
-    } else {
-        SOURCES += inqt5/qstandardpaths_unix.cpp
-    }
-}
-
-RESOURCES += \
-    mimetypes.qrc
-
 symbian {
     MMP_RULES += EXPORTUNFROZEN
     TARGET.UID3 = 0xEA6A790B
@@ -29,4 +29,11 @@
 #  define QMIME_EXPORT Q_DECL_IMPORT
 #endif
 
+// Like Q_AUTOTEST_EXPORT: internals the tests use, only exported from internal builds
+#if defined(QMIME_BUILD_INTERNAL)
+#  define QMIME_AUTOTEST_EXPORT QMIME_EXPORT
+#else
+#  define QMIME_AUTOTEST_EXPORT
+#endif
+
 #endif // QMIME_GLOBAL_H
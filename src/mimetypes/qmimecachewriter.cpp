@@ -0,0 +1,542 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimecachewriter_p.h"
+
+#include "qmimemagicrulematcher_p.h"
+#include "qmimetype_p.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QtAlgorithms>
+#include <QtCore/QtEndian>
+
+#include <stdio.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeCacheWriter
+
+    \brief The QMimeCacheWriter class compiles MIME package files into mime.cache.
+
+    It does what update-mime-database does for QMimeBinaryProvider: it writes
+    the "mime.cache" file (version 1.2 of the shared-mime-info cache format) and
+    the "types" file listing all MIME types. The other files generated by
+    update-mime-database are not needed, QMimeBinaryProvider reads comments and
+    glob patterns from the package files.
+
+    XML namespaces (root-XML elements) are not parsed, so the namespace list is
+    always empty.
+ */
+
+// Position of the "list offsets" values, at the beginning of the mime.cache file
+enum {
+    PosAliasListOffset = 4,
+    PosParentListOffset = 8,
+    PosLiteralListOffset = 12,
+    PosReverseSuffixTreeOffset = 16,
+    PosGlobListOffset = 20,
+    PosMagicListOffset = 24,
+    PosNamespaceListOffset = 28,
+    PosIconsListOffset = 32,
+    PosGenericIconsListOffset = 36,
+    HeaderSize = 40
+};
+
+enum { CaseSensitiveFlag = 0x100 };
+
+// The file being written; lists are reserved first and filled in afterwards, so that
+// the strings they point to can be appended in the meantime.
+class QMimeCacheBuilder
+{
+public:
+    int reserve(int size)
+    {
+        const int offset = m_data.size();
+        m_data.append(QByteArray(size, '\0'));
+        return offset;
+    }
+
+    void setUint16(int offset, quint16 value)
+    {
+        qToBigEndian(value, reinterpret_cast<uchar *>(m_data.data() + offset));
+    }
+
+    void setUint32(int offset, quint32 value)
+    {
+        qToBigEndian(value, reinterpret_cast<uchar *>(m_data.data() + offset));
+    }
+
+    int string(const QString &str)
+    {
+        const QByteArray latin1 = str.toLatin1();
+        const QHash<QByteArray, int>::const_iterator it = m_strings.constFind(latin1);
+        if (it != m_strings.constEnd())
+            return it.value();
+        const int offset = bytes(latin1 + '\0');
+        m_strings.insert(latin1, offset);
+        return offset;
+    }
+
+    int bytes(const QByteArray &data)
+    {
+        const int offset = m_data.size();
+        m_data.append(data);
+        while (m_data.size() % 4)
+            m_data.append('\0');
+        return offset;
+    }
+
+    QByteArray data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+    QHash<QByteArray, int> m_strings;
+};
+
+struct QMimeSuffixNode
+{
+    ~QMimeSuffixNode() { qDeleteAll(children); }
+
+    int count() const { return leaves.size() + children.size(); }
+
+    QList<QPair<QString, quint32> > leaves; // MIME type, weight and flags
+    QMap<uint, QMimeSuffixNode *> children; // by character, as the reader bisects them
+};
+
+static inline bool hasWildcards(const QString &pattern, int from)
+{
+    for (int i = from; i < pattern.length(); ++i) {
+        const QChar ch = pattern.at(i);
+        if (ch == QLatin1Char('*') || ch == QLatin1Char('?') || ch == QLatin1Char('['))
+            return true;
+    }
+    return false;
+}
+
+static inline quint32 weightAndFlags(const QMimeGlobPattern &glob)
+{
+    return glob.weight() | (glob.isCaseSensitive() ? CaseSensitiveFlag : 0);
+}
+
+static inline bool patternLessThan(const QMimeGlobPattern &a, const QMimeGlobPattern &b)
+{
+    return a.pattern() < b.pattern();
+}
+
+static inline bool higherPriority(const QMimeMagicRuleMatcher &a, const QMimeMagicRuleMatcher &b)
+{
+    return a.priority() > b.priority();
+}
+
+// Leaves (character 0) come first, then the children sorted by character
+static int writeSuffixNodes(QMimeCacheBuilder &builder, const QMimeSuffixNode &node)
+{
+    const int first = builder.reserve(12 * node.count());
+    int entry = first;
+    for (int i = 0; i < node.leaves.size(); ++i, entry += 12) {
+        builder.setUint32(entry, 0);
+        builder.setUint32(entry + 4, builder.string(node.leaves.at(i).first));
+        builder.setUint32(entry + 8, node.leaves.at(i).second);
+    }
+    for (QMap<uint, QMimeSuffixNode *>::const_iterator it = node.children.constBegin();
+         it != node.children.constEnd(); ++it, entry += 12) {
+        const int childrenOffset = writeSuffixNodes(builder, *it.value());
+        builder.setUint32(entry, it.key());
+        builder.setUint32(entry + 4, it.value()->count());
+        builder.setUint32(entry + 8, childrenOffset);
+    }
+    return first;
+}
+
+// A rule with sub-rules only matches if one of them does, so it has to go
+// if none of them can be written
+static bool isWritable(const QMimeMagicRule &rule)
+{
+    if (!rule.isValid())
+        return false;
+    if (rule.m_subMatches.isEmpty())
+        return true;
+    foreach (const QMimeMagicRule &subRule, rule.m_subMatches) {
+        if (isWritable(subRule))
+            return true;
+    }
+    return false;
+}
+
+template <typename T>
+static QByteArray numberMask(quint32 mask, QMimeMagicRule::Type type)
+{
+    T value(mask);
+    if (type == QMimeMagicRule::Big16 || type == QMimeMagicRule::Big32)
+        value = qToBigEndian(value);
+    else if (type == QMimeMagicRule::Little16 || type == QMimeMagicRule::Little32)
+        value = qToLittleEndian(value);
+    return QByteArray(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+// In the byte order of the value, empty if all bits count
+static QByteArray cacheMask(const QMimeMagicRule &rule)
+{
+    QByteArray mask;
+    if (rule.type() == QMimeMagicRule::String) {
+        mask = rule.matchMask();
+    } else {
+        bool ok;
+        const quint32 number = rule.mask().toUInt(&ok, 0);
+        if (!ok)
+            return QByteArray();
+        switch (rule.type()) {
+        case QMimeMagicRule::Byte:
+            mask = numberMask<quint8>(number, rule.type());
+            break;
+        case QMimeMagicRule::Big16:
+        case QMimeMagicRule::Host16:
+        case QMimeMagicRule::Little16:
+            mask = numberMask<quint16>(number, rule.type());
+            break;
+        default:
+            mask = numberMask<quint32>(number, rule.type());
+            break;
+        }
+    }
+    if (mask.count(char(-1)) == mask.size())
+        return QByteArray();
+    return mask;
+}
+
+static int writeMatchlets(QMimeCacheBuilder &builder, const QList<QMimeMagicRule> &allRules, int *count, int *maxExtent)
+{
+    QList<const QMimeMagicRule *> rules;
+    for (QList<QMimeMagicRule>::const_iterator it = allRules.constBegin(); it != allRules.constEnd(); ++it) {
+        if (isWritable(*it))
+            rules.append(&*it);
+    }
+    *count = rules.size();
+    if (rules.isEmpty())
+        return 0;
+
+    const int first = builder.reserve(32 * rules.size());
+    int entry = first;
+    foreach (const QMimeMagicRule *rule, rules) {
+        const QByteArray value = rule->matchBytes();
+        const QByteArray mask = cacheMask(*rule);
+        const int rangeLength = rule->endPos() - rule->startPos() + 1;
+        int wordSize = 1;
+        if (rule->type() == QMimeMagicRule::Host16)
+            wordSize = 2;
+        else if (rule->type() == QMimeMagicRule::Host32)
+            wordSize = 4;
+        *maxExtent = qMax(*maxExtent, rule->startPos() + rangeLength + value.size() - 1);
+
+        int childCount;
+        const int childrenOffset = writeMatchlets(builder, rule->m_subMatches, &childCount, maxExtent);
+        const int valueOffset = builder.bytes(value);
+        const int maskOffset = mask.isEmpty() ? 0 : builder.bytes(mask);
+        builder.setUint32(entry, rule->startPos());
+        builder.setUint32(entry + 4, rangeLength);
+        builder.setUint32(entry + 8, wordSize);
+        builder.setUint32(entry + 12, value.size());
+        builder.setUint32(entry + 16, valueOffset);
+        builder.setUint32(entry + 20, maskOffset);
+        builder.setUint32(entry + 24, childCount);
+        builder.setUint32(entry + 28, childrenOffset);
+        entry += 32;
+    }
+    return first;
+}
+
+static int writeStringPairs(QMimeCacheBuilder &builder, const QList<QPair<QString, QString> > &pairs)
+{
+    const int list = builder.reserve(4 + 8 * pairs.size());
+    builder.setUint32(list, pairs.size());
+    for (int i = 0; i < pairs.size(); ++i) {
+        builder.setUint32(list + 4 + 8 * i, builder.string(pairs.at(i).first));
+        builder.setUint32(list + 8 + 8 * i, builder.string(pairs.at(i).second));
+    }
+    return list;
+}
+
+static int writeGlobList(QMimeCacheBuilder &builder, const QList<QMimeGlobPattern> &globs)
+{
+    const int list = builder.reserve(4 + 12 * globs.size());
+    builder.setUint32(list, globs.size());
+    for (int i = 0; i < globs.size(); ++i) {
+        const QMimeGlobPattern &glob = globs.at(i);
+        builder.setUint32(list + 4 + 12 * i, builder.string(glob.pattern()));
+        builder.setUint32(list + 8 + 12 * i, builder.string(glob.mimeType()));
+        builder.setUint32(list + 12 + 12 * i, weightAndFlags(glob));
+    }
+    return list;
+}
+
+static bool writeFile(const QString &fileName, const QByteArray &data, QString *errorMessage)
+{
+    const QString newFileName = fileName + QLatin1String(".new");
+    QFile file(newFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || file.write(data) != data.size() || !file.flush()) {
+        if (errorMessage)
+            *errorMessage = QString::fromLatin1("Cannot write %1: %2").arg(newFileName, file.errorString());
+        file.remove();
+        return false;
+    }
+    file.close();
+#ifdef Q_OS_UNIX
+    // Replaces the file atomically, the processes which mapped the old one keep it
+    if (::rename(QFile::encodeName(newFileName).constData(), QFile::encodeName(fileName).constData()) == 0)
+        return true;
+#else
+    QFile::remove(fileName);
+    if (QFile::rename(newFileName, fileName))
+        return true;
+#endif
+    if (errorMessage)
+        *errorMessage = QString::fromLatin1("Cannot replace %1").arg(fileName);
+    QFile::remove(newFileName);
+    return false;
+}
+
+QMimeCacheWriter::QMimeCacheWriter()
+    : QMimeTypeParserBase(QStringList() << QLatin1String("en_US")) // comments are not written
+{
+}
+
+bool QMimeCacheWriter::addPackageFile(const QString &fileName, QString *errorMessage)
+{
+    QFile file(fileName);
+    QString parseError;
+    if (!file.open(QIODevice::ReadOnly)) {
+        parseError = QString::fromLatin1("Cannot open %1: %2").arg(fileName, file.errorString());
+    } else if (parse(&file, fileName, &parseError)) {
+        return true;
+    }
+    if (errorMessage)
+        *errorMessage = parseError;
+    return false;
+}
+
+bool QMimeCacheWriter::process(const QMimeType &t, QString *)
+{
+    // Several package files can define the same type
+    const QMimeTypePrivate data(t);
+    Icons &icons = m_mimeTypes[data.name];
+    if (!data.iconName.isEmpty())
+        icons.iconName = data.iconName;
+    if (!data.genericIconName.isEmpty())
+        icons.genericIconName = data.genericIconName;
+    return true;
+}
+
+bool QMimeCacheWriter::process(const QMimeGlobPattern &glob, QString *)
+{
+    m_globs.append(glob);
+    return true;
+}
+
+void QMimeCacheWriter::processParent(const QString &child, const QString &parent)
+{
+    QStringList &parents = m_parents[child];
+    if (!parents.contains(parent))
+        parents.append(parent);
+}
+
+void QMimeCacheWriter::processAlias(const QString &alias, const QString &name)
+{
+    m_aliases.insert(alias, name);
+}
+
+void QMimeCacheWriter::processMagicMatcher(const QMimeMagicRuleMatcher &matcher)
+{
+    m_magicMatchers.append(matcher);
+}
+
+void QMimeCacheWriter::processGlobDeleteAll(const QString &name)
+{
+    QMutableListIterator<QMimeGlobPattern> it(m_globs);
+    while (it.hasNext()) {
+        if (it.next().mimeType() == name)
+            it.remove();
+    }
+}
+
+QByteArray QMimeCacheWriter::cacheData() const
+{
+    QMimeCacheBuilder builder;
+    builder.reserve(HeaderSize);
+    builder.setUint16(0, 1); // major version
+    builder.setUint16(2, 2); // minor version
+
+    QList<QPair<QString, QString> > aliases;
+    for (QMap<QString, QString>::const_iterator it = m_aliases.constBegin(); it != m_aliases.constEnd(); ++it)
+        aliases.append(qMakePair(it.key(), it.value()));
+    builder.setUint32(PosAliasListOffset, writeStringPairs(builder, aliases));
+
+    const int parentList = builder.reserve(4 + 8 * m_parents.size());
+    builder.setUint32(PosParentListOffset, parentList);
+    builder.setUint32(parentList, m_parents.size());
+    int entry = parentList + 4;
+    for (QMap<QString, QStringList>::const_iterator it = m_parents.constBegin(); it != m_parents.constEnd(); ++it, entry += 8) {
+        const QStringList &parents = it.value();
+        const int parentsOffset = builder.reserve(4 + 4 * parents.size());
+        builder.setUint32(parentsOffset, parents.size());
+        for (int i = 0; i < parents.size(); ++i)
+            builder.setUint32(parentsOffset + 4 + 4 * i, builder.string(parents.at(i)));
+        builder.setUint32(entry, builder.string(it.key()));
+        builder.setUint32(entry + 4, parentsOffset);
+    }
+
+    // Same split as update-mime-database: literals, "*<suffix>" patterns in the
+    // reverse suffix tree, and everything else in the glob list
+    QList<QMimeGlobPattern> literals;
+    QList<QMimeGlobPattern> globs;
+    QMimeSuffixNode suffixRoot;
+    foreach (const QMimeGlobPattern &glob, m_globs) {
+        const QString &pattern = glob.pattern();
+        if (!hasWildcards(pattern, 0)) {
+            literals.append(glob);
+        } else if (pattern.length() > 1 && pattern.at(0) == QLatin1Char('*') && !hasWildcards(pattern, 1)) {
+            // The reader walks the tree with the lowercased file name first
+            const QString suffix = glob.isCaseSensitive() ? pattern : pattern.toLower();
+            QMimeSuffixNode *node = &suffixRoot;
+            for (int i = suffix.length() - 1; i > 0; --i) {
+                QMimeSuffixNode *&child = node->children[suffix.at(i).unicode()];
+                if (!child)
+                    child = new QMimeSuffixNode;
+                node = child;
+            }
+            const QPair<QString, quint32> leaf(glob.mimeType(), weightAndFlags(glob));
+            if (!node->leaves.contains(leaf))
+                node->leaves.append(leaf);
+        } else {
+            globs.append(glob);
+        }
+    }
+    qStableSort(literals.begin(), literals.end(), patternLessThan);
+    builder.setUint32(PosLiteralListOffset, writeGlobList(builder, literals));
+
+    const int suffixTree = builder.reserve(8);
+    builder.setUint32(PosReverseSuffixTreeOffset, suffixTree);
+    const int firstRoot = writeSuffixNodes(builder, suffixRoot);
+    builder.setUint32(suffixTree, suffixRoot.count());
+    builder.setUint32(suffixTree + 4, firstRoot);
+
+    builder.setUint32(PosGlobListOffset, writeGlobList(builder, globs));
+
+    // The reader stops at the first match, so the highest priorities go first
+    QList<QMimeMagicRuleMatcher> matchers = m_magicMatchers;
+    qStableSort(matchers.begin(), matchers.end(), higherPriority);
+    const int magicList = builder.reserve(12);
+    builder.setUint32(PosMagicListOffset, magicList);
+    const int firstMatch = builder.reserve(16 * matchers.size());
+    int maxExtent = 0;
+    int matchCount = 0;
+    entry = firstMatch;
+    foreach (const QMimeMagicRuleMatcher &matcher, matchers) {
+        int matchletCount;
+        const int matchlets = writeMatchlets(builder, matcher.magicRules(), &matchletCount, &maxExtent);
+        if (!matchletCount)
+            continue;
+        builder.setUint32(entry, matcher.priority());
+        builder.setUint32(entry + 4, builder.string(matcher.mimetype()));
+        builder.setUint32(entry + 8, matchletCount);
+        builder.setUint32(entry + 12, matchlets);
+        entry += 16;
+        ++matchCount;
+    }
+    builder.setUint32(magicList, matchCount);
+    builder.setUint32(magicList + 4, maxExtent);
+    builder.setUint32(magicList + 8, firstMatch);
+
+    const int namespaceList = builder.reserve(4);
+    builder.setUint32(PosNamespaceListOffset, namespaceList);
+
+    QList<QPair<QString, QString> > icons;
+    QList<QPair<QString, QString> > genericIcons;
+    for (QMap<QString, Icons>::const_iterator it = m_mimeTypes.constBegin(); it != m_mimeTypes.constEnd(); ++it) {
+        if (!it.value().iconName.isEmpty())
+            icons.append(qMakePair(it.key(), it.value().iconName));
+        if (!it.value().genericIconName.isEmpty())
+            genericIcons.append(qMakePair(it.key(), it.value().genericIconName));
+    }
+    builder.setUint32(PosIconsListOffset, writeStringPairs(builder, icons));
+    builder.setUint32(PosGenericIconsListOffset, writeStringPairs(builder, genericIcons));
+
+    return builder.data();
+}
+
+QByteArray QMimeCacheWriter::typesData() const
+{
+    QByteArray result;
+    for (QMap<QString, Icons>::const_iterator it = m_mimeTypes.constBegin(); it != m_mimeTypes.constEnd(); ++it) {
+        result += it.key().toLatin1();
+        result += '\n';
+    }
+    return result;
+}
+
+/*!
+    \internal
+    Compiles \a mimeDirectory/packages/*.xml into \a mimeDirectory/mime.cache and
+    \a mimeDirectory/types. Each file is replaced atomically.
+ */
+bool QMimeCacheWriter::updateMimeDirectory(const QString &mimeDirectory, QString *errorMessage)
+{
+    QMimeCacheWriter writer;
+    const QDir packageDir(mimeDirectory + QLatin1String("/packages"));
+    const QStringList files = packageDir.entryList(QStringList() << QLatin1String("*.xml"), QDir::Files, QDir::Name);
+    foreach (const QString &file, files) {
+        if (!writer.addPackageFile(packageDir.filePath(file), errorMessage))
+            return false;
+    }
+
+    // "types" first: QMimeBinaryProvider reads it again when it sees mime.cache change
+    return writeFile(mimeDirectory + QLatin1String("/types"), writer.typesData(), errorMessage)
+        && writeFile(mimeDirectory + QLatin1String("/mime.cache"), writer.cacheData(), errorMessage);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMECACHEWRITER_P_H
+#define QMIMECACHEWRITER_P_H
+
+#include "qmimetypeparser_p.h"
+
+#include <QtCore/qmap.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMimeCacheWriter : public QMimeTypeParserBase
+{
+public:
+    QMimeCacheWriter();
+
+    bool addPackageFile(const QString &fileName, QString *errorMessage);
+
+    QByteArray cacheData() const;
+    QByteArray typesData() const;
+
+    static bool updateMimeDirectory(const QString &mimeDirectory, QString *errorMessage);
+
+protected:
+    bool process(const QMimeType &t, QString *errorMessage);
+    bool process(const QMimeGlobPattern &glob, QString *errorMessage);
+    void processParent(const QString &child, const QString &parent);
+    void processAlias(const QString &alias, const QString &name);
+    void processMagicMatcher(const QMimeMagicRuleMatcher &matcher);
+    void processGlobDeleteAll(const QString &name);
+
+private:
+    struct Icons
+    {
+        QString iconName;
+        QString genericIconName;
+    };
+    // Sorted by name, which for MIME type names is also the byte order mime.cache needs
+    QMap<QString, Icons> m_mimeTypes;
+    QList<QMimeGlobPattern> m_globs;
+    QMap<QString, QStringList> m_parents;
+    QMap<QString, QString> m_aliases;
+    QList<QMimeMagicRuleMatcher> m_magicMatchers;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMECACHEWRITER_P_H
@@ -0,0 +1,891 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include <qplatformdefs.h> // always first
+
+#include "qmimedaemon_p.h"
+#include "qmimedatabase_p.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+#include <QtCore/QVarLengthArray>
+#include <QtCore/QtEndian>
+
+#ifdef Q_OS_UNIX
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/time.h>
+#  include <sys/un.h>
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <string.h>
+#  include <unistd.h>
+#endif
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeDaemonConnection
+
+    \brief The QMimeDaemonConnection class carries batches of classification
+    requests and their replies over a Unix domain socket.
+
+    Files are passed as open file descriptors, so that the daemon reads them
+    with the permissions of the client, and doesn't depend on its working
+    directory. Everywhere else than on Unix, there is never a connection.
+*/
+
+enum {
+    RequestHasFd = 0x1,
+    RequestHasData = 0x2
+};
+
+QMimeDaemonConnection::QMimeDaemonConnection(int socket)
+    : m_socket(socket)
+{
+}
+
+QMimeDaemonConnection::~QMimeDaemonConnection()
+{
+    close();
+}
+
+#ifdef Q_OS_UNIX
+
+static int qt_mime_socket()
+{
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd != -1) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+        const int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    }
+    return fd;
+}
+
+static bool qt_mime_socketAddress(const QByteArray &socketPath, sockaddr_un *address)
+{
+    memset(address, 0, sizeof(sockaddr_un));
+    if (socketPath.isEmpty() || uint(socketPath.size()) >= sizeof(address->sun_path))
+        return false;
+    address->sun_family = AF_UNIX;
+    memcpy(address->sun_path, socketPath.constData(), socketPath.size());
+    return true;
+}
+
+bool QMimeDaemonConnection::connectTo(const QByteArray &socketPath)
+{
+    close();
+    sockaddr_un address;
+    if (!qt_mime_socketAddress(socketPath, &address))
+        return false;
+    m_socket = qt_mime_socket();
+    if (m_socket == -1)
+        return false;
+    int result;
+    do {
+        result = ::connect(m_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    } while (result == -1 && errno == EINTR);
+    if (result == -1)
+        close();
+    return isValid();
+}
+
+void QMimeDaemonConnection::close()
+{
+    if (m_socket != -1) {
+        QT_CLOSE(m_socket);
+        m_socket = -1;
+    }
+}
+
+// Opens fileName for the daemon to read, without blocking on fifos
+int QMimeDaemonConnection::openFile(const QByteArray &fileName)
+{
+    int fd;
+    do {
+        fd = QT_OPEN(fileName.constData(), O_RDONLY | O_NONBLOCK | O_NOCTTY);
+    } while (fd == -1 && errno == EINTR);
+    if (fd != -1)
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+void QMimeDaemonConnection::closeFile(int fd)
+{
+    if (fd != -1)
+        QT_CLOSE(fd);
+}
+
+bool QMimeDaemonConnection::sendFrame(const QByteArray &payload, const QVector<int> &fds)
+{
+    Q_ASSERT(fds.size() <= MaxRequestsPerFrame);
+    if (!isValid() || payload.size() > MaxFrameSize)
+        return false;
+
+    QByteArray frame(4, Qt::Uninitialized);
+    qToBigEndian<quint32>(payload.size(), reinterpret_cast<uchar *>(frame.data()));
+    frame += payload;
+
+    union {
+        cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int) * MaxRequestsPerFrame)];
+    } control;
+    iovec iov;
+    iov.iov_base = frame.data();
+    iov.iov_len = frame.size();
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    if (!fds.isEmpty()) {
+        memset(&control, 0, sizeof(control));
+        message.msg_control = control.buffer;
+        message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(header), fds.constData(), sizeof(int) * fds.size());
+    }
+
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    qint64 written = 0;
+    while (written < frame.size()) {
+        // The file descriptors go with the first bytes only
+        const ssize_t result = written == 0
+            ? ::sendmsg(m_socket, &message, flags)
+            : ::send(m_socket, frame.constData() + written, frame.size() - written, flags);
+        if (result == -1) {
+            if (errno == EINTR)
+                continue;
+            close();
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+bool QMimeDaemonConnection::readFully(char *buffer, qint64 size)
+{
+    qint64 done = 0;
+    while (done < size) {
+        const ssize_t result = ::recv(m_socket, buffer + done, size - done, 0);
+        if (result == -1 && errno == EINTR)
+            continue;
+        if (result <= 0) {
+            close();
+            return false;
+        }
+        done += result;
+    }
+    return true;
+}
+
+bool QMimeDaemonConnection::receiveFrame(QByteArray &payload, QVector<int> &fds)
+{
+    payload.clear();
+    fds.clear();
+    if (!isValid())
+        return false;
+
+    uchar size[4];
+    union {
+        cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int) * MaxRequestsPerFrame)];
+    } control;
+    iovec iov;
+    iov.iov_base = size;
+    iov.iov_len = sizeof(size);
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+#ifdef MSG_CMSG_CLOEXEC
+    const int flags = MSG_CMSG_CLOEXEC;
+#else
+    const int flags = 0;
+#endif
+    ssize_t received;
+    do {
+        received = ::recvmsg(m_socket, &message, flags);
+    } while (received == -1 && errno == EINTR);
+    if (received <= 0) {
+        close();
+        return false;
+    }
+    for (cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+            continue;
+        const int count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const int offset = fds.size();
+        fds.resize(offset + count);
+        memcpy(fds.data() + offset, CMSG_DATA(header), sizeof(int) * count);
+    }
+#ifndef MSG_CMSG_CLOEXEC
+    foreach (int fd, fds)
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+
+    bool ok = !(message.msg_flags & MSG_CTRUNC)
+        && readFully(reinterpret_cast<char *>(size) + received, sizeof(size) - received);
+    if (ok) {
+        const quint32 payloadSize = qFromBigEndian<quint32>(size);
+        ok = payloadSize <= quint32(MaxFrameSize);
+        if (ok) {
+            payload.resize(payloadSize);
+            ok = readFully(payload.data(), payloadSize);
+        }
+    }
+    if (!ok) {
+        foreach (int fd, fds)
+            closeFile(fd);
+        fds.clear();
+        payload.clear();
+        close();
+    }
+    return ok;
+}
+
+#else // Q_OS_UNIX
+
+bool QMimeDaemonConnection::connectTo(const QByteArray &)
+{
+    return false;
+}
+
+void QMimeDaemonConnection::close()
+{
+    m_socket = -1;
+}
+
+int QMimeDaemonConnection::openFile(const QByteArray &)
+{
+    return -1;
+}
+
+void QMimeDaemonConnection::closeFile(int)
+{
+}
+
+bool QMimeDaemonConnection::sendFrame(const QByteArray &, const QVector<int> &)
+{
+    return false;
+}
+
+bool QMimeDaemonConnection::readFully(char *, qint64)
+{
+    return false;
+}
+
+bool QMimeDaemonConnection::receiveFrame(QByteArray &, QVector<int> &)
+{
+    return false;
+}
+
+#endif // Q_OS_UNIX
+
+bool QMimeDaemonConnection::sendRequests(const QList<QMimeDaemonRequest> &requests)
+{
+    QByteArray payload;
+    QVector<int> fds;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream << quint32(ProtocolVersion) << quint32(requests.size());
+    foreach (const QMimeDaemonRequest &request, requests) {
+        quint8 flags = 0;
+        if (request.fd != -1) {
+            flags |= RequestHasFd;
+            fds.append(request.fd);
+        }
+        if (request.hasData)
+            flags |= RequestHasData;
+        stream << quint8(request.mode) << flags << request.fileName;
+        if (request.hasData)
+            stream << request.data;
+    }
+    return sendFrame(payload, fds);
+}
+
+// The file descriptors of the requests are the caller's to close, even on failure
+bool QMimeDaemonConnection::receiveRequests(QList<QMimeDaemonRequest> &requests)
+{
+    requests.clear();
+    QByteArray payload;
+    QVector<int> fds;
+    if (!receiveFrame(payload, fds))
+        return false;
+
+    QDataStream stream(payload);
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> version >> count;
+    bool ok = version == ProtocolVersion && count <= quint32(MaxRequestsPerFrame);
+    int nextFd = 0;
+    for (quint32 i = 0; ok && i < count; ++i) {
+        QMimeDaemonRequest request;
+        quint8 mode = 0;
+        quint8 flags = 0;
+        stream >> mode >> flags >> request.fileName;
+        if (flags & RequestHasData) {
+            stream >> request.data;
+            request.hasData = true;
+        }
+        if (flags & RequestHasFd) {
+            if (nextFd == fds.size()) {
+                ok = false;
+                break;
+            }
+            request.fd = fds.at(nextFd++);
+        }
+        ok = stream.status() == QDataStream::Ok && mode <= QMimeDatabase::MatchContent;
+        request.mode = QMimeDatabase::MatchMode(mode);
+        requests.append(request);
+    }
+    // Descriptors no request claimed would leak
+    for (int i = nextFd; i < fds.size(); ++i)
+        closeFile(fds.at(i));
+    if (!ok)
+        close();
+    return ok;
+}
+
+bool QMimeDaemonConnection::sendReplies(const QList<QByteArray> &mimeTypeNames)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream << quint32(mimeTypeNames.size());
+    foreach (const QByteArray &name, mimeTypeNames)
+        stream << name;
+    return sendFrame(payload, QVector<int>());
+}
+
+bool QMimeDaemonConnection::receiveReplies(QList<QByteArray> &mimeTypeNames)
+{
+    mimeTypeNames.clear();
+    QByteArray payload;
+    QVector<int> fds;
+    if (!receiveFrame(payload, fds))
+        return false;
+    foreach (int fd, fds)
+        closeFile(fd);
+
+    QDataStream stream(payload);
+    quint32 count = 0;
+    stream >> count;
+    bool ok = fds.isEmpty() && count <= quint32(MaxRequestsPerFrame);
+    for (quint32 i = 0; ok && i < count; ++i) {
+        QByteArray name;
+        stream >> name;
+        ok = stream.status() == QDataStream::Ok;
+        mimeTypeNames.append(name);
+    }
+    if (!ok) {
+        mimeTypeNames.clear();
+        close();
+    }
+    return ok;
+}
+
+/*!
+    \internal
+    \class QMimeDaemonServer
+
+    \brief The QMimeDaemonServer class answers the requests of QMimeDatabaseClient
+    objects with one loaded database.
+
+    exec() polls the listening socket and the idle connections, and hands each
+    connection with a frame to read to a worker thread, which answers that one
+    frame and gives the connection back. A client that stops sending in the
+    middle of a frame only holds up its worker, for the receive timeout at most.
+*/
+
+class QMimeDaemonServer::ServeJob : public QRunnable
+{
+public:
+    ServeJob(QMimeDaemonServer *server, QMimeDaemonConnection *connection)
+        : m_server(server), m_connection(connection) {}
+
+    virtual void run()
+    {
+        m_server->serve(m_connection);
+    }
+
+private:
+    QMimeDaemonServer *m_server;
+    QMimeDaemonConnection *m_connection;
+};
+
+QMimeDaemonServer::QMimeDaemonServer(const QMimeDatabase *database)
+    : m_database(database), m_socket(-1)
+{
+    m_wakeUpPipe[0] = -1;
+    m_wakeUpPipe[1] = -1;
+    m_workers.setMaxThreadCount(qMax(4, QThread::idealThreadCount()));
+}
+
+QMimeDaemonServer::~QMimeDaemonServer()
+{
+    m_workers.waitForDone();
+    qDeleteAll(m_idle);
+    qDeleteAll(m_released);
+    for (int i = 0; i < 2; ++i) {
+        if (m_wakeUpPipe[i] != -1)
+            QT_CLOSE(m_wakeUpPipe[i]);
+    }
+    if (m_socket != -1)
+        QT_CLOSE(m_socket);
+}
+
+// Answers one frame of the connection, then gives it back to exec(), or deletes it if it is done
+void QMimeDaemonServer::serve(QMimeDaemonConnection *connection)
+{
+    QList<QMimeDaemonRequest> requests;
+    const bool received = connection->receiveRequests(requests);
+    QList<QByteArray> mimeTypeNames;
+    foreach (const QMimeDaemonRequest &request, requests) {
+        // What came with a frame that didn't make sense is only closed
+        if (received)
+            mimeTypeNames.append(classify(request).name().toLatin1());
+        QMimeDaemonConnection::closeFile(request.fd);
+    }
+    if (!received || !connection->sendReplies(mimeTypeNames)) {
+        delete connection;
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_releasedMutex);
+        m_released.append(connection);
+    }
+#ifdef Q_OS_UNIX
+    // If the pipe is full, exec() has a wake-up pending already
+    const char wakeUp = 0;
+    const ssize_t written = QT_WRITE(m_wakeUpPipe[1], &wakeUp, 1);
+    Q_UNUSED(written);
+#endif
+}
+
+#ifdef Q_OS_UNIX
+
+static void qt_mime_setNonBlocking(int fd, bool nonBlocking)
+{
+    const int flags = ::fcntl(fd, F_GETFL);
+    if (flags != -1)
+        ::fcntl(fd, F_SETFL, nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+}
+
+bool QMimeDaemonServer::listen(const QByteArray &socketPath, QString *errorMessage)
+{
+    sockaddr_un address;
+    if (!qt_mime_socketAddress(socketPath, &address)) {
+        *errorMessage = QString::fromLatin1("Invalid socket path %1").arg(QFile::decodeName(socketPath));
+        return false;
+    }
+    // A socket left behind by a daemon that is gone can be replaced, a live one not
+    QMimeDaemonConnection probe;
+    if (probe.connectTo(socketPath)) {
+        *errorMessage = QString::fromLatin1("A daemon is already listening on %1").arg(QFile::decodeName(socketPath));
+        return false;
+    }
+    ::unlink(socketPath.constData());
+
+    m_socket = qt_mime_socket();
+    if (m_socket == -1
+            || ::bind(m_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1
+            || ::listen(m_socket, SOMAXCONN) == -1) {
+        *errorMessage = QString::fromLatin1("Cannot listen on %1: %2").arg(QFile::decodeName(socketPath),
+                                                                         QString::fromLocal8Bit(strerror(errno)));
+        if (m_socket != -1)
+            QT_CLOSE(m_socket);
+        m_socket = -1;
+        return false;
+    }
+    // exec() only accepts when poll() says so, but the client can be gone by then
+    qt_mime_setNonBlocking(m_socket, true);
+
+    if (::pipe(m_wakeUpPipe) == -1) {
+        *errorMessage = QString::fromLatin1("Cannot create a pipe: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        m_wakeUpPipe[0] = -1;
+        m_wakeUpPipe[1] = -1;
+        return false;
+    }
+    for (int i = 0; i < 2; ++i) {
+        ::fcntl(m_wakeUpPipe[i], F_SETFD, FD_CLOEXEC);
+        qt_mime_setNonBlocking(m_wakeUpPipe[i], true);
+    }
+    return true;
+}
+
+// Returns false if accepting again right away would fail the same way
+bool QMimeDaemonServer::acceptConnection()
+{
+    int socket;
+    do {
+        socket = ::accept(m_socket, 0, 0);
+    } while (socket == -1 && errno == EINTR);
+    if (socket == -1)
+        return errno != EMFILE && errno != ENFILE && errno != ENOBUFS && errno != ENOMEM;
+
+    ::fcntl(socket, F_SETFD, FD_CLOEXEC);
+    // Inherited from the listening socket on BSD; the workers want blocking reads
+    qt_mime_setNonBlocking(socket, false);
+    timeval timeout;
+    timeout.tv_sec = 10;
+    timeout.tv_usec = 0;
+    ::setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    m_idle.append(new QMimeDaemonConnection(socket));
+    return true;
+}
+
+void QMimeDaemonServer::exec()
+{
+    enum { ListeningSocket, WakeUpPipe, FirstConnection };
+
+    QVarLengthArray<pollfd, 64> fds;
+    bool acceptPaused = false;
+    QElapsedTimer acceptPause;
+    forever {
+        int timeout = -1;
+        if (acceptPaused) {
+            timeout = AcceptRetryDelay - int(acceptPause.elapsed());
+            if (timeout <= 0) {
+                acceptPaused = false;
+                timeout = -1;
+            }
+        }
+
+        fds.resize(FirstConnection + m_idle.size());
+        // poll() skips negative descriptors
+        fds[ListeningSocket].fd = acceptPaused ? -1 : m_socket;
+        fds[WakeUpPipe].fd = m_wakeUpPipe[0];
+        for (int i = 0; i < m_idle.size(); ++i)
+            fds[FirstConnection + i].fd = m_idle.at(i)->socketDescriptor();
+        for (int i = 0; i < fds.size(); ++i) {
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+
+        if (::poll(fds.data(), fds.size(), timeout) == -1) {
+            if (errno != EINTR)
+                ::usleep(AcceptRetryDelay * 1000);
+            continue;
+        }
+
+        // A hang-up goes to a worker too, which finds out and deletes the connection
+        for (int i = fds.size() - 1; i >= FirstConnection; --i) {
+            if (fds[i].revents)
+                m_workers.start(new ServeJob(this, m_idle.takeAt(i - FirstConnection)));
+        }
+
+        if (fds[WakeUpPipe].revents) {
+            char buffer[64];
+            while (QT_READ(m_wakeUpPipe[0], buffer, sizeof(buffer)) > 0) {}
+            QMutexLocker locker(&m_releasedMutex);
+            m_idle += m_released;
+            m_released.clear();
+        }
+
+        if (fds[ListeningSocket].revents && !acceptConnection()) {
+            // The listening socket stays readable: wait for descriptors to be closed
+            acceptPaused = true;
+            acceptPause.start();
+        }
+    }
+}
+
+// Like mimeTypeForFileInfo() in qmimedatabase.cpp, on the file the client opened if it could;
+// the request has the absolute path of the file
+QMimeType QMimeDaemonServer::classifyFile(const QMimeDaemonRequest &request) const
+{
+    const QByteArray &path = request.fileName;
+    QT_STATBUF statBuffer;
+    // QFileInfo::isDir() follows symbolic links
+    const int statResult = request.fd != -1 ? QT_FSTAT(request.fd, &statBuffer)
+                                            : QT_STAT(path.constData(), &statBuffer);
+    if (statResult == 0 && S_ISDIR(statBuffer.st_mode))
+        return m_database->mimeTypeForName(QLatin1String("inode/directory"));
+    // The special files don't
+    if (QT_LSTAT(path.constData(), &statBuffer) == 0) {
+        if (S_ISCHR(statBuffer.st_mode))
+            return m_database->mimeTypeForName(QLatin1String("inode/chardevice"));
+        if (S_ISBLK(statBuffer.st_mode))
+            return m_database->mimeTypeForName(QLatin1String("inode/blockdevice"));
+        if (S_ISFIFO(statBuffer.st_mode))
+            return m_database->mimeTypeForName(QLatin1String("inode/fifo"));
+        if (S_ISSOCK(statBuffer.st_mode))
+            return m_database->mimeTypeForName(QLatin1String("inode/socket"));
+    }
+
+    QFile file;
+    if (request.fd != -1)
+        file.open(request.fd, QIODevice::ReadOnly);
+    if (request.mode == QMimeDatabase::MatchContent) {
+        if (file.isOpen())
+            return m_database->mimeTypeForData(&file);
+        return m_database->mimeTypeForName(QMimeDatabasePrivate::get(m_database)->defaultMimeType());
+    }
+    return m_database->mimeTypeForFileNameAndData(QFile::decodeName(path), &file);
+}
+
+#else // Q_OS_UNIX
+
+bool QMimeDaemonServer::listen(const QByteArray &, QString *errorMessage)
+{
+    *errorMessage = QString::fromLatin1("The MIME database daemon needs Unix domain sockets");
+    return false;
+}
+
+void QMimeDaemonServer::exec()
+{
+}
+
+QMimeType QMimeDaemonServer::classifyFile(const QMimeDaemonRequest &request) const
+{
+    return m_database->mimeTypeForFile(QFile::decodeName(request.fileName), request.mode);
+}
+
+#endif // Q_OS_UNIX
+
+QMimeType QMimeDaemonServer::classify(const QMimeDaemonRequest &request) const
+{
+    if (request.mode == QMimeDatabase::MatchExtension)
+        return m_database->mimeTypeForFileName(request.fileName);
+    if (request.hasData) {
+        if (request.mode == QMimeDatabase::MatchContent)
+            return m_database->mimeTypeForData(request.data);
+        return m_database->mimeTypeForFileNameAndData(QFile::decodeName(request.fileName), request.data);
+    }
+    // Also when the client couldn't open the file
+    return classifyFile(request);
+}
+
+class QMimeDatabaseClientPrivate
+{
+public:
+    QMimeDatabaseClientPrivate() : database(0) {}
+    ~QMimeDatabaseClientPrivate() { delete database; }
+
+    QMimeDatabase *fallback();
+    QStringList classify(const QList<QMimeDaemonRequest> &requests);
+
+    QMimeDaemonConnection connection;
+    QMimeDatabase *database; // in-process, created when the daemon doesn't answer
+};
+
+QMimeDatabase *QMimeDatabaseClientPrivate::fallback()
+{
+    if (!database)
+        database = new QMimeDatabase;
+    return database;
+}
+
+// Asks the daemon, and does in-process what it didn't answer
+QStringList QMimeDatabaseClientPrivate::classify(const QList<QMimeDaemonRequest> &requests)
+{
+    QStringList result;
+    result.reserve(requests.size());
+    while (result.size() < requests.size() && connection.isValid()) {
+        const QList<QMimeDaemonRequest> batch = requests.mid(result.size(), QMimeDaemonConnection::MaxRequestsPerFrame);
+        QList<QByteArray> mimeTypeNames;
+        if (!connection.sendRequests(batch) || !connection.receiveReplies(mimeTypeNames)
+                || mimeTypeNames.size() != batch.size()) {
+            connection.close();
+            break;
+        }
+        foreach (const QByteArray &name, mimeTypeNames)
+            result.append(QString::fromLatin1(name));
+    }
+
+    for (int i = result.size(); i < requests.size(); ++i) {
+        const QMimeDaemonRequest &request = requests.at(i);
+        const QString fileName = QFile::decodeName(request.fileName);
+        QMimeDatabase *db = fallback();
+        if (!request.hasData)
+            result.append(db->mimeTypeForFile(fileName, request.mode).name());
+        else if (request.mode == QMimeDatabase::MatchContent)
+            result.append(db->mimeTypeForData(request.data).name());
+        else
+            result.append(db->mimeTypeForFileNameAndData(fileName, request.data).name());
+    }
+    return result;
+}
+
+/*!
+    \class QMimeDatabaseClient
+    \brief The QMimeDatabaseClient class finds MIME types with the help of a
+    daemon, so that short-lived processes don't load the MIME database.
+
+    The daemon is a process calling QMimeDatabase::serve(), for instance
+    \c{mimetypefinder --daemon}. It keeps its database loaded, and answers
+    batches of requests over a Unix domain socket. The files to look into are
+    opened by the client, and passed to the daemon as file descriptors.
+
+    When there is no daemon, or it goes away, the client falls back to a
+    QMimeDatabase of its own, with the same results.
+
+    Only the names of the MIME types are returned: a QMimeType would need the
+    database in this process.
+
+    \sa QMimeDatabase::serve()
+*/
+
+/*!
+    Creates a client of the daemon listening on \a socketPath, or on the path
+    in the environment variable QT_MIME_DAEMON_SOCKET if \a socketPath is empty.
+*/
+QMimeDatabaseClient::QMimeDatabaseClient(const QString &socketPath)
+    : d(new QMimeDatabaseClientPrivate)
+{
+    const QByteArray path = socketPath.isEmpty() ? qgetenv("QT_MIME_DAEMON_SOCKET") : QFile::encodeName(socketPath);
+    if (!path.isEmpty())
+        d->connection.connectTo(path);
+}
+
+/*!
+    Destroys the client.
+*/
+QMimeDatabaseClient::~QMimeDatabaseClient()
+{
+    delete d;
+}
+
+/*!
+    Returns true if the requests go to the daemon, false if they are answered
+    in this process.
+*/
+bool QMimeDatabaseClient::isConnected() const
+{
+    return d->connection.isValid();
+}
+
+// The file is only opened for a daemon to look into
+static QMimeDaemonRequest fileRequest(const QString &fileName, QMimeDatabase::MatchMode mode, bool forDaemon)
+{
+    QMimeDaemonRequest request;
+    request.mode = mode;
+    request.fileName = QFile::encodeName(fileName);
+    if (forDaemon && mode != QMimeDatabase::MatchExtension) {
+        // The daemon has a working directory of its own
+        request.fileName = QFile::encodeName(QFileInfo(fileName).absoluteFilePath());
+        request.fd = QMimeDaemonConnection::openFile(request.fileName);
+    }
+    return request;
+}
+
+/*!
+    Returns the name of the MIME type of the file named \a fileName, using
+    \a mode like QMimeDatabase::mimeTypeForFile() does.
+*/
+QString QMimeDatabaseClient::mimeTypeNameForFile(const QString &fileName, QMimeDatabase::MatchMode mode)
+{
+    return mimeTypeNamesForFiles(QStringList() << fileName, mode).first();
+}
+
+/*!
+    Returns the names of the MIME types of the files named \a fileNames, in the
+    same order, using \a mode like QMimeDatabase::mimeTypeForFile() does.
+
+    The files are sent to the daemon in batches.
+*/
+QStringList QMimeDatabaseClient::mimeTypeNamesForFiles(const QStringList &fileNames, QMimeDatabase::MatchMode mode)
+{
+    QStringList result;
+    result.reserve(fileNames.size());
+    QList<QMimeDaemonRequest> requests;
+    for (int start = 0; start < fileNames.size(); start += QMimeDaemonConnection::MaxRequestsPerFrame) {
+        // Only one batch of files is open at a time
+        const int end = qMin(fileNames.size(), start + int(QMimeDaemonConnection::MaxRequestsPerFrame));
+        requests.clear();
+        for (int i = start; i < end; ++i)
+            requests.append(fileRequest(fileNames.at(i), mode, d->connection.isValid()));
+        result += d->classify(requests);
+        foreach (const QMimeDaemonRequest &request, requests)
+            QMimeDaemonConnection::closeFile(request.fd);
+    }
+    return result;
+}
+
+/*!
+    Returns the name of the MIME type of \a data, like
+    QMimeDatabase::mimeTypeForData() does.
+*/
+QString QMimeDatabaseClient::mimeTypeNameForData(const QByteArray &data)
+{
+    QMimeDaemonRequest request;
+    request.mode = QMimeDatabase::MatchContent;
+    request.data = data;
+    request.hasData = true;
+    return d->classify(QList<QMimeDaemonRequest>() << request).first();
+}
+
+/*!
+    Returns the name of the MIME type for \a fileName and its content \a data,
+    like QMimeDatabase::mimeTypeForFileNameAndData() does.
+*/
+QString QMimeDatabaseClient::mimeTypeNameForFileNameAndData(const QString &fileName, const QByteArray &data)
+{
+    QMimeDaemonRequest request;
+    request.fileName = QFile::encodeName(fileName);
+    request.data = data;
+    request.hasData = true;
+    return d->classify(QList<QMimeDaemonRequest>() << request).first();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,147 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEDAEMON_P_H
+#define QMIMEDAEMON_P_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qvector.h>
+
+#include "qmimedatabase.h"
+
+QT_BEGIN_NAMESPACE
+
+// One file or buffer to classify, as sent by QMimeDatabaseClient to QMimeDatabase::serve()
+struct QMimeDaemonRequest
+{
+    QMimeDaemonRequest()
+        : mode(QMimeDatabase::MatchDefault), fd(-1), hasData(false)
+    {}
+
+    QMimeDatabase::MatchMode mode;
+    QByteArray fileName; // QFile::encodeName(), can be empty for data
+    int fd;              // open on the file, -1 if none; closed by whoever created the request
+    QByteArray data;     // the content, when given by the caller instead of a file
+    bool hasData;
+};
+
+/*
+   A connection to the daemon, on either side of the socket.
+
+   A frame is the 32-bit big-endian size of its payload, then the payload
+   written with QDataStream; the file descriptors of a request frame travel
+   as SCM_RIGHTS with its first bytes. A reply has one MIME type name per
+   request, in the same order.
+ */
+class QMimeDaemonConnection
+{
+public:
+    enum {
+        ProtocolVersion = 1,
+        MaxRequestsPerFrame = 128, // each can carry a file descriptor
+        MaxFrameSize = 64 * 1024 * 1024
+    };
+
+    explicit QMimeDaemonConnection(int socket = -1);
+    ~QMimeDaemonConnection();
+
+    bool connectTo(const QByteArray &socketPath);
+    void close();
+    inline bool isValid() const { return m_socket != -1; }
+    inline int socketDescriptor() const { return m_socket; }
+
+    bool sendRequests(const QList<QMimeDaemonRequest> &requests);
+    bool receiveRequests(QList<QMimeDaemonRequest> &requests);
+    bool sendReplies(const QList<QByteArray> &mimeTypeNames);
+    bool receiveReplies(QList<QByteArray> &mimeTypeNames);
+
+    static int openFile(const QByteArray &fileName);
+    static void closeFile(int fd);
+
+private:
+    Q_DISABLE_COPY(QMimeDaemonConnection)
+
+    bool sendFrame(const QByteArray &payload, const QVector<int> &fds);
+    bool receiveFrame(QByteArray &payload, QVector<int> &fds);
+    bool readFully(char *buffer, qint64 size);
+
+    int m_socket;
+};
+
+// Answers the requests of the clients; idle connections are polled, frames served by workers
+class QMimeDaemonServer
+{
+public:
+    enum {
+        AcceptRetryDelay = 100 // ms, when accept() runs out of descriptors or memory
+    };
+
+    explicit QMimeDaemonServer(const QMimeDatabase *database);
+    ~QMimeDaemonServer();
+
+    bool listen(const QByteArray &socketPath, QString *errorMessage);
+    void exec();
+
+private:
+    Q_DISABLE_COPY(QMimeDaemonServer)
+
+    class ServeJob;
+
+    bool acceptConnection();
+    void serve(QMimeDaemonConnection *connection);
+    QMimeType classify(const QMimeDaemonRequest &request) const;
+    QMimeType classifyFile(const QMimeDaemonRequest &request) const;
+
+    const QMimeDatabase *m_database;
+    int m_socket;
+    int m_wakeUpPipe[2]; // written by the workers when they give a connection back
+    QList<QMimeDaemonConnection *> m_idle; // waiting for their next frame, only used by exec()
+    QMutex m_releasedMutex;
+    QList<QMimeDaemonConnection *> m_released; // served, not yet polled again
+    QThreadPool m_workers;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEDAEMON_P_H
@@ -45,8 +45,19 @@
 
 #include "qmimedatabase_p.h"
 
+#include "qmimecachewriter_p.h"
+#include "qmimedaemon_p.h"
+
 #include "qmimeprovider_p.h"
+#include "qmimestatistics_p.h"
+#include "qmimetrace_p.h"
+#include "qmimedecompressor_p.h"
+#include "qmimedetectionbudget_p.h"
+#include "qmimememoryusage_p.h"
 #include "qmimetype_p.h"
+#include "qmimezipcontainer_p.h"
+
+#include <qstandardpaths.h>
 
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
@@ -61,6 +72,13 @@
 
 QT_BEGIN_NAMESPACE
 
+#ifdef QMIME_USDT
+#define QMIME_DEFINE_TRACE_SEMAPHORE(probe) \
+    unsigned short QMIME_TRACE_SEMAPHORE(probe) __attribute__((section(".probes"), used)) = 0;
+QMIME_TRACEPOINTS(QMIME_DEFINE_TRACE_SEMAPHORE)
+#undef QMIME_DEFINE_TRACE_SEMAPHORE
+#endif
+
 bool qt_isQMimeDatabaseDebuggingActivated (false);
 
 #ifndef QT_NO_DEBUG_OUTPUT
@@ -76,18 +94,40 @@ QMimeDatabasePrivate *QMimeDatabasePrivate::instance()
     return staticQMimeDatabase();
 }
 
-QMimeDatabasePrivate::QMimeDatabasePrivate()
-    : m_provider(0), m_defaultMimeType(QLatin1String("application/octet-stream"))
+QMimeDatabasePrivate::QMimeDatabasePrivate(const QStringList &mimeDirectories)
+    : m_provider(0), m_base(0), m_overlay(0),
+      m_defaultMimeType(QLatin1String("application/octet-stream")),
+      m_mimeDirectories(mimeDirectories),
+      m_detectionFlags(QMimeDatabase::NoDetectionFlags)
+{
+}
+
+QMimeDatabasePrivate::QMimeDatabasePrivate(QMimeDatabasePrivate *base)
+    : m_provider(0), m_base(base), m_overlay(0),
+      m_defaultMimeType(QLatin1String("application/octet-stream")),
+      m_detectionFlags(QMimeDatabase::NoDetectionFlags)
 {
 }
 
 QMimeDatabasePrivate::~QMimeDatabasePrivate()
 {
+    delete m_overlay;
+    m_overlay = 0;
     delete m_provider;
     m_provider = 0;
 }
 
 QMimeProviderBase *QMimeDatabasePrivate::provider()
+{
+    // A tenant always goes through its overlay, which locks the shared database
+    if (!m_overlay && m_base)
+        m_overlay = new QMimeOverlayProvider(this, m_base);
+    if (m_overlay)
+        return m_overlay;
+    return baseProvider();
+}
+
+QMimeProviderBase *QMimeDatabasePrivate::baseProvider()
 {
     if (!m_provider) {
         QMimeProviderBase *binaryProvider = new QMimeBinaryProvider(this);
@@ -107,13 +147,118 @@ void QMimeDatabasePrivate::setProvider(QMimeProviderBase *theProvider)
     m_provider = theProvider;
 }
 
+bool QMimeDatabasePrivate::registerMimeTypes(QIODevice *device, QString *errorMessage)
+{
+    if (!m_overlay)
+        m_overlay = new QMimeOverlayProvider(this, m_base);
+    return m_overlay->registerMimeTypes(device, errorMessage);
+}
+
+void qmime_resetProvider()
+{
+    QMimeDatabasePrivate *d = QMimeDatabasePrivate::instance();
+    QMutexLocker locker(&d->mutex);
+    d->setProvider(0);
+}
+
+QStringList qmime_adaptiveMagicOrder(const QMimeDatabase &database)
+{
+    QMimeDatabasePrivate *d = QMimeDatabasePrivate::get(&database);
+    QMutexLocker locker(&d->mutex);
+    return d->provider()->adaptiveMagicOrder();
+}
+
+/*!
+    \internal
+    Returns the mime directories to search, most important first: the XDG data
+    directories, or the explicit ones. Resolved once, until clearLocateCache().
+    Called with m_locateMutex locked.
+ */
+const QList<QMimeDatabasePrivate::SearchPath> &QMimeDatabasePrivate::searchPaths() const
+{
+    if (m_searchPaths.isEmpty()) {
+        if (m_mimeDirectories.isEmpty()) {
+            foreach (const QString &dataDir, QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation))
+                m_searchPaths.append(SearchPath(dataDir + QLatin1String("/mime"), QString()));
+        } else {
+            foreach (const QString &entry, m_mimeDirectories) {
+                const QFileInfo entryInfo(entry);
+                if (entryInfo.isFile()) // a mime.cache, the other files are next to it
+                    m_searchPaths.append(SearchPath(entryInfo.path(), entry));
+                else
+                    m_searchPaths.append(SearchPath(entry, QString()));
+            }
+        }
+    }
+    return m_searchPaths;
+}
+
+/*!
+    \internal
+    Returns the existing files (or directories) called \a fileName in the mime
+    directories, most important first, like QStandardPaths::locateAll() does
+    for "mime/" + fileName.
+
+    The result is remembered until clearLocateCache(), so that the providers
+    don't stat the same paths for every lookup. The cache has a mutex of its
+    own, since the lazy loaders of the types reach it too.
+ */
+QStringList QMimeDatabasePrivate::locateAll(const QString &fileName, bool directory) const
+{
+    QMutexLocker locker(&m_locateMutex);
+    const QString key = directory ? fileName + QLatin1Char('/') : fileName;
+    const QHash<QString, QStringList>::const_iterator cached = m_located.constFind(key);
+    if (cached != m_located.constEnd())
+        return cached.value();
+
+    QStringList result;
+    foreach (const SearchPath &searchPath, searchPaths()) {
+        QString path;
+        if (!searchPath.second.isEmpty() && fileName == QLatin1String("mime.cache"))
+            path = searchPath.second;
+        else
+            path = searchPath.first + QLatin1Char('/') + fileName;
+        const QFileInfo info(path);
+        if (directory ? info.isDir() : info.isFile())
+            result.append(path);
+    }
+    m_located.insert(key, result);
+    return result;
+}
+
+/*!
+    \internal
+    Forgets the directories and files found so far. Called by the providers
+    whenever they check for changes, so that new files and changed
+    XDG_DATA_HOME or XDG_DATA_DIRS values are seen at the same pace as
+    modified files.
+ */
+void QMimeDatabasePrivate::clearLocateCache()
+{
+    QMutexLocker locker(&m_locateMutex);
+    m_searchPaths.clear();
+    m_located.clear();
+}
+
+/*!
+    \internal
+    Returns the mime directory where the user installs their own definitions,
+    or an empty string for a database created from explicit directories.
+ */
+QString QMimeDatabasePrivate::writableMimeDirectory() const
+{
+    if (!m_mimeDirectories.isEmpty())
+        return QString();
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/mime");
+}
+
 /*!
     \internal
     Returns a MIME type or an invalid one if none found
  */
 QMimeType QMimeDatabasePrivate::mimeTypeForName(const QString &nameOrAlias)
 {
-    return provider()->mimeTypeForName(provider()->resolveAlias(nameOrAlias));
+    return provider()->mimeTypeForNameOrAlias(nameOrAlias);
 }
 
 QStringList QMimeDatabasePrivate::mimeTypeForFileName(const QString &fileName, QString *foundSuffix)
@@ -121,10 +266,56 @@ QStringList QMimeDatabasePrivate::mimeTypeForFileName(const QString &fileName, Q
     if (fileName.endsWith(QLatin1Char('/')))
         return QStringList() << QLatin1String("inode/directory");
 
+    if (QMIME_TRACE_ENABLED(find_by_file_name_entry))
+        QMIME_TRACE1(find_by_file_name_entry, QFile::encodeName(fileName).constData());
+    QMimeStatisticsTimer timer(QMimeDatabaseStatistics::GlobMatching);
     const QStringList matchingMimeTypes = provider()->findByFileName(QFileInfo(fileName).fileName(), foundSuffix);
+    if (QMIME_TRACE_ENABLED(find_by_file_name_return))
+        QMIME_TRACE2(find_by_file_name_return, QFile::encodeName(fileName).constData(), matchingMimeTypes.count());
+    return matchingMimeTypes;
+}
+
+/*!
+    \internal
+    Same as mimeTypeForFileName(const QString &, QString *) for the \a length
+    bytes at \a fileName, in the encoding of QFile::encodeName().
+    Only the base name is matched, without converting it to a QString first.
+ */
+QStringList QMimeDatabasePrivate::mimeTypeForFileName(const char *fileName, int length, QString *foundSuffix)
+{
+    if (length > 0 && fileName[length - 1] == '/')
+        return QStringList() << QLatin1String("inode/directory");
+
+    if (QMIME_TRACE_ENABLED(find_by_file_name_entry))
+        QMIME_TRACE1(find_by_file_name_entry, QByteArray(fileName, length).constData());
+    const char *baseName = fileName + length;
+    while (baseName > fileName && baseName[-1] != '/'
+#ifdef Q_OS_WIN
+           && baseName[-1] != '\\'
+#endif
+           )
+        --baseName;
+    QMimeStatisticsTimer timer(QMimeDatabaseStatistics::GlobMatching);
+    const QStringList matchingMimeTypes = provider()->findByEncodedFileName(baseName, fileName + length - baseName, foundSuffix);
+    if (QMIME_TRACE_ENABLED(find_by_file_name_return))
+        QMIME_TRACE2(find_by_file_name_return, QByteArray(fileName, length).constData(), matchingMimeTypes.count());
     return matchingMimeTypes;
 }
 
+/*!
+    \internal
+    Picks the MIME type to return for the file name \a matches, the default
+    one if there are none.
+ */
+QMimeType QMimeDatabasePrivate::mimeTypeForMatches(QStringList matches)
+{
+    if (matches.isEmpty())
+        return mimeTypeForName(defaultMimeType());
+    // We have to pick one.
+    matches.sort(); // Make it deterministic
+    return mimeTypeForName(matches.first());
+}
+
 static inline bool isTextFile(const QByteArray &data)
 {
     // UTF16 byte order marks
@@ -144,7 +335,7 @@ static inline bool isTextFile(const QByteArray &data)
     return true;
 }
 
-QMimeType QMimeDatabasePrivate::findByData(const QByteArray &data, int *accuracyPtr)
+QMimeType QMimeDatabasePrivate::findByData(const QByteArray &data, int *accuracyPtr, QIODevice *device, QMimeBudgetTracker *budget)
 {
     if (data.isEmpty()) {
         *accuracyPtr = 100;
@@ -152,10 +343,29 @@ QMimeType QMimeDatabasePrivate::findByData(const QByteArray &data, int *accuracy
     }
 
     *accuracyPtr = 0;
-    QMimeType candidate = provider()->findByMagic(data, accuracyPtr);
+    if (budget && budget->maxBytes() >= 0 && data.size() > budget->maxBytes()) {
+        // Only what the budget allows is looked at, by magic and by the zip refinement
+        if (provider()->maxMagicExtent() > budget->maxBytes())
+            budget->setDataTruncated();
+        if (budget->maxBytes() == 0)
+            return mimeTypeForName(defaultMimeType());
+        return findByData(data.left(budget->maxBytes()), accuracyPtr, 0, budget);
+    }
+
+    QMimeType candidate;
+    {
+        QMIME_TRACE1(find_by_magic_entry, data.size());
+        QMimeStatisticsTimer timer(QMimeDatabaseStatistics::MagicMatching);
+        candidate = provider()->findByMagic(data, accuracyPtr, budget);
+    }
+    if (QMIME_TRACE_ENABLED(find_by_magic_return))
+        QMIME_TRACE2(find_by_magic_return, candidate.name().toLatin1().constData(), *accuracyPtr);
 
-    if (candidate.isValid())
+    if (candidate.isValid()) {
+        if (m_detectionFlags & QMimeDatabase::RefineZipContainers)
+            return refineZipContainer(candidate, data, device);
         return candidate;
+    }
 
     if (isTextFile(data)) {
         *accuracyPtr = 5;
@@ -165,7 +375,63 @@ QMimeType QMimeDatabasePrivate::findByData(const QByteArray &data, int *accuracy
     return mimeTypeForName(defaultMimeType());
 }
 
-QMimeType QMimeDatabasePrivate::mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device, int *accuracyPtr)
+// Looks into the archive when magic only found a zip. The name found inside
+// has to be a zip type too, an archive member doesn't get to claim anything else.
+QMimeType QMimeDatabasePrivate::refineZipContainer(const QMimeType &candidate, const QByteArray &data, QIODevice *device)
+{
+    const QString zip = QLatin1String("application/zip");
+    if (!inherits(candidate.name(), zip))
+        return candidate;
+
+    QMimeZipContainer container(data, device);
+    const QString contained = provider()->resolveAlias(container.mimeType());
+    if (contained.isEmpty() || contained == candidate.name())
+        return candidate;
+    const QMimeType refined = mimeTypeForName(contained);
+    if (!refined.isValid() || !inherits(refined.name(), zip))
+        return candidate;
+    return refined;
+}
+
+// Inflates as much of the payload as magic looks at, for the type of what was compressed.
+// data was peeked from device, if not 0, which is read further when data holds no payload yet.
+QMimeType QMimeDatabasePrivate::findInnerType(const QMimeType &container, const QByteArray &data, QIODevice *device)
+{
+    if (!container.isValid() || !QMimeDecompressor::canDecompress(data))
+        return QMimeType();
+
+    // text/plain is decided from the first 32 bytes
+    const int extent = qMax(provider()->maxMagicExtent(), 32);
+    const QByteArray payload = QMimeDecompressor::decompress(data, device, extent);
+    if (payload.isEmpty())
+        return QMimeType();
+    int accuracy = 0;
+    return findByData(payload, &accuracy);
+}
+
+// Read 16K in one go (QIODEVICE_BUFFERSIZE in qiodevice_p.h).
+// This is much faster than seeking back and forth into QIODevice.
+// With a budget, one byte more than it allows, for findByData() to tell whether it truncated.
+static QByteArray peekData(QIODevice *device, QMimeBudgetTracker *budget = 0)
+{
+    QMimeStatisticsTimer timer(QMimeDatabaseStatistics::DeviceRead);
+    if (budget && budget->maxBytes() >= 0 && budget->maxBytes() < 16384)
+        return device->peek(budget->maxBytes() + 1);
+    return device->peek(16384);
+}
+
+QMimeType QMimeDatabasePrivate::mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device, int *accuracyPtr, QMimeBudgetTracker *budget)
+{
+    if (QMIME_TRACE_ENABLED(file_name_and_data_entry))
+        QMIME_TRACE1(file_name_and_data_entry, QFile::encodeName(fileName).constData());
+    int bytesRead = 0;
+    const QMimeType result = matchFileNameAndData(fileName, device, accuracyPtr, &bytesRead, budget);
+    if (QMIME_TRACE_ENABLED(file_name_and_data_return))
+        QMIME_TRACE3(file_name_and_data_return, QFile::encodeName(fileName).constData(), result.name().toLatin1().constData(), bytesRead);
+    return result;
+}
+
+QMimeType QMimeDatabasePrivate::matchFileNameAndData(const QString &fileName, QIODevice *device, int *accuracyPtr, int *bytesReadPtr, QMimeBudgetTracker *budget)
 {
     // First, glob patterns are evaluated. If there is a match with max weight,
     // this one is selected and we are done. Otherwise, the file contents are
@@ -187,13 +453,11 @@ QMimeType QMimeDatabasePrivate::mimeTypeForFileNameAndData(const QString &fileNa
     // Extension is unknown, or matches multiple mimetypes.
     // Pass 2) Match on content, if we can read the data
     if (device->isOpen()) {
-
-        // Read 16K in one go (QIODEVICE_BUFFERSIZE in qiodevice_p.h).
-        // This is much faster than seeking back and forth into QIODevice.
-        const QByteArray data = device->peek(16384);
+        const QByteArray data = peekData(device, budget);
+        *bytesReadPtr = data.size();
 
         int magicAccuracy = 0;
-        QMimeType candidateByData(findByData(data, &magicAccuracy));
+        QMimeType candidateByData(findByData(data, &magicAccuracy, device, budget));
 
         // Disambiguate conflicting extensions (if magic matching found something)
         if (candidateByData.isValid() && magicAccuracy > 0) {
@@ -304,6 +568,48 @@ QMimeDatabase::QMimeDatabase() :
     DBG();
 }
 
+/*!
+    \fn QMimeDatabase::QMimeDatabase(const QStringList &mimeDirectories);
+    Constructs a QMimeDatabase object reading the definitions from \a mimeDirectories
+    only, ignoring QStandardPaths and the XDG environment variables.
+
+    Each entry is a directory laid out like /usr/share/mime (with mime.cache, types
+    and packages/), or the path of a mime.cache file, in which case the other files
+    are looked up next to it. The first entries take precedence, as the local
+    directory does over the global ones for the default database. If
+    \a mimeDirectories is empty, the usual directories are searched.
+
+    Unlike the default-constructed objects, which all share the same state, such a
+    database has its own cache and its own lock, so that separate instances can be
+    used from different threads without contention. The MIME types it returns must
+    not be used after it is destroyed.
+
+    \sa QMimeDatabase()
+ */
+QMimeDatabase::QMimeDatabase(const QStringList &mimeDirectories) :
+        d(new QMimeDatabasePrivate(mimeDirectories))
+{
+    DBG();
+}
+
+/*!
+    \fn QMimeDatabase::QMimeDatabase(const QMimeDatabase *base);
+    Constructs a QMimeDatabase object layered over \a base, or over the default
+    database if \a base is 0.
+
+    The types registered with registerMimeTypes() in this object are only seen
+    through it, everything else comes from \a base. Several such objects can
+    share one base, each with its own registrations. \a base must outlive this
+    object.
+
+    \sa registerMimeTypes()
+ */
+QMimeDatabase::QMimeDatabase(const QMimeDatabase *base) :
+        d(new QMimeDatabasePrivate(base ? base->d : staticQMimeDatabase()))
+{
+    DBG();
+}
+
 /*!
     \fn QMimeDatabase::~QMimeDatabase();
     Destroys the QMimeDatabase object.
@@ -312,53 +618,111 @@ QMimeDatabase::~QMimeDatabase()
 {
     DBG();
 
+    if (d != staticQMimeDatabase())
+        delete d;
     d = 0;
 }
 
 /*!
-    \fn QMimeType QMimeDatabase::mimeTypeForName(const QString &nameOrAlias) const;
-    Returns a MIME type for \a nameOrAlias or an invalid one if none found.
- */
-QMimeType QMimeDatabase::mimeTypeForName(const QString &nameOrAlias) const
+    \enum QMimeDatabase::DetectionFlag
+
+    This enum specifies optional stages of content detection.
+
+    \value NoDetectionFlags Magic only, as specified by shared-mime-info.
+
+    \value RefineZipContainers When magic finds a zip archive, look at the
+    "mimetype" member of OpenDocument and EPUB archives, and at the file names in
+    the central directory of Office Open XML, Java and Android archives, to return
+    the specific type. At most a few KiB are read beyond the data read for magic,
+    and only from random-access devices.
+
+    \value AdaptiveMagicOrder Evaluate first the magic rules that matched most
+    often so far, among those of the same priority that no data can match
+    together, so that the result is the same as without it. The new orders are
+    computed in the global thread pool, from time to time. With a
+    QMimeDetectionBudget, what is found before the budget is exhausted may
+    differ. The order belongs to the loaded database: objects created over a
+    base database follow the flag of the base.
+*/
+
+/*!
+    Sets the optional detection stages used by this object to \a flags.
+
+    The flags belong to the database: default-constructed QMimeDatabase objects
+    all share them, while objects created from explicit directories or over a
+    base database have their own.
+
+    \sa detectionFlags()
+*/
+void QMimeDatabase::setDetectionFlags(DetectionFlags flags)
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeDatabaseLocker locker(&d->mutex);
 
-    return d->mimeTypeForName(nameOrAlias);
+    d->m_detectionFlags = flags;
 }
 
 /*!
-    Returns a MIME type for \a fileInfo.
+    Returns the optional detection stages used by this object.
 
-    A valid MIME type is always returned.
+    \sa setDetectionFlags()
+*/
+QMimeDatabase::DetectionFlags QMimeDatabase::detectionFlags() const
+{
+    QMimeDatabaseLocker locker(&d->mutex);
 
-    The default matching algorithm looks at both the file name and the file
-    contents, if necessary. The file extension has priority over the contents,
-    but the contents will be used if the file extension is unknown, or
-    matches multiple MIME types.
-    If \a fileInfo is a Unix symbolic link, the file that it refers to
-    will be used instead.
-    If the file doesn't match any known pattern or data, the default MIME type
-    (application/octet-stream) is returned.
+    return d->m_detectionFlags;
+}
 
-    When \a mode is set to MatchExtension, only the file name is used, not
-    the file contents. The file doesn't even have to exist. If the file name
-    doesn't match any known pattern, the default MIME type (application/octet-stream)
-    is returned.
-    If multiple MIME types match this file, the first one (alphabetically) is returned.
+/*!
+    \enum QMimeDatabase::WarmUpFlag
+
+    This enum specifies what warmUp() loads.
+
+    \value WarmUpNames The list of MIME types and aliases, used by mimeTypeForName()
+    and allMimeTypes().
+    \value WarmUpGlobs The glob patterns, used to match file names and returned
+    by QMimeType::globPatterns().
+    \value WarmUpMagic The magic rules, used to match contents.
+    \value WarmUpHierarchy The parents of the MIME types, used by QMimeType::inherits().
+    \value WarmUpComments The comments in the system language, returned by
+    QMimeType::comment().
+    \value WarmUpAll All of the above.
+*/
 
-    When \a mode is set to MatchContent, and the file is readable, only the
-    file contents are used to determine the MIME type. This is equivalent to
-    calling mimeTypeForData with a QFile as input device.
+/*!
+    Loads the parts of the MIME database given by \a flags now, instead of on
+    first use.
 
-    In all cases, the \a fileName can also include an absolute or relative path.
+    A server that forks its worker processes after initialization can call
+    this before forking, so that the workers share the loaded database instead
+    of each loading their own copy of it. Comments are loaded in the language of
+    the system at the time of the call.
 
-    \sa isDefault, mimeTypeForData
+    The database is still checked for changes on disk once in a while, and
+    reloaded as needed.
 */
-QMimeType QMimeDatabase::mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mode) const
+void QMimeDatabase::warmUp(WarmUpFlags flags) const
 {
-    DBG() << "fileInfo" << fileInfo.absoluteFilePath();
+    QMimeDatabaseLocker locker(&d->mutex);
 
-    QMutexLocker locker(&d->mutex);
+    d->provider()->warmUp(flags);
+}
+
+/*!
+    \fn QMimeType QMimeDatabase::mimeTypeForName(const QString &nameOrAlias) const;
+    Returns a MIME type for \a nameOrAlias or an invalid one if none found.
+ */
+QMimeType QMimeDatabase::mimeTypeForName(const QString &nameOrAlias) const
+{
+    QMimeDatabaseLocker locker(&d->mutex);
+
+    return d->mimeTypeForName(nameOrAlias);
+}
+
+static QMimeType mimeTypeForFileInfo(const QMimeDatabase *db, QMimeDatabasePrivate *d,
+                                     const QFileInfo &fileInfo, QMimeDatabase::MatchMode mode)
+{
+    QMimeDatabaseLocker locker(&d->mutex);
 
     if (fileInfo.isDir())
         return d->mimeTypeForName(QLatin1String("inode/directory"));
@@ -383,16 +747,16 @@ QMimeType QMimeDatabase::mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mo
 
     int priority = 0;
     switch (mode) {
-    case MatchDefault:
+    case QMimeDatabase::MatchDefault:
         file.open(QIODevice::ReadOnly); // isOpen() will be tested by method below
         return d->mimeTypeForFileNameAndData(fileInfo.absoluteFilePath(), &file, &priority);
-    case MatchExtension:
+    case QMimeDatabase::MatchExtension:
         locker.unlock();
-        return mimeTypeForFile(fileInfo.absoluteFilePath(), mode);
-    case MatchContent:
+        return db->mimeTypeForFile(fileInfo.absoluteFilePath(), mode);
+    case QMimeDatabase::MatchContent:
         if (file.open(QIODevice::ReadOnly)) {
             locker.unlock();
-            return mimeTypeForData(&file);
+            return db->mimeTypeForData(&file);
         } else {
             return d->mimeTypeForName(d->defaultMimeType());
         }
@@ -402,6 +766,46 @@ QMimeType QMimeDatabase::mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mo
     return d->mimeTypeForName(d->defaultMimeType());
 }
 
+/*!
+    Returns a MIME type for \a fileInfo.
+
+    A valid MIME type is always returned.
+
+    The default matching algorithm looks at both the file name and the file
+    contents, if necessary. The file extension has priority over the contents,
+    but the contents will be used if the file extension is unknown, or
+    matches multiple MIME types.
+    If \a fileInfo is a Unix symbolic link, the file that it refers to
+    will be used instead.
+    If the file doesn't match any known pattern or data, the default MIME type
+    (application/octet-stream) is returned.
+
+    When \a mode is set to MatchExtension, only the file name is used, not
+    the file contents. The file doesn't even have to exist. If the file name
+    doesn't match any known pattern, the default MIME type (application/octet-stream)
+    is returned.
+    If multiple MIME types match this file, the first one (alphabetically) is returned.
+
+    When \a mode is set to MatchContent, and the file is readable, only the
+    file contents are used to determine the MIME type. This is equivalent to
+    calling mimeTypeForData with a QFile as input device.
+
+    In all cases, the \a fileName can also include an absolute or relative path.
+
+    \sa isDefault, mimeTypeForData
+*/
+QMimeType QMimeDatabase::mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mode) const
+{
+    DBG() << "fileInfo" << fileInfo.absoluteFilePath();
+
+    if (QMIME_TRACE_ENABLED(mime_type_for_file_entry))
+        QMIME_TRACE1(mime_type_for_file_entry, QFile::encodeName(fileInfo.filePath()).constData());
+    const QMimeType result = mimeTypeForFileInfo(this, d, fileInfo, mode);
+    if (QMIME_TRACE_ENABLED(mime_type_for_file_return))
+        QMIME_TRACE2(mime_type_for_file_return, QFile::encodeName(fileInfo.filePath()).constData(), result.name().toLatin1().constData());
+    return result;
+}
+
 /*!
     Returns a MIME type for the file named \a fileName using \a mode.
 
@@ -410,22 +814,17 @@ QMimeType QMimeDatabase::mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mo
 QMimeType QMimeDatabase::mimeTypeForFile(const QString &fileName, MatchMode mode) const
 {
     if (mode == MatchExtension) {
-        QMutexLocker locker(&d->mutex);
-        QStringList matches = d->mimeTypeForFileName(fileName);
-        const int matchCount = matches.count();
-        if (matchCount == 0) {
-            return d->mimeTypeForName(d->defaultMimeType());
-        } else if (matchCount == 1) {
-            return d->mimeTypeForName(matches.first());
-        } else {
-            // We have to pick one.
-            matches.sort(); // Make it deterministic
-            return d->mimeTypeForName(matches.first());
-        }
+        if (QMIME_TRACE_ENABLED(mime_type_for_file_entry))
+            QMIME_TRACE1(mime_type_for_file_entry, QFile::encodeName(fileName).constData());
+        QMimeDatabaseLocker locker(&d->mutex);
+        const QMimeType result = d->mimeTypeForMatches(d->mimeTypeForFileName(fileName));
+        if (QMIME_TRACE_ENABLED(mime_type_for_file_return))
+            QMIME_TRACE2(mime_type_for_file_return, QFile::encodeName(fileName).constData(), result.name().toLatin1().constData());
+        return result;
     } else {
         // Implemented as a wrapper around mimeTypeForFile(QFileInfo), so no mutex.
         QFileInfo fileInfo(fileName);
-        return mimeTypeForFile(fileInfo);
+        return mimeTypeForFile(fileInfo, mode);
     }
 }
 
@@ -444,7 +843,7 @@ QMimeType QMimeDatabase::mimeTypeForFile(const QString &fileName, MatchMode mode
 */
 QList<QMimeType> QMimeDatabase::mimeTypesForFileName(const QString &fileName) const
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeDatabaseLocker locker(&d->mutex);
 
     QStringList matches = d->mimeTypeForFileName(fileName);
     QList<QMimeType> mimes;
@@ -453,6 +852,61 @@ QList<QMimeType> QMimeDatabase::mimeTypesForFileName(const QString &fileName) co
         mimes.append(d->mimeTypeForName(mime));
     return mimes;
 }
+
+/*!
+    Returns a MIME type for the file name \a fileName, given in the encoding
+    of QFile::encodeName(), as returned by readdir() on Unix.
+
+    This is the same as mimeTypeForFile() with MatchExtension, without
+    decoding \a fileName: with a mime.cache file, ASCII names are matched as
+    they are. Only the part after the last '/' is used.
+
+    \sa mimeTypesForFileName()
+*/
+QMimeType QMimeDatabase::mimeTypeForFileName(const QByteArray &fileName) const
+{
+    return mimeTypeForFileName(fileName.constData(), fileName.size());
+}
+
+/*!
+    \overload
+
+    Returns a MIME type for the \a length bytes at \a fileName, or for all of
+    it up to the terminating '\0' if \a length is negative.
+*/
+QMimeType QMimeDatabase::mimeTypeForFileName(const char *fileName, int length) const
+{
+    if (length < 0)
+        length = qstrlen(fileName);
+
+    QMimeDatabaseLocker locker(&d->mutex);
+
+    return d->mimeTypeForMatches(d->mimeTypeForFileName(fileName, length));
+}
+
+/*!
+    \overload
+
+    Returns the MIME types for the \a length bytes at \a fileName, in the
+    encoding of QFile::encodeName(), or for all of it up to the terminating
+    '\0' if \a length is negative.
+
+    \sa mimeTypeForFileName()
+*/
+QList<QMimeType> QMimeDatabase::mimeTypesForFileName(const char *fileName, int length) const
+{
+    if (length < 0)
+        length = qstrlen(fileName);
+
+    QMimeDatabaseLocker locker(&d->mutex);
+
+    QStringList matches = d->mimeTypeForFileName(fileName, length);
+    QList<QMimeType> mimes;
+    matches.sort(); // Make it deterministic
+    foreach (const QString &mime, matches)
+        mimes.append(d->mimeTypeForName(mime));
+    return mimes;
+}
 /*!
     Returns the suffix for the file \a fileName, as known by the MIME database.
 
@@ -461,7 +915,7 @@ QList<QMimeType> QMimeDatabase::mimeTypesForFileName(const QString &fileName) co
 */
 QString QMimeDatabase::suffixForFileName(const QString &fileName) const
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeDatabaseLocker locker(&d->mutex);
     QString foundSuffix;
     d->mimeTypeForFileName(fileName, &foundSuffix);
     return foundSuffix;
@@ -476,10 +930,7 @@ QString QMimeDatabase::suffixForFileName(const QString &fileName) const
 */
 QMimeType QMimeDatabase::mimeTypeForData(const QByteArray &data) const
 {
-    QMutexLocker locker(&d->mutex);
-
-    int accuracy = 0;
-    return d->findByData(data, &accuracy);
+    return mimeTypeForData(data, 0);
 }
 
 /*!
@@ -491,15 +942,56 @@ QMimeType QMimeDatabase::mimeTypeForData(const QByteArray &data) const
 */
 QMimeType QMimeDatabase::mimeTypeForData(QIODevice *device) const
 {
-    QMutexLocker locker(&d->mutex);
+    return mimeTypeForData(device, 0);
+}
+
+/*!
+    Returns a MIME type for \a data, and sets \a innerType, if not 0, to the
+    MIME type of the data compressed in it.
+
+    When \a data is compressed with gzip (or with bzip2 or xz, if the library was
+    built with support for them), only as much of the payload is inflated as the
+    magic rules look at, so that memory and time stay bounded whatever the size of
+    \a data. \a innerType is invalid for data that isn't compressed, or that
+    cannot be inflated.
+
+    \overload
+*/
+QMimeType QMimeDatabase::mimeTypeForData(const QByteArray &data, QMimeType *innerType) const
+{
+    QMimeDatabaseLocker locker(&d->mutex);
+
+    int accuracy = 0;
+    const QMimeType result = d->findByData(data, &accuracy);
+    if (innerType)
+        *innerType = d->findInnerType(result, data);
+    return result;
+}
+
+/*!
+    Returns a MIME type for the data in \a device, and sets \a innerType, if
+    not 0, to the MIME type of the data compressed in it.
+
+    When the data read for magic doesn't hold enough of the payload (bzip2 only
+    produces output after a whole block, up to 900 KB), the compressed data that
+    follows is read too from a \a device that isn't sequential, at most 1 MB in
+    all. The position of \a device is restored.
+
+    \overload
+*/
+QMimeType QMimeDatabase::mimeTypeForData(QIODevice *device, QMimeType *innerType) const
+{
+    QMimeDatabaseLocker locker(&d->mutex);
 
+    if (innerType)
+        *innerType = QMimeType();
     int accuracy = 0;
     const bool openedByUs = !device->isOpen() && device->open(QIODevice::ReadOnly);
     if (device->isOpen()) {
-        // Read 16K in one go (QIODEVICE_BUFFERSIZE in qiodevice_p.h).
-        // This is much faster than seeking back and forth into QIODevice.
-        const QByteArray data = device->peek(16384);
-        const QMimeType result = d->findByData(data, &accuracy);
+        const QByteArray data = peekData(device);
+        const QMimeType result = d->findByData(data, &accuracy, device);
+        if (innerType)
+            *innerType = d->findInnerType(result, data, device);
         if (openedByUs)
             device->close();
         return result;
@@ -507,6 +999,57 @@ QMimeType QMimeDatabase::mimeTypeForData(QIODevice *device) const
     return d->mimeTypeForName(d->defaultMimeType());
 }
 
+/*!
+    Returns a MIME type for \a data, spending no more than \a budget on it.
+
+    If the budget is exhausted before all the magic rules were evaluated, or if
+    the rules would have looked at more data than the budget allows, the best
+    match found so far is returned and \a budgetExhausted, if not 0, is set to
+    true. The result is then not necessarily the one mimeTypeForData() returns.
+
+    Use this for data that may be hostile, to bound the time spent on it.
+
+    \overload
+    \sa QMimeDetectionBudget
+*/
+QMimeType QMimeDatabase::mimeTypeForData(const QByteArray &data, const QMimeDetectionBudget &budget, bool *budgetExhausted) const
+{
+    QMimeDatabaseLocker locker(&d->mutex);
+
+    QMimeBudgetTracker tracker(budget);
+    int accuracy = 0;
+    const QMimeType result = d->findByData(data, &accuracy, 0, &tracker);
+    if (budgetExhausted)
+        *budgetExhausted = tracker.isResultLimited();
+    return result;
+}
+
+/*!
+    Returns a MIME type for the data in \a device, spending no more than
+    \a budget on it. No more than QMimeDetectionBudget::maxBytes() bytes are
+    read from \a device.
+
+    \overload
+    \sa QMimeDetectionBudget
+*/
+QMimeType QMimeDatabase::mimeTypeForData(QIODevice *device, const QMimeDetectionBudget &budget, bool *budgetExhausted) const
+{
+    QMimeDatabaseLocker locker(&d->mutex);
+
+    QMimeBudgetTracker tracker(budget);
+    QMimeType result = d->mimeTypeForName(d->defaultMimeType());
+    int accuracy = 0;
+    const bool openedByUs = !device->isOpen() && device->open(QIODevice::ReadOnly);
+    if (device->isOpen()) {
+        result = d->findByData(peekData(device, &tracker), &accuracy, device, &tracker);
+        if (openedByUs)
+            device->close();
+    }
+    if (budgetExhausted)
+        *budgetExhausted = tracker.isResultLimited();
+    return result;
+}
+
 /*!
     Returns a MIME type for \a url.
 
@@ -557,6 +1100,8 @@ QMimeType QMimeDatabase::mimeTypeForFileNameAndData(const QString &fileName, QIO
 {
     DBG() << "fileName" << fileName;
 
+    QMimeDatabaseLocker locker(&d->mutex);
+
     int accuracy = 0;
     const bool openedByUs = !device->isOpen() && device->open(QIODevice::ReadOnly);
     const QMimeType result = d->mimeTypeForFileNameAndData(fileName, device, &accuracy);
@@ -585,12 +1130,42 @@ QMimeType QMimeDatabase::mimeTypeForFileNameAndData(const QString &fileName, con
 {
     DBG() << "fileName" << fileName;
 
+    QMimeDatabaseLocker locker(&d->mutex);
+
     QBuffer buffer(const_cast<QByteArray *>(&data));
     buffer.open(QIODevice::ReadOnly);
     int accuracy = 0;
     return d->mimeTypeForFileNameAndData(fileName, &buffer, &accuracy);
 }
 
+/*!
+    Returns a MIME type for the given \a fileName and \a device data,
+    spending no more than \a budget on the data.
+
+    The budget only applies to the contents, which are looked at when the
+    file name matches no MIME type or several. \a budgetExhausted, if not 0,
+    is set to whether the result may differ from the one without a budget.
+
+    \overload
+    \sa QMimeDetectionBudget
+*/
+QMimeType QMimeDatabase::mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device, const QMimeDetectionBudget &budget, bool *budgetExhausted) const
+{
+    DBG() << "fileName" << fileName;
+
+    QMimeDatabaseLocker locker(&d->mutex);
+
+    QMimeBudgetTracker tracker(budget);
+    int accuracy = 0;
+    const bool openedByUs = !device->isOpen() && device->open(QIODevice::ReadOnly);
+    const QMimeType result = d->mimeTypeForFileNameAndData(fileName, device, &accuracy, &tracker);
+    if (openedByUs)
+        device->close();
+    if (budgetExhausted)
+        *budgetExhausted = tracker.isResultLimited();
+    return result;
+}
+
 /*!
     Returns the list of all available MIME types.
 
@@ -600,11 +1175,111 @@ QMimeType QMimeDatabase::mimeTypeForFileNameAndData(const QString &fileName, con
 */
 QList<QMimeType> QMimeDatabase::allMimeTypes() const
 {
-    QMutexLocker locker(&d->mutex);
+    QMimeDatabaseLocker locker(&d->mutex);
 
     return d->allMimeTypes();
 }
 
+/*!
+    Registers the MIME types defined by the shared-mime-info XML read from \a device,
+    in addition to the installed ones.
+
+    The definitions (comments, globs, magic, aliases and parents) take precedence over
+    the installed ones: a registered glob matching a file name wins over the installed
+    globs, and registered magic wins over installed magic of the same or lower
+    priority. Registering a type again replaces its previous registration.
+    Types registered through a default-constructed QMimeDatabase are seen by all
+    of them, and by the objects layered over the default database.
+
+    \a device is opened for reading if needed, and closed again in that case.
+    Nothing is registered if the XML cannot be parsed; false is returned and
+    \a errorMessage, if not 0, describes the error.
+
+    \sa QMimeDatabase(const QMimeDatabase *)
+*/
+bool QMimeDatabase::registerMimeTypes(QIODevice *device, QString *errorMessage)
+{
+    QMimeDatabaseLocker locker(&d->mutex);
+
+    return d->registerMimeTypes(device, errorMessage);
+}
+
+/*!
+    Compiles the shared-mime-info XML files in \a mimeDirectory/packages into
+    \a mimeDirectory/mime.cache and \a mimeDirectory/types, like
+    update-mime-database does, so that the mime.cache based fast path can be used
+    where shared-mime-info is not installed.
+
+    Both files are replaced atomically; running QMimeDatabase objects pick up the
+    new cache on their next check. Returns false if a package file cannot be
+    parsed or a file cannot be written, and sets \a errorMessage, if not 0.
+
+    \sa QMimeDatabase(const QStringList &)
+*/
+bool QMimeDatabase::updateMimeCache(const QString &mimeDirectory, QString *errorMessage)
+{
+    return QMimeCacheWriter::updateMimeDirectory(mimeDirectory, errorMessage);
+}
+
+/*!
+    Answers the requests of QMimeDatabaseClient objects, received on the Unix
+    domain socket \a socketPath, with this database.
+
+    The database is warmed up first, so that clients never wait for it to load.
+    This doesn't return unless the socket cannot be created, or another process
+    already listens on it: then it returns false and sets \a errorMessage, if
+    not 0. A socket file left behind by a process that is gone is replaced.
+
+    This is only available on Unix.
+
+    \sa QMimeDatabaseClient, warmUp()
+*/
+bool QMimeDatabase::serve(const QString &socketPath, QString *errorMessage) const
+{
+    QString error;
+    QMimeDaemonServer server(this);
+    if (!server.listen(QFile::encodeName(socketPath), &error)) {
+        if (errorMessage)
+            *errorMessage = error;
+        return false;
+    }
+    warmUp();
+    server.exec();
+    return true;
+}
+
+/*!
+    Returns the statistics collected so far by all QMimeDatabase instances, in all threads.
+
+    Statistics are only collected if the environment variable QT_MIME_STATISTICS
+    is set to 1 (or to "dump", to also print them when the application exits);
+    otherwise the returned statistics are empty and not enabled. The counters
+    of the magic matchers, sorted by cost, are collected if
+    QT_MIME_MAGIC_STATISTICS is set to 1.
+
+    \sa QMimeDatabaseStatistics
+*/
+QMimeDatabaseStatistics QMimeDatabase::statistics() const
+{
+    return QMimeStatistics::snapshot();
+}
+
+/*!
+    Returns the memory used by the MIME data loaded so far by this object, per
+    component. An object created over a base database includes the memory of
+    the base, which all the objects over it share.
+
+    \sa QMimeDatabaseMemoryUsage
+*/
+QMimeDatabaseMemoryUsage QMimeDatabase::memoryUsage() const
+{
+    QMimeDatabaseLocker locker(&d->mutex);
+
+    QMimeMemoryUsage usage;
+    d->provider()->addMemoryUsage(usage);
+    return usage.result();
+}
+
 #undef DBG
 
 QT_END_NAMESPACE
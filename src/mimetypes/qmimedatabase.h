@@ -46,7 +46,9 @@
 
 #include "qmimetype.h"
 
+#include <QtCore/qshareddata.h>
 #include <QtCore/qstringlist.h>
+#include <QtCore/qvector.h>
 
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
 #error "Do not try to use this library with Qt5, use QtCore/QMimeType instead"
@@ -59,6 +61,116 @@ class QFileInfo;
 class QIODevice;
 class QUrl;
 
+class QMimeDatabaseStatisticsPrivate;
+class QMIME_EXPORT QMimeDatabaseStatistics
+{
+public:
+    enum Stage {
+        CacheCheck,
+        GlobMatching,
+        MagicMatching,
+        DeviceRead,
+        XmlParsing,
+        MutexWait
+    };
+    enum {
+        StageCount = MutexWait + 1,
+        HistogramSize = 32
+    };
+
+    struct MagicMatcherCounters
+    {
+        MagicMatcherCounters();
+
+        QString mimeType;
+        int priority;
+        qint64 evaluations;
+        qint64 ruleEvaluations;
+        qint64 matches;
+        qint64 bytesCompared;
+        qint64 totalTime;
+    };
+
+    QMimeDatabaseStatistics();
+    QMimeDatabaseStatistics(const QMimeDatabaseStatistics &other);
+    QMimeDatabaseStatistics &operator=(const QMimeDatabaseStatistics &other);
+    ~QMimeDatabaseStatistics();
+
+    bool isEnabled() const;
+
+    qint64 count(Stage stage) const;
+    qint64 totalTime(Stage stage) const;
+    QVector<qint64> histogram(Stage stage) const;
+
+    bool isMagicProfilingEnabled() const;
+    QList<MagicMatcherCounters> magicMatcherCounters() const;
+
+    static QString stageName(Stage stage);
+    QString toString() const;
+
+private:
+    friend class QMimeStatistics;
+    QSharedDataPointer<QMimeDatabaseStatisticsPrivate> d;
+};
+
+class QMimeDatabaseMemoryUsagePrivate;
+class QMIME_EXPORT QMimeDatabaseMemoryUsage
+{
+public:
+    enum Component {
+        MimeTypes,
+        LocaleComments,
+        Aliases,
+        Parents,
+        GlobPatterns,
+        MagicRules,
+        NameIndex,
+        CacheFiles
+    };
+    enum {
+        ComponentCount = CacheFiles + 1
+    };
+
+    QMimeDatabaseMemoryUsage();
+    QMimeDatabaseMemoryUsage(const QMimeDatabaseMemoryUsage &other);
+    QMimeDatabaseMemoryUsage &operator=(const QMimeDatabaseMemoryUsage &other);
+    ~QMimeDatabaseMemoryUsage();
+
+    qint64 heapBytes(Component component) const;
+    qint64 mappedBytes(Component component) const;
+    qint64 totalHeapBytes() const;
+    qint64 totalMappedBytes() const;
+
+    static QString componentName(Component component);
+    QString toString() const;
+
+private:
+    friend class QMimeMemoryUsage;
+    QSharedDataPointer<QMimeDatabaseMemoryUsagePrivate> d;
+};
+
+class QMimeDetectionBudgetPrivate;
+class QMIME_EXPORT QMimeDetectionBudget
+{
+public:
+    QMimeDetectionBudget();
+    QMimeDetectionBudget(const QMimeDetectionBudget &other);
+    QMimeDetectionBudget &operator=(const QMimeDetectionBudget &other);
+    ~QMimeDetectionBudget();
+
+    void setMaxBytes(int bytes);
+    int maxBytes() const;
+    void setMaxRuleEvaluations(int count);
+    int maxRuleEvaluations() const;
+    void setMaxTime(int msecs);
+    int maxTime() const;
+
+    bool isUnlimited() const;
+
+private:
+    QSharedDataPointer<QMimeDetectionBudgetPrivate> d;
+};
+
 class QMimeDatabasePrivate;
 class QMIME_EXPORT QMimeDatabase
 {
@@ -66,6 +178,8 @@ class QMIME_EXPORT QMimeDatabase
 
 public:
     QMimeDatabase();
+    explicit QMimeDatabase(const QStringList &mimeDirectories);
+    explicit QMimeDatabase(const QMimeDatabase *base);
     ~QMimeDatabase();
 
     QMimeType mimeTypeForName(const QString &nameOrAlias) const;
@@ -76,23 +190,86 @@ public:
         MatchContent = 0x2
     };
 
+    enum DetectionFlag {
+        NoDetectionFlags = 0x0,
+        RefineZipContainers = 0x1,
+        AdaptiveMagicOrder = 0x2
+    };
+    Q_DECLARE_FLAGS(DetectionFlags, DetectionFlag)
+
+    void setDetectionFlags(DetectionFlags flags);
+    DetectionFlags detectionFlags() const;
+
+    enum WarmUpFlag {
+        WarmUpNames = 0x1,
+        WarmUpGlobs = 0x2,
+        WarmUpMagic = 0x4,
+        WarmUpHierarchy = 0x8,
+        WarmUpComments = 0x10,
+        WarmUpAll = 0x1f
+    };
+    Q_DECLARE_FLAGS(WarmUpFlags, WarmUpFlag)
+
+    void warmUp(WarmUpFlags flags = WarmUpAll) const;
+
     QMimeType mimeTypeForFile(const QString &fileName, MatchMode mode = MatchDefault) const;
     QMimeType mimeTypeForFile(const QFileInfo &fileInfo, MatchMode mode = MatchDefault) const;
     QList<QMimeType> mimeTypesForFileName(const QString &fileName) const;
+    QMimeType mimeTypeForFileName(const QByteArray &fileName) const;
+    QMimeType mimeTypeForFileName(const char *fileName, int length) const;
+    QList<QMimeType> mimeTypesForFileName(const char *fileName, int length) const;
 
     QMimeType mimeTypeForData(const QByteArray &data) const;
     QMimeType mimeTypeForData(QIODevice *device) const;
+    QMimeType mimeTypeForData(const QByteArray &data, QMimeType *innerType) const;
+    QMimeType mimeTypeForData(QIODevice *device, QMimeType *innerType) const;
+    QMimeType mimeTypeForData(const QByteArray &data, const QMimeDetectionBudget &budget, bool *budgetExhausted = 0) const;
+    QMimeType mimeTypeForData(QIODevice *device, const QMimeDetectionBudget &budget, bool *budgetExhausted = 0) const;
 
     QMimeType mimeTypeForUrl(const QUrl &url) const;
     QMimeType mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device) const;
     QMimeType mimeTypeForFileNameAndData(const QString &fileName, const QByteArray &data) const;
+    QMimeType mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device, const QMimeDetectionBudget &budget, bool *budgetExhausted = 0) const;
     QString suffixForFileName(const QString &fileName) const;
     QList<QMimeType> allMimeTypes() const;
 
+    bool registerMimeTypes(QIODevice *device, QString *errorMessage = 0);
+
+    static bool updateMimeCache(const QString &mimeDirectory, QString *errorMessage = 0);
+
+    bool serve(const QString &socketPath, QString *errorMessage = 0) const;
+
+    QMimeDatabaseStatistics statistics() const;
+    QMimeDatabaseMemoryUsage memoryUsage() const;
+
 private:
+    friend class QMimeDatabasePrivate;
     QMimeDatabasePrivate *d;
 };
 
+class QMimeDatabaseClientPrivate;
+class QMIME_EXPORT QMimeDatabaseClient
+{
+    Q_DISABLE_COPY(QMimeDatabaseClient)
+
+public:
+    explicit QMimeDatabaseClient(const QString &socketPath = QString());
+    ~QMimeDatabaseClient();
+
+    bool isConnected() const;
+
+    QString mimeTypeNameForFile(const QString &fileName, QMimeDatabase::MatchMode mode = QMimeDatabase::MatchDefault);
+    QStringList mimeTypeNamesForFiles(const QStringList &fileNames, QMimeDatabase::MatchMode mode = QMimeDatabase::MatchDefault);
+    QString mimeTypeNameForData(const QByteArray &data);
+    QString mimeTypeNameForFileNameAndData(const QString &fileName, const QByteArray &data);
+
+private:
+    QMimeDatabaseClientPrivate *d;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(QMimeDatabase::DetectionFlags)
+Q_DECLARE_OPERATORS_FOR_FLAGS(QMimeDatabase::WarmUpFlags)
+
 QT_END_NAMESPACE
 
 #endif   // QMIMEDATABASE_H
@@ -44,46 +44,81 @@
 
 #include <QtCore/qhash.h>
 #include <QtCore/qmutex.h>
+#include <QtCore/qpair.h>
 
+#include "qmimedatabase.h"
 #include "qmimetype.h"
 #include "qmimetype_p.h"
 #include "qmimeglobpattern_p.h"
 
 QT_BEGIN_NAMESPACE
 
+class QIODevice;
+class QMimeBudgetTracker;
 class QMimeDatabase;
 class QMimeProviderBase;
+class QMimeOverlayProvider;
 
 class QMimeDatabasePrivate
 {
 public:
     Q_DISABLE_COPY(QMimeDatabasePrivate)
 
-    QMimeDatabasePrivate();
+    explicit QMimeDatabasePrivate(const QStringList &mimeDirectories = QStringList());
+    explicit QMimeDatabasePrivate(QMimeDatabasePrivate *base);
     ~QMimeDatabasePrivate();
 
     static QMimeDatabasePrivate *instance();
+    static inline QMimeDatabasePrivate *get(const QMimeDatabase *database) { return database->d; }
 
     QMimeProviderBase *provider();
+    QMimeProviderBase *baseProvider();
     void setProvider(QMimeProviderBase *theProvider);
+    bool registerMimeTypes(QIODevice *device, QString *errorMessage);
 
     inline QString defaultMimeType() const { return m_defaultMimeType; }
 
+    QStringList locateAll(const QString &fileName, bool directory = false) const;
+    void clearLocateCache();
+    QString writableMimeDirectory() const;
+
     bool inherits(const QString &mime, const QString &parent);
 
     QList<QMimeType> allMimeTypes();
 
 
     QMimeType mimeTypeForName(const QString &nameOrAlias);
-    QMimeType mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device, int *priorityPtr);
-    QMimeType findByData(const QByteArray &data, int *priorityPtr);
+    QMimeType mimeTypeForFileNameAndData(const QString &fileName, QIODevice *device, int *priorityPtr, QMimeBudgetTracker *budget = 0);
+    QMimeType findByData(const QByteArray &data, int *priorityPtr, QIODevice *device = 0, QMimeBudgetTracker *budget = 0);
+    QMimeType findInnerType(const QMimeType &container, const QByteArray &data, QIODevice *device = 0);
+    QMimeType refineZipContainer(const QMimeType &candidate, const QByteArray &data, QIODevice *device);
     QStringList mimeTypeForFileName(const QString &fileName, QString *foundSuffix = 0);
+    QStringList mimeTypeForFileName(const char *fileName, int length, QString *foundSuffix = 0);
+    QMimeType mimeTypeForMatches(QStringList matches);
+    QMimeType matchFileNameAndData(const QString &fileName, QIODevice *device, int *accuracyPtr, int *bytesReadPtr, QMimeBudgetTracker *budget);
 
     mutable QMimeProviderBase *m_provider;
+    QMimeDatabasePrivate *m_base; // for a tenant, the database shared with the other tenants
+    QMimeOverlayProvider *m_overlay; // registered types, on top of m_provider or m_base
     const QString m_defaultMimeType;
+    const QStringList m_mimeDirectories; // empty for the directories from QStandardPaths
+    QMimeDatabase::DetectionFlags m_detectionFlags;
+
+    // A mime directory, and the mime.cache file to use if it was given explicitly
+    typedef QPair<QString, QString> SearchPath;
+    const QList<SearchPath> &searchPaths() const;
+    // Resolved once per provider check, see clearLocateCache(); guarded by m_locateMutex
+    mutable QList<SearchPath> m_searchPaths;
+    mutable QHash<QString, QStringList> m_located;
+    mutable QMutex m_locateMutex;
     QMutex mutex;
 };
 
+// Drops the provider of the default database, for the benchmark of cold starts
+QMIME_AUTOTEST_EXPORT void qmime_resetProvider();
+// The MIME types of the magic matchers of database, in the order learned for QMimeDatabase::AdaptiveMagicOrder
+QMIME_AUTOTEST_EXPORT QStringList qmime_adaptiveMagicOrder(const QMimeDatabase &database);
+
 QT_END_NAMESPACE
 
 #endif   // QMIMEDATABASE_P_H
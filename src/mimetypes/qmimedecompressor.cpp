@@ -0,0 +1,286 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimedecompressor_p.h"
+
+#include <QtCore/QIODevice>
+
+#include <string.h>
+
+#ifdef QMIME_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef QMIME_HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef QMIME_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeDecompressor
+
+    \brief The QMimeDecompressor class inflates the beginning of compressed data.
+
+    Only the first bytes of the payload are produced, so that magic can look at
+    them: memory is bounded by the output size and the work stops as soon as the
+    output buffer is full, however large the input is.
+
+    The data peeked for magic isn't always enough: bzip2 produces nothing before
+    a whole block (up to 900 KB of payload) was read. So for a random-access
+    device, the compressed data that follows is read too, in chunks, until the
+    output buffer is full or MaxInputSize bytes were read.
+
+    gzip needs zlib (QMIME_HAVE_ZLIB), bzip2 needs libbz2 (QMIME_HAVE_BZIP2)
+    and xz needs liblzma (QMIME_HAVE_LZMA); see mimetypes.pri.
+ */
+
+enum Format {
+    UnknownFormat,
+    GzipFormat,
+    Bzip2Format,
+    XzFormat
+};
+
+static Format formatOf(const QByteArray &data)
+{
+#ifdef QMIME_HAVE_ZLIB
+    if (data.startsWith("\x1f\x8b"))
+        return GzipFormat;
+#endif
+#ifdef QMIME_HAVE_BZIP2
+    if (data.startsWith("BZh"))
+        return Bzip2Format;
+#endif
+#ifdef QMIME_HAVE_LZMA
+    if (data.startsWith(QByteArray("\xfd" "7zXZ\0", 6)))
+        return XzFormat;
+#endif
+    Q_UNUSED(data);
+    return UnknownFormat;
+}
+
+// The compressed stream: the data given, then, for a random-access device, what
+// follows it in the device, up to MaxInputSize bytes in all. The position of the
+// device is restored when done.
+class QMimeCompressedInput
+{
+public:
+    QMimeCompressedInput(const QByteArray &data, QIODevice *device)
+        : m_data(data), m_device(device && !device->isSequential() ? device : 0),
+          m_startPos(m_device ? m_device->pos() : 0), m_read(0), m_seeked(false)
+    {}
+
+    ~QMimeCompressedInput()
+    {
+        if (m_seeked)
+            m_device->seek(m_startPos);
+    }
+
+    // Returns the next chunk of compressed data, an empty one at the end
+    QByteArray next()
+    {
+        if (m_read == 0) {
+            m_read = m_data.size();
+            return m_data;
+        }
+        if (!m_device || m_read >= QMimeDecompressor::MaxInputSize)
+            return QByteArray();
+        m_seeked = true;
+        if (!m_device->seek(m_startPos + m_read))
+            return QByteArray();
+        const QByteArray chunk = m_device->read(qMin<qint64>(ChunkSize, QMimeDecompressor::MaxInputSize - m_read));
+        m_read += chunk.size();
+        return chunk;
+    }
+
+private:
+    enum { ChunkSize = 65536 };
+
+    const QByteArray &m_data;
+    QIODevice *m_device;
+    const qint64 m_startPos;
+    qint64 m_read;
+    bool m_seeked;
+};
+
+#ifdef QMIME_HAVE_ZLIB
+static int inflateGzip(QMimeCompressedInput &input, char *out, int maxSize)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) // gzip header only
+        return 0;
+    stream.next_out = reinterpret_cast<Bytef *>(out);
+    stream.avail_out = maxSize;
+    QByteArray chunk;
+    int ret = Z_OK;
+    while (ret == Z_OK && stream.avail_out > 0) {
+        if (stream.avail_in == 0) {
+            chunk = input.next();
+            if (chunk.isEmpty())
+                break;
+            stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(chunk.constData()));
+            stream.avail_in = chunk.size();
+        }
+        ret = inflate(&stream, Z_NO_FLUSH);
+    }
+    const int size = maxSize - stream.avail_out;
+    inflateEnd(&stream);
+    return size;
+}
+#endif
+
+#ifdef QMIME_HAVE_BZIP2
+static int inflateBzip2(QMimeCompressedInput &input, char *out, int maxSize)
+{
+    bz_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (BZ2_bzDecompressInit(&stream, 0, 1) != BZ_OK) // small: at most 2.5 bytes per block byte
+        return 0;
+    stream.next_out = out;
+    stream.avail_out = maxSize;
+    QByteArray chunk;
+    int ret = BZ_OK;
+    while (ret == BZ_OK && stream.avail_out > 0) {
+        if (stream.avail_in == 0) {
+            chunk = input.next();
+            if (chunk.isEmpty())
+                break;
+            stream.next_in = const_cast<char *>(chunk.constData());
+            stream.avail_in = chunk.size();
+        }
+        ret = BZ2_bzDecompress(&stream);
+    }
+    const int size = maxSize - stream.avail_out;
+    BZ2_bzDecompressEnd(&stream);
+    return size;
+}
+#endif
+
+#ifdef QMIME_HAVE_LZMA
+static int inflateXz(QMimeCompressedInput &input, char *out, int maxSize)
+{
+    lzma_stream stream = LZMA_STREAM_INIT;
+    // The dictionary of the default presets is 8 MiB, be generous but bounded
+    if (lzma_stream_decoder(&stream, 64 * 1024 * 1024, 0) != LZMA_OK)
+        return 0;
+    stream.next_out = reinterpret_cast<uint8_t *>(out);
+    stream.avail_out = maxSize;
+    QByteArray chunk;
+    lzma_ret ret = LZMA_OK;
+    while (ret == LZMA_OK && stream.avail_out > 0) {
+        if (stream.avail_in == 0) {
+            chunk = input.next();
+            if (chunk.isEmpty())
+                break;
+            stream.next_in = reinterpret_cast<const uint8_t *>(chunk.constData());
+            stream.avail_in = chunk.size();
+        }
+        ret = lzma_code(&stream, LZMA_RUN);
+    }
+    const int size = maxSize - stream.avail_out;
+    lzma_end(&stream);
+    return size;
+}
+#endif
+
+/*!
+    Returns true if \a data starts like a compressed stream this build can inflate.
+ */
+bool QMimeDecompressor::canDecompress(const QByteArray &data)
+{
+    return formatOf(data) != UnknownFormat;
+}
+
+/*!
+    Returns the first \a maxSize bytes (at most MaxOutputSize) of the payload of
+    \a data, fewer if \a data is truncated or corrupt, or an empty array if the
+    format isn't supported.
+ */
+QByteArray QMimeDecompressor::decompress(const QByteArray &data, int maxSize)
+{
+    return decompress(data, 0, maxSize);
+}
+
+/*!
+    \overload
+
+    \a data was peeked from the current position of \a device. If \a device is
+    not sequential, the compressed data after \a data is read as well when
+    \a data doesn't hold enough of the payload, up to MaxInputSize bytes in all,
+    and the position of \a device is restored afterwards.
+ */
+QByteArray QMimeDecompressor::decompress(const QByteArray &data, QIODevice *device, int maxSize)
+{
+    maxSize = qBound(0, maxSize, int(MaxOutputSize));
+    QMimeCompressedInput input(data, device);
+    QByteArray result(maxSize, Qt::Uninitialized);
+    int size = 0;
+    switch (formatOf(data)) {
+#ifdef QMIME_HAVE_ZLIB
+    case GzipFormat:
+        size = inflateGzip(input, result.data(), maxSize);
+        break;
+#endif
+#ifdef QMIME_HAVE_BZIP2
+    case Bzip2Format:
+        size = inflateBzip2(input, result.data(), maxSize);
+        break;
+#endif
+#ifdef QMIME_HAVE_LZMA
+    case XzFormat:
+        size = inflateXz(input, result.data(), maxSize);
+        break;
+#endif
+    default:
+        break;
+    }
+    result.resize(size);
+    return result;
+}
+
+QT_END_NAMESPACE
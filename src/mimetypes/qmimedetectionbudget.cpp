@@ -0,0 +1,193 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimedetectionbudget_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMimeDetectionBudget
+    \brief The QMimeDetectionBudget class bounds the work done to find the MIME type of some data.
+
+    Some magic rules are expensive on hostile data, for instance string rules
+    with a mask that are looked for over a long range of offsets. A budget caps
+    the number of bytes looked at, the number of magic rules evaluated and the
+    time spent in one call to QMimeDatabase::mimeTypeForData() or
+    QMimeDatabase::mimeTypeForFileNameAndData(). When the budget is exhausted,
+    these return the best match found so far and say so.
+
+    All the limits are -1, meaning unlimited, by default.
+
+    \sa QMimeDatabase::mimeTypeForData()
+*/
+
+QMimeDetectionBudgetPrivate::QMimeDetectionBudgetPrivate()
+    : maxBytes(-1), maxRuleEvaluations(-1), maxTime(-1)
+{
+}
+
+/*!
+    Constructs an unlimited budget.
+*/
+QMimeDetectionBudget::QMimeDetectionBudget()
+    : d(new QMimeDetectionBudgetPrivate)
+{
+}
+
+/*!
+    Constructs a copy of \a other.
+*/
+QMimeDetectionBudget::QMimeDetectionBudget(const QMimeDetectionBudget &other)
+    : d(other.d)
+{
+}
+
+/*!
+    Assigns \a other to this budget.
+*/
+QMimeDetectionBudget &QMimeDetectionBudget::operator=(const QMimeDetectionBudget &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Destroys the budget.
+*/
+QMimeDetectionBudget::~QMimeDetectionBudget()
+{
+}
+
+/*!
+    Sets the number of bytes of data looked at to \a bytes, or to unlimited if
+    \a bytes is negative.
+
+    Data beyond \a bytes is ignored, and less is read from a device. The budget
+    counts as exhausted only when magic rules would have looked further.
+*/
+void QMimeDetectionBudget::setMaxBytes(int bytes)
+{
+    d->maxBytes = qMax(bytes, -1);
+}
+
+/*!
+    Returns the number of bytes of data looked at, or -1 for unlimited.
+*/
+int QMimeDetectionBudget::maxBytes() const
+{
+    return d->maxBytes;
+}
+
+/*!
+    Sets the number of magic rules evaluated to \a count, or to unlimited if
+    \a count is negative. Every rule counts, sub-rules included.
+*/
+void QMimeDetectionBudget::setMaxRuleEvaluations(int count)
+{
+    d->maxRuleEvaluations = qMax(count, -1);
+}
+
+/*!
+    Returns the number of magic rules evaluated, or -1 for unlimited.
+*/
+int QMimeDetectionBudget::maxRuleEvaluations() const
+{
+    return d->maxRuleEvaluations;
+}
+
+/*!
+    Sets the time spent matching magic rules to \a msecs milliseconds, or to
+    unlimited if \a msecs is negative.
+
+    The clock is only read every few rules, and a single rule is not
+    interrupted, so the time can be exceeded by the duration of a few rules.
+*/
+void QMimeDetectionBudget::setMaxTime(int msecs)
+{
+    d->maxTime = qMax(msecs, -1);
+}
+
+/*!
+    Returns the time spent matching magic rules in milliseconds, or -1 for unlimited.
+*/
+int QMimeDetectionBudget::maxTime() const
+{
+    return d->maxTime;
+}
+
+/*!
+    Returns true if none of the limits is set.
+*/
+bool QMimeDetectionBudget::isUnlimited() const
+{
+    return d->maxBytes < 0 && d->maxRuleEvaluations < 0 && d->maxTime < 0;
+}
+
+QMimeBudgetTracker::QMimeBudgetTracker()
+    : m_maxBytes(-1),
+      m_maxRuleEvaluations(-1),
+      m_maxTime(-1),
+      m_evaluations(0),
+      m_bytesCompared(0),
+      m_exhausted(false),
+      m_dataTruncated(false)
+{
+}
+
+/*
+   The clock starts with the tracker, that is with the call using the budget.
+ */
+QMimeBudgetTracker::QMimeBudgetTracker(const QMimeDetectionBudget &budget)
+    : m_maxBytes(budget.maxBytes()),
+      m_maxRuleEvaluations(budget.maxRuleEvaluations()),
+      m_maxTime(budget.maxTime()),
+      m_evaluations(0),
+      m_bytesCompared(0),
+      m_exhausted(false),
+      m_dataTruncated(false)
+{
+    if (m_maxTime >= 0)
+        m_timer.start();
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,114 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEDETECTIONBUDGET_P_H
+#define QMIMEDETECTIONBUDGET_P_H
+
+#include "qmimedatabase.h"
+
+#include <QtCore/qelapsedtimer.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMimeDetectionBudgetPrivate : public QSharedData
+{
+public:
+    QMimeDetectionBudgetPrivate();
+
+    int maxBytes;
+    int maxRuleEvaluations;
+    int maxTime;
+};
+
+/*
+   What is left of a QMimeDetectionBudget during one call. The providers call
+   spend() before evaluating a magic rule and give up once it returns false,
+   keeping the best match found so far. A null tracker means no budget.
+   The tracker also counts what the rules cost, for QMimeMagicProfile.
+ */
+class QMimeBudgetTracker
+{
+    Q_DISABLE_COPY(QMimeBudgetTracker)
+
+public:
+    QMimeBudgetTracker(); // unlimited, only counts
+    explicit QMimeBudgetTracker(const QMimeDetectionBudget &budget);
+
+    int maxBytes() const { return m_maxBytes; }
+    // No more rules can be evaluated
+    bool isExhausted() const { return m_exhausted; }
+    // Magic rules would have looked further than maxBytes()
+    void setDataTruncated() { m_dataTruncated = true; }
+    // The result may differ from the one without a budget
+    bool isResultLimited() const { return m_exhausted || m_dataTruncated; }
+
+    int evaluations() const { return m_evaluations; }
+    qint64 bytesCompared() const { return m_bytesCompared; }
+
+    // bytes is how much data the rule compares, at most
+    inline bool spend(int bytes)
+    {
+        if (m_exhausted)
+            return false;
+        ++m_evaluations;
+        m_bytesCompared += bytes;
+        if (m_maxRuleEvaluations >= 0 && m_evaluations > m_maxRuleEvaluations)
+            m_exhausted = true;
+        // Reading the clock costs more than most rules, look at it every 16 rules
+        else if (m_maxTime >= 0 && (m_evaluations & 15) == 1 && m_timer.elapsed() > m_maxTime)
+            m_exhausted = true;
+        return !m_exhausted;
+    }
+
+private:
+    const int m_maxBytes;
+    const int m_maxRuleEvaluations;
+    const int m_maxTime;
+    int m_evaluations;
+    qint64 m_bytesCompared;
+    bool m_exhausted;
+    bool m_dataTruncated;
+    QElapsedTimer m_timer;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEDETECTIONBUDGET_P_H
@@ -0,0 +1,371 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimeglobfilter_p.h"
+
+#include "qmimememoryusage_p.h"
+
+#include <string.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeGlobFilter
+
+    \brief The QMimeGlobFilter class rejects quickly the file names that match no glob pattern of a mime.cache file.
+
+    It is a Bloom filter over keys that any name matching a pattern must have:
+    the whole lowercased name for a literal, its first characters for a pattern
+    like "README*", its last characters for a suffix like "*.txt". A name with
+    none of its keys in the filter matches no pattern, and the glob lists and
+    the suffix tree don't need to be looked at. Other names may or may not match.
+
+    Character sets like "[0-9]" give one key per character. A pattern without
+    any usable key, like "*foo*", makes the filter complete no more, and every
+    name may then match.
+
+    Building is done once, when the mime.cache file is loaded.
+*/
+
+// Bits of the filter per key, and bits set per key: about 0.5% of false positives per key
+static const uint bitsPerKey = 16;
+static const int probes = 3;
+// Larger sets or combinations of sets are looked for at the other end of the pattern
+static const int maxSetSize = 64;
+static const int maxCombinations = 256;
+
+static inline uint mix(uint h)
+{
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline char asciiLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+static inline ushort lower(uint c)
+{
+    return QChar(ushort(c)).toLower().unicode();
+}
+
+// One position of a glob pattern: what the character of a matching name, lowercased, can be
+struct GlobPosition
+{
+    enum Type { Star, Any, Set };
+
+    GlobPosition() : type(Set) {}
+    void add(uint c)
+    {
+        const QChar ch(lower(c));
+        if (!chars.contains(ch))
+            chars += ch;
+    }
+
+    Type type;
+    QString chars; // for Set
+};
+
+// Parses "[...]" the way QMimeBinaryProvider matches it. The set holds both
+// the lowercased characters of the range and the range of the lowercased
+// bounds, for the case-sensitive and the case-insensitive patterns.
+static bool parseSet(const char *&pattern, GlobPosition *position)
+{
+    const char *p = pattern + 1;
+    const bool negate = *p == '!' || *p == '^';
+    if (negate)
+        ++p;
+    const char *setStart = p;
+    GlobPosition set;
+    while (*p && (*p != ']' || p == setStart)) {
+        const uchar first = *p;
+        uchar last = *p;
+        if (p[1] == '-' && p[2] && p[2] != ']') {
+            last = p[2];
+            p += 3;
+        } else {
+            ++p;
+        }
+        for (uint c = first; c <= last && set.chars.size() <= maxSetSize; ++c)
+            set.add(c);
+        for (uint c = uchar(asciiLower(first)); c <= uchar(asciiLower(last)) && set.chars.size() <= maxSetSize; ++c)
+            set.add(c);
+    }
+    if (*p != ']')
+        return false; // no closing bracket, the '[' is a literal
+    pattern = p + 1;
+    if (negate || set.chars.size() > maxSetSize)
+        position->type = GlobPosition::Any;
+    else
+        *position = set;
+    return true;
+}
+
+static QVector<GlobPosition> globPositions(const char *pattern)
+{
+    QVector<GlobPosition> positions;
+    for (const char *p = pattern; *p; ) {
+        GlobPosition position;
+        if (*p == '*' || *p == '?') {
+            position.type = *p == '*' ? GlobPosition::Star : GlobPosition::Any;
+            ++p;
+        } else if (*p != '[' || !parseSet(p, &position)) {
+            position.add(uchar(*p++));
+        }
+        positions.append(position);
+    }
+    return positions;
+}
+
+static inline bool isSet(const QVector<GlobPosition> &positions, int i)
+{
+    return positions.at(i).type == GlobPosition::Set;
+}
+
+QMimeGlobFilter::QMimeGlobFilter()
+    : m_mask(0), m_kinds(0), m_complete(true)
+{
+}
+
+void QMimeGlobFilter::clear()
+{
+    m_pending.clear();
+    m_bits.clear();
+    m_mask = 0;
+    m_kinds = 0;
+    m_complete = true;
+}
+
+void QMimeGlobFilter::addKey(uint h, Kind kind)
+{
+    m_pending.append(h);
+    m_kinds |= kind;
+}
+
+void QMimeGlobFilter::addKeys(Kind kind, const QString &first, const QString &second)
+{
+    foreach (const QChar c1, first) {
+        const uint h = hashNext(hashStart(kind), c1.unicode());
+        if (second.isNull()) {
+            addKey(h, kind);
+            continue;
+        }
+        foreach (const QChar c2, second)
+            addKey(hashNext(h, c2.unicode()), kind);
+    }
+}
+
+/*
+   Adds the keys of a pattern from the literal or the glob list of mime.cache,
+   in Latin-1 like QMimeBinaryProvider reads it. Returns false if no key could
+   be found, the filter then lets every name through.
+ */
+bool QMimeGlobFilter::addPattern(const char *pattern)
+{
+    // Escapes are left to QRegExp
+    if (!*pattern || strchr(pattern, '\\')) {
+        m_complete = false;
+        return false;
+    }
+
+    const QVector<GlobPosition> positions = globPositions(pattern);
+    const int count = positions.size();
+    int firstStar = count;
+    int lastStar = -1;
+    bool literal = true;
+    for (int i = 0; i < count; ++i) {
+        if (positions.at(i).type == GlobPosition::Star) {
+            firstStar = qMin(firstStar, i);
+            lastStar = i;
+        }
+        literal = literal && isSet(positions, i) && positions.at(i).chars.size() == 1;
+    }
+
+    if (literal) {
+        uint h = hashStart(Literal);
+        for (int i = 0; i < count; ++i)
+            h = hashNext(h, positions.at(i).chars.at(0).unicode());
+        addKey(h, Literal);
+        return true;
+    }
+
+    const int suffixLength = count - lastStar - 1;
+    if (firstStar >= 2 && isSet(positions, 0) && isSet(positions, 1)
+        && positions.at(0).chars.size() * positions.at(1).chars.size() <= maxCombinations) {
+        addKeys(Prefix2, positions.at(0).chars, positions.at(1).chars);
+        return true;
+    }
+    if (suffixLength >= 2 && isSet(positions, count - 2) && isSet(positions, count - 1)
+        && positions.at(count - 2).chars.size() * positions.at(count - 1).chars.size() <= maxCombinations) {
+        addKeys(Suffix2, positions.at(count - 2).chars, positions.at(count - 1).chars);
+        return true;
+    }
+    if (firstStar >= 1 && isSet(positions, 0)) {
+        addKeys(Prefix1, positions.at(0).chars, QString());
+        return true;
+    }
+    if (suffixLength >= 1 && isSet(positions, count - 1)) {
+        addKeys(Suffix1, positions.at(count - 1).chars, QString());
+        return true;
+    }
+    m_complete = false;
+    return false;
+}
+
+// A suffix of the reverse suffix tree, one character long
+void QMimeGlobFilter::addSuffix(uint last)
+{
+    addKey(hashNext(hashStart(Suffix1), lower(last)), Suffix1);
+}
+
+// A suffix of the reverse suffix tree, at least two characters long
+void QMimeGlobFilter::addSuffix(uint beforeLast, uint last)
+{
+    addKey(hashNext(hashNext(hashStart(Suffix2), lower(beforeLast)), lower(last)), Suffix2);
+}
+
+void QMimeGlobFilter::build()
+{
+    m_bits.clear();
+    m_mask = 0;
+    if (m_pending.isEmpty())
+        return;
+
+    uint size = 32;
+    while (size < uint(m_pending.size()) * bitsPerKey)
+        size <<= 1;
+    m_bits.fill(0, size / 32);
+    m_mask = size - 1;
+    foreach (uint h, m_pending) {
+        h = mix(h);
+        const uint step = ((h >> 16) | (h << 16)) | 1;
+        for (int i = 0; i < probes; ++i, h += step)
+            m_bits[(h & m_mask) >> 5] |= 1u << (h & 31);
+    }
+    m_pending.clear();
+    m_pending.squeeze();
+}
+
+bool QMimeGlobFilter::contains(uint h) const
+{
+    if (m_bits.isEmpty())
+        return false;
+    h = mix(h);
+    const uint step = ((h >> 16) | (h << 16)) | 1;
+    const quint32 *bits = m_bits.constData();
+    for (int i = 0; i < probes; ++i, h += step) {
+        if (!(bits[(h & m_mask) >> 5] & (1u << (h & 31))))
+            return false;
+    }
+    return true;
+}
+
+bool QMimeGlobFilter::mayMatch(const QString &lowerFileName) const
+{
+    if (!m_complete)
+        return true;
+    const int length = lowerFileName.length();
+    if (length == 0)
+        return false;
+    const ushort *name = lowerFileName.utf16();
+
+    if ((m_kinds & Prefix1) && contains(hashNext(hashStart(Prefix1), name[0])))
+        return true;
+    if ((m_kinds & Suffix1) && contains(hashNext(hashStart(Suffix1), name[length - 1])))
+        return true;
+    if (length >= 2) {
+        if ((m_kinds & Prefix2) && contains(hashNext(hashNext(hashStart(Prefix2), name[0]), name[1])))
+            return true;
+        if ((m_kinds & Suffix2) && contains(hashNext(hashNext(hashStart(Suffix2), name[length - 2]), name[length - 1])))
+            return true;
+    }
+    if (m_kinds & Literal) {
+        uint h = hashStart(Literal);
+        for (int i = 0; i < length; ++i)
+            h = hashNext(h, name[i]);
+        return contains(h);
+    }
+    return false;
+}
+
+bool QMimeGlobFilter::mayMatch(const char *fileName, int length) const
+{
+    if (!m_complete)
+        return true;
+    if (length == 0)
+        return false;
+    const ushort first = uchar(asciiLower(fileName[0]));
+    const ushort last = uchar(asciiLower(fileName[length - 1]));
+
+    if ((m_kinds & Prefix1) && contains(hashNext(hashStart(Prefix1), first)))
+        return true;
+    if ((m_kinds & Suffix1) && contains(hashNext(hashStart(Suffix1), last)))
+        return true;
+    if (length >= 2) {
+        const ushort second = uchar(asciiLower(fileName[1]));
+        const ushort beforeLast = uchar(asciiLower(fileName[length - 2]));
+        if ((m_kinds & Prefix2) && contains(hashNext(hashNext(hashStart(Prefix2), first), second)))
+            return true;
+        if ((m_kinds & Suffix2) && contains(hashNext(hashNext(hashStart(Suffix2), beforeLast), last)))
+            return true;
+    }
+    if (m_kinds & Literal) {
+        uint h = hashStart(Literal);
+        for (int i = 0; i < length; ++i)
+            h = hashNext(h, uchar(asciiLower(fileName[i])));
+        return contains(h);
+    }
+    return false;
+}
+
+// For QMimeDatabase::memoryUsage(), see QMimeMemoryUsage
+qint64 QMimeGlobFilter::heapSize() const
+{
+    return QMimeMemoryUsage::heapSize(m_pending) + QMimeMemoryUsage::heapSize(m_bits);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,96 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEGLOBFILTER_P_H
+#define QMIMEGLOBFILTER_P_H
+
+#include <QtCore/qstring.h>
+#include <QtCore/qvector.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMimeGlobFilter
+{
+public:
+    QMimeGlobFilter();
+
+    void clear();
+    bool addPattern(const char *pattern);
+    void addSuffix(uint last);
+    void addSuffix(uint beforeLast, uint last);
+    void build();
+
+    inline bool isComplete() const { return m_complete; }
+
+    // lowerFileName is the name lowercased with QString::toLower()
+    bool mayMatch(const QString &lowerFileName) const;
+    // An ASCII name, in any case
+    bool mayMatch(const char *fileName, int length) const;
+
+    qint64 heapSize() const;
+
+private:
+    // What a key says about the names matching a pattern
+    enum Kind {
+        Literal = 0x1, // the whole name
+        Prefix1 = 0x2, // its first character
+        Prefix2 = 0x4, // its first two characters
+        Suffix1 = 0x8, // its last character
+        Suffix2 = 0x10 // its last two characters
+    };
+
+    static inline uint hashStart(Kind kind) { return 2166136261u ^ uint(kind); }
+    static inline uint hashNext(uint h, ushort c) { return (h ^ c) * 16777619u; }
+
+    void addKey(uint h, Kind kind);
+    void addKeys(Kind kind, const QString &first, const QString &second);
+    bool contains(uint h) const;
+
+    QVector<uint> m_pending; // the hashes of the keys, until build()
+    QVector<quint32> m_bits;
+    uint m_mask;
+    int m_kinds;
+    bool m_complete; // false if a pattern had no key, then every name may match
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEGLOBFILTER_P_H
@@ -41,10 +41,14 @@
 
 #include "qmimeglobpattern_p.h"
 
+#include "qmimememoryusage_p.h"
+
 #include <QRegExp>
 #include <QStringList>
 #include <QDebug>
 
+#include <string.h>
+
 QT_BEGIN_NAMESPACE
 
 /*!
@@ -53,32 +57,127 @@ QT_BEGIN_NAMESPACE
     \brief The QMimeGlobMatchResult class accumulates results from glob matching.
 
     Handles glob weights, and preferring longer matches over shorter matches.
+
+    Matches are recorded as references to the MIME type names owned by the glob
+    tables (or mime.cache) plus pattern lengths, so that matching a file name
+    doesn't allocate; the strings are only created by matchingMimeTypes() and
+    foundSuffix().
 */
 
-void QMimeGlobMatchResult::addMatch(const QString &mimeType, int weight, const QString &pattern)
+bool QMimeGlobMatchResult::addMatchedType(const MatchedType &mimeType, int weight, int patternLength)
 {
     // Is this a lower-weight pattern than the last match? Skip this match then.
     if (weight < m_weight)
-        return;
+        return false;
     bool replace = weight > m_weight;
     if (!replace) {
         // Compare the length of the match
-        if (pattern.length() < m_matchingPatternLength)
-            return; // too short, ignore
-        else if (pattern.length() > m_matchingPatternLength) {
+        if (patternLength < m_matchingPatternLength)
+            return false; // too short, ignore
+        else if (patternLength > m_matchingPatternLength) {
             // longer: clear any previous match (like *.bz2, when pattern is *.tar.bz2)
             replace = true;
         }
     }
     if (replace) {
-        m_matchingMimeTypes.clear();
+        m_matches.clear();
         // remember the new "longer" length
-        m_matchingPatternLength = pattern.length();
+        m_matchingPatternLength = patternLength;
         m_weight = weight;
     }
-    m_matchingMimeTypes.append(mimeType);
-    if (pattern.startsWith(QLatin1String("*.")))
-        m_foundSuffix = pattern.mid(2);
+    m_matches.append(mimeType);
+    return true;
+}
+
+// The pattern is '*' followed by the tail, so it starts with "*." if the tail starts with '.'
+void QMimeGlobMatchResult::setSuffixFromTail(bool tailIsSuffix, int tailLength, bool lowerCase)
+{
+    if (tailIsSuffix && tailLength > 0) {
+        m_suffixPattern = 0;
+        m_suffixPatternLatin1 = 0;
+        m_suffixLength = tailLength - 1;
+        m_suffixIsLowerCase = lowerCase;
+    }
+}
+
+void QMimeGlobMatchResult::addMatch(const QString &mimeType, int weight, const QString &pattern)
+{
+    if (addMatchedType(matchedType(mimeType), weight, pattern.length())
+            && pattern.startsWith(QLatin1String("*."))) {
+        m_suffixPattern = &pattern;
+        m_suffixPatternLatin1 = 0;
+        m_suffixLength = 0;
+    }
+}
+
+void QMimeGlobMatchResult::addMatch(const char *mimeType, int weight, const char *pattern)
+{
+    if (addMatchedType(matchedType(mimeType), weight, qstrlen(pattern))
+            && pattern[0] == '*' && pattern[1] == '.') {
+        m_suffixPattern = 0;
+        m_suffixPatternLatin1 = pattern;
+        m_suffixLength = 0;
+    }
+}
+
+void QMimeGlobMatchResult::addTailMatch(const QString &mimeType, int weight, const QString &fileName, int tailLength, bool lowerCase)
+{
+    if (addMatchedType(matchedType(mimeType), weight, tailLength + 1))
+        setSuffixFromTail(fileName.at(fileName.length() - tailLength) == QLatin1Char('.'), tailLength, lowerCase);
+}
+
+void QMimeGlobMatchResult::addTailMatch(const char *mimeType, int weight, const QString &fileName, int tailLength, bool lowerCase)
+{
+    if (addMatchedType(matchedType(mimeType), weight, tailLength + 1))
+        setSuffixFromTail(fileName.at(fileName.length() - tailLength) == QLatin1Char('.'), tailLength, lowerCase);
+}
+
+void QMimeGlobMatchResult::addTailMatch(const char *mimeType, int weight, const char *fileName, int length, int tailLength, bool lowerCase)
+{
+    if (addMatchedType(matchedType(mimeType), weight, tailLength + 1))
+        setSuffixFromTail(fileName[length - tailLength] == '.', tailLength, lowerCase);
+}
+
+QStringList QMimeGlobMatchResult::matchingMimeTypes() const
+{
+    QStringList result;
+    result.reserve(m_matches.size());
+    for (int i = 0; i < m_matches.size(); ++i) {
+        const MatchedType &mimeType = m_matches.at(i);
+        result.append(mimeType.name ? *mimeType.name : QString::fromLatin1(mimeType.latin1));
+    }
+    return result;
+}
+
+/*!
+    Returns the suffix of the last "*.suffix" pattern that matched \a fileName,
+    which must be the file name given to the matching methods.
+*/
+QString QMimeGlobMatchResult::foundSuffix(const QString &fileName) const
+{
+    if (m_suffixPattern)
+        return m_suffixPattern->mid(2);
+    if (m_suffixPatternLatin1)
+        return QString::fromLatin1(m_suffixPatternLatin1 + 2);
+    if (m_suffixLength > 0) {
+        const QString suffix = fileName.right(m_suffixLength);
+        return m_suffixIsLowerCase ? suffix.toLower() : suffix;
+    }
+    return QString();
+}
+
+/*!
+    \overload
+
+    For a file name given as the \a length bytes at \a fileName, which are only
+    ever ASCII when they reach the matching methods.
+*/
+QString QMimeGlobMatchResult::foundSuffix(const char *fileName, int length) const
+{
+    if (m_suffixPattern || m_suffixPatternLatin1 || m_suffixLength == 0)
+        return foundSuffix(QString());
+    const QString suffix = QString::fromLatin1(fileName + length - m_suffixLength, m_suffixLength);
+    return m_suffixIsLowerCase ? suffix.toLower() : suffix;
 }
 
 /*!
@@ -150,21 +249,209 @@ static bool isFastPattern(const QString &pattern)
       ;
 }
 
+QMimeFastPatterns::QMimeFastPatterns()
+    : m_count(0)
+{
+}
+
+// The extension lowercased into key, character by character like QString::toLower().
+// Returns false if it doesn't fit: empty, too long, or not in Latin-1 once lowercased.
+bool QMimeFastPatterns::fold(const QChar *extension, int length, char *key)
+{
+    if (length == 0 || length > MaxKeyLength)
+        return false;
+    for (int i = 0; i < length; ++i) {
+        ushort c = extension[i].unicode();
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        else if (c >= 0x80)
+            c = extension[i].toLower().unicode();
+        if (c > 0xff)
+            return false;
+        key[i] = char(c);
+    }
+    return true;
+}
+
+// FNV-1a
+uint QMimeFastPatterns::hash(const char *key, int length)
+{
+    uint h = 2166136261u;
+    for (int i = 0; i < length; ++i)
+        h = (h ^ uchar(key[i])) * 16777619u;
+    return h;
+}
+
+// The slot of key, or the free slot where it would go
+int QMimeFastPatterns::find(const char *key, int length) const
+{
+    const int mask = m_slots.size() - 1;
+    for (int i = hash(key, length) & mask; ; i = (i + 1) & mask) {
+        const Slot &slot = m_slots.at(i);
+        if (slot.keyLength == 0 || (slot.keyLength == length && memcmp(slot.key, key, length) == 0))
+            return i;
+    }
+}
+
+void QMimeFastPatterns::rehash(int capacity)
+{
+    const QVector<Slot> oldSlots = m_slots;
+    m_slots = QVector<Slot>(capacity);
+    foreach (const Slot &slot, oldSlots) {
+        if (slot.keyLength)
+            m_slots[find(slot.key, slot.keyLength)] = slot;
+    }
+}
+
+quint16 QMimeFastPatterns::typeId(const QString &mimeType)
+{
+    const QHash<QString, int>::const_iterator it = m_typeIds.constFind(mimeType);
+    if (it != m_typeIds.constEnd())
+        return it.value();
+    Q_ASSERT(m_mimeTypes.size() <= 0xffff);
+    const quint16 id = m_mimeTypes.size();
+    m_mimeTypes.append(mimeType);
+    m_typeIds.insert(mimeType, id);
+    return id;
+}
+
+void QMimeFastPatterns::appendType(Slot &slot, quint16 type)
+{
+    if (slot.typeCount < InlineTypes) {
+        slot.types[slot.typeCount++] = type;
+        return;
+    }
+    if (slot.typeCount == InlineTypes) {
+        QVector<quint16> overflow;
+        for (int i = 0; i < InlineTypes; ++i)
+            overflow.append(slot.types[i]);
+        slot.types[0] = m_overflow.size();
+        m_overflow.append(overflow);
+    }
+    m_overflow[slot.types[0]].append(type);
+    ++slot.typeCount;
+}
+
+static void removeAll(QVector<quint16> &types, quint16 type)
+{
+    int kept = 0;
+    for (int i = 0; i < types.size(); ++i) {
+        if (types.at(i) != type)
+            types[kept++] = types.at(i);
+    }
+    types.resize(kept);
+}
+
+void QMimeFastPatterns::removeType(Slot &slot, quint16 type)
+{
+    if (slot.typeCount <= InlineTypes) {
+        int kept = 0;
+        for (int i = 0; i < slot.typeCount; ++i) {
+            if (slot.types[i] != type)
+                slot.types[kept++] = slot.types[i];
+        }
+        slot.typeCount = kept;
+        return;
+    }
+    QVector<quint16> &overflow = m_overflow[slot.types[0]];
+    removeAll(overflow, type);
+    slot.typeCount = overflow.size();
+    if (slot.typeCount <= InlineTypes) {
+        // Back inline; the overflow entry stays, empty
+        const QVector<quint16> remaining = overflow;
+        overflow.clear();
+        for (int i = 0; i < remaining.size(); ++i)
+            slot.types[i] = remaining.at(i);
+    }
+}
+
+void QMimeFastPatterns::add(const QString &extension, const QString &mimeType)
+{
+    const quint16 type = typeId(mimeType);
+    char key[MaxKeyLength];
+    if (!fold(extension.constData(), extension.size(), key)) {
+        m_otherExtensions[extension].append(type);
+        return;
+    }
+    if (2 * (m_count + 1) > m_slots.size())
+        rehash(qMax(64, 2 * m_slots.size()));
+    Slot &slot = m_slots[find(key, extension.size())];
+    if (slot.keyLength == 0) {
+        memcpy(slot.key, key, extension.size());
+        slot.keyLength = extension.size();
+        ++m_count;
+    }
+    // This would just slow things down: if (!types.contains(type))
+    appendType(slot, type);
+}
+
+void QMimeFastPatterns::removeMimeType(const QString &mimeType)
+{
+    const QHash<QString, int>::const_iterator it = m_typeIds.constFind(mimeType);
+    if (it == m_typeIds.constEnd())
+        return;
+    const quint16 type = it.value();
+    for (int i = 0; i < m_slots.size(); ++i) {
+        if (m_slots.at(i).typeCount)
+            removeType(m_slots[i], type);
+    }
+    for (QHash<QString, QVector<quint16> >::iterator other = m_otherExtensions.begin(); other != m_otherExtensions.end(); ++other)
+        removeAll(other.value(), type);
+}
+
+void QMimeFastPatterns::match(QMimeGlobMatchResult &result, const QString &fileName, int lastDot) const
+{
+    const int length = fileName.length() - lastDot - 1;
+    char key[MaxKeyLength];
+    if (!fold(fileName.constData() + lastDot + 1, length, key)) {
+        if (m_otherExtensions.isEmpty())
+            return;
+        const QHash<QString, QVector<quint16> >::const_iterator it = m_otherExtensions.constFind(fileName.right(length).toLower());
+        if (it != m_otherExtensions.constEnd()) {
+            for (int i = 0; i < it.value().size(); ++i)
+                result.addTailMatch(m_mimeTypes.at(it.value().at(i)), 50, fileName, length + 1, true);
+        }
+        return;
+    }
+    if (m_count == 0)
+        return;
+    const Slot &slot = m_slots.at(find(key, length));
+    const quint16 *slotTypes = types(slot);
+    for (int i = 0; i < slot.typeCount; ++i)
+        result.addTailMatch(m_mimeTypes.at(slotTypes[i]), 50, fileName, length + 1, true);
+}
+
+void QMimeFastPatterns::clear()
+{
+    m_slots.clear();
+    m_count = 0;
+    m_overflow.clear();
+    m_mimeTypes.clear();
+    m_typeIds.clear();
+    m_otherExtensions.clear();
+}
+
+qint64 QMimeFastPatterns::heapSize() const
+{
+    qint64 size = QMimeMemoryUsage::heapSize(m_overflow) + QMimeMemoryUsage::heapSize(m_mimeTypes)
+                  + QMimeMemoryUsage::heapSize(m_typeIds) + QMimeMemoryUsage::heapSize(m_otherExtensions);
+    if (m_slots.capacity())
+        size += QMimeMemoryUsage::VectorHeaderSize + m_slots.capacity() * qint64(sizeof(Slot));
+    return size;
+}
+
 void QMimeAllGlobPatterns::addGlob(const QMimeGlobPattern &glob)
 {
     const QString &pattern = glob.pattern();
     Q_ASSERT(!pattern.isEmpty());
 
-    // Store each patterns into either m_fastPatternDict (*.txt, *.html etc. with default weight 50)
+    // Store each patterns into either m_fastPatterns (*.txt, *.html etc. with default weight 50)
     // or for the rest, like core.*, *.tar.bz2, *~, into highWeightPatternOffset (>50)
     // or lowWeightPatternOffset (<=50)
 
     if (glob.weight() == 50 && isFastPattern(pattern) && !glob.isCaseSensitive()) {
         // The bulk of the patterns is *.foo with weight 50 --> those go into the fast patterns hash.
-        const QString extension = pattern.mid(2).toLower();
-        QStringList &patterns = m_fastPatterns[extension]; // find or create
-        // This would just slow things down: if (!patterns.contains(glob.mimeType()))
-        patterns.append(glob.mimeType());
+        m_fastPatterns.add(pattern.mid(2).toLower(), glob.mimeType());
     } else {
         if (glob.weight() > 50) {
             // This would just slow things down: if (!m_highWeightGlobs.hasPattern(glob.mimeType(), glob.pattern()))
@@ -178,10 +465,7 @@ void QMimeAllGlobPatterns::addGlob(const QMimeGlobPattern &glob)
 
 void QMimeAllGlobPatterns::removeMimeType(const QString &mimeType)
 {
-    QMutableHashIterator<QString, QStringList> it(m_fastPatterns);
-    while (it.hasNext()) {
-        it.next().value().removeAll(mimeType);
-    }
+    m_fastPatterns.removeMimeType(mimeType);
     m_highWeightGlobs.removeMimeType(mimeType);
     m_lowWeightGlobs.removeMimeType(mimeType);
 }
@@ -199,25 +483,19 @@ void QMimeGlobPatternList::match(QMimeGlobMatchResult &result,
     }
 }
 
-QStringList QMimeAllGlobPatterns::matchingGlobs(const QString &fileName, QString *foundSuffix) const
+QStringList QMimeAllGlobPatterns::matchingGlobs(const QString &fileName, QString *foundSuffix, int *weightPtr, int *patternLengthPtr) const
 {
     // First try the high weight matches (>50), if any.
     QMimeGlobMatchResult result;
     m_highWeightGlobs.match(result, fileName);
-    if (result.m_matchingMimeTypes.isEmpty()) {
+    if (result.isEmpty()) {
 
-        // Now use the "fast patterns" dict, for simple *.foo patterns with weight 50
+        // Now use the "fast patterns" table, for simple *.foo patterns with weight 50
         // (which is most of them, so this optimization is definitely worth it)
         const int lastDot = fileName.lastIndexOf(QLatin1Char('.'));
         if (lastDot != -1) { // if no '.', skip the extension lookup
-            const int ext_len = fileName.length() - lastDot - 1;
-            const QString simpleExtension = fileName.right(ext_len).toLower();
-            // (toLower because fast patterns are always case-insensitive and saved as lowercase)
-
-            const QStringList matchingMimeTypes = m_fastPatterns.value(simpleExtension);
-            foreach (const QString &mime, matchingMimeTypes) {
-                result.addMatch(mime, 50, QLatin1String("*.") + simpleExtension);
-            }
+            // (lowercased while probing, because fast patterns are always case-insensitive and saved as lowercase)
+            m_fastPatterns.match(result, fileName, lastDot);
             // Can't return yet; *.tar.bz2 has to win over *.bz2, so we need the low-weight mimetypes anyway,
             // at least those with weight 50.
         }
@@ -226,8 +504,12 @@ QStringList QMimeAllGlobPatterns::matchingGlobs(const QString &fileName, QString
         m_lowWeightGlobs.match(result, fileName);
     }
     if (foundSuffix)
-        *foundSuffix = result.m_foundSuffix;
-    return result.m_matchingMimeTypes;
+        *foundSuffix = result.foundSuffix(fileName);
+    if (weightPtr)
+        *weightPtr = result.weight();
+    if (patternLengthPtr)
+        *patternLengthPtr = result.matchingPatternLength();
+    return result.matchingMimeTypes();
 }
 
 void QMimeAllGlobPatterns::clear()
@@ -237,4 +519,9 @@ void QMimeAllGlobPatterns::clear()
     m_lowWeightGlobs.clear();
 }
 
+bool QMimeAllGlobPatterns::isEmpty() const
+{
+    return m_fastPatterns.isEmpty() && m_highWeightGlobs.isEmpty() && m_lowWeightGlobs.isEmpty();
+}
+
 QT_END_NAMESPACE
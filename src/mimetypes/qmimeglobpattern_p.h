@@ -44,21 +44,57 @@
 
 #include <QtCore/qstringlist.h>
 #include <QtCore/qhash.h>
+#include <QtCore/qvarlengtharray.h>
+#include <QtCore/qvector.h>
 
 QT_BEGIN_NAMESPACE
 
 struct QMimeGlobMatchResult
 {
     QMimeGlobMatchResult()
-    : m_weight(0), m_matchingPatternLength(0)
+    : m_weight(0), m_matchingPatternLength(0),
+      m_suffixPattern(0), m_suffixPatternLatin1(0), m_suffixLength(0), m_suffixIsLowerCase(false)
     {}
 
+    // The MIME type and the pattern are referenced, not copied: they must outlive the result.
     void addMatch(const QString &mimeType, int weight, const QString &pattern);
+    void addMatch(const char *mimeType, int weight, const char *pattern);
+    // For "*<tail>" patterns matching the last tailLength characters of fileName.
+    void addTailMatch(const QString &mimeType, int weight, const QString &fileName, int tailLength, bool lowerCase);
+    void addTailMatch(const char *mimeType, int weight, const QString &fileName, int tailLength, bool lowerCase);
+    void addTailMatch(const char *mimeType, int weight, const char *fileName, int length, int tailLength, bool lowerCase);
+
+    inline bool isEmpty() const { return m_matches.isEmpty(); }
+    inline int weight() const { return m_weight; }
+    inline int matchingPatternLength() const { return m_matchingPatternLength; }
+    QStringList matchingMimeTypes() const;
+    QString foundSuffix(const QString &fileName) const;
+    QString foundSuffix(const char *fileName, int length) const;
 
-    QStringList m_matchingMimeTypes;
+private:
+    struct MatchedType
+    {
+        const QString *name; // owned by the glob lists of the XML provider
+        const char *latin1;  // points into mime.cache
+    };
+
+    static inline MatchedType matchedType(const QString &mimeType)
+    { MatchedType t; t.name = &mimeType; t.latin1 = 0; return t; }
+    static inline MatchedType matchedType(const char *mimeType)
+    { MatchedType t; t.name = 0; t.latin1 = mimeType; return t; }
+
+    bool addMatchedType(const MatchedType &mimeType, int weight, int patternLength);
+    void setSuffixFromTail(bool tailIsSuffix, int tailLength, bool lowerCase);
+
+    QVarLengthArray<MatchedType, 8> m_matches;
     int m_weight;
     int m_matchingPatternLength;
-    QString m_foundSuffix;
+
+    // Where the suffix of the last "*." match comes from, materialized by foundSuffix()
+    const QString *m_suffixPattern;
+    const char *m_suffixPatternLatin1;
+    int m_suffixLength;
+    bool m_suffixIsLowerCase;
 };
 
 class QMimeGlobPattern
@@ -119,24 +155,75 @@ public:
     void match(QMimeGlobMatchResult &result, const QString &fileName) const;
 };
 
+/*
+   The "*.foo" patterns of weight 50, by extension. The extensions are keys of
+   an open-addressing table, lowercased and in Latin-1, with the IDs of their
+   MIME types inline. The file name is lowercased while probing, so that a
+   lookup doesn't allocate. The few extensions that don't fit are in a QHash.
+ */
+class QMimeFastPatterns
+{
+public:
+    QMimeFastPatterns();
+
+    // extension is lowercased
+    void add(const QString &extension, const QString &mimeType);
+    void removeMimeType(const QString &mimeType);
+    // For the extension of fileName, after lastDot
+    void match(QMimeGlobMatchResult &result, const QString &fileName, int lastDot) const;
+    void clear();
+    inline bool isEmpty() const { return m_count == 0 && m_otherExtensions.isEmpty(); }
+
+    qint64 heapSize() const;
+
+private:
+    enum { MaxKeyLength = 15, InlineTypes = 3 };
+
+    struct Slot
+    {
+        Slot() : keyLength(0), typeCount(0) {}
+
+        char key[MaxKeyLength]; // not terminated
+        uchar keyLength; // 0 for a free slot
+        quint16 typeCount;
+        quint16 types[InlineTypes]; // above InlineTypes, types[0] is the index in m_overflow
+    };
+
+    static bool fold(const QChar *extension, int length, char *key);
+    static inline uint hash(const char *key, int length);
+    int find(const char *key, int length) const;
+    void rehash(int capacity);
+    quint16 typeId(const QString &mimeType);
+    void appendType(Slot &slot, quint16 type);
+    void removeType(Slot &slot, quint16 type);
+    inline const quint16 *types(const Slot &slot) const
+    { return slot.typeCount > InlineTypes ? m_overflow.at(slot.types[0]).constData() : slot.types; }
+
+    QVector<Slot> m_slots; // a power of two, at most half full
+    int m_count;
+    QVector<QVector<quint16> > m_overflow;
+    QStringList m_mimeTypes; // by ID
+    QHash<QString, int> m_typeIds;
+    QHash<QString, QVector<quint16> > m_otherExtensions; // not in Latin-1, empty or too long
+};
+
 /*!
     Result of the globs parsing, as data structures ready for efficient MIME type matching.
     This contains:
-    1) a map of fast regular patterns (e.g. *.txt is stored as "txt" in a qhash's key)
+    1) a table of fast regular patterns (e.g. *.txt is stored as "txt", see QMimeFastPatterns)
     2) a linear list of high-weight globs
     3) a linear list of low-weight globs
  */
 class QMimeAllGlobPatterns
 {
 public:
-    typedef QHash<QString, QStringList> PatternsMap; // MIME type -> patterns
-
     void addGlob(const QMimeGlobPattern &glob);
     void removeMimeType(const QString &mimeType);
-    QStringList matchingGlobs(const QString &fileName, QString *foundSuffix) const;
+    QStringList matchingGlobs(const QString &fileName, QString *foundSuffix, int *weightPtr = 0, int *patternLengthPtr = 0) const;
     void clear();
+    bool isEmpty() const;
 
-    PatternsMap m_fastPatterns; // example: "doc" -> "application/msword", "text/plain"
+    QMimeFastPatterns m_fastPatterns; // example: "doc" -> "application/msword", "text/plain"
     QMimeGlobPatternList m_highWeightGlobs;
     QMimeGlobPatternList m_lowWeightGlobs; // <= 50, including the non-fast 50 patterns
 };
@@ -0,0 +1,242 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimemagiccorpus_p.h"
+
+#include "qmimedatabase.h"
+#include "qmimemagicrule_p.h"
+#include "qmimemagicrulematcher_p.h"
+#include "qmimetypeparser_p.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QTextStream>
+#include <QtCore/QVector>
+
+#include <string.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+   One minimal header per path through the magic rule trees, so that the
+   matching engine can be measured and tested without real files.
+
+   Every positive sample is followed by a near-miss negative: the same bytes with one
+   significant bit of the last rule flipped. The "list" manifest records what the
+   database detects for each sample when it is written.
+ */
+
+typedef QList<const QMimeMagicRule *> RulePath;
+
+namespace {
+class MagicRuleCollector : public QMimeTypeParserBase
+{
+public:
+    QList<QMimeMagicRuleMatcher> matchers;
+
+protected:
+    bool process(const QMimeType &, QString *) { return true; }
+    bool process(const QMimeGlobPattern &, QString *) { return true; }
+    void processParent(const QString &, const QString &) {}
+    void processAlias(const QString &, const QString &) {}
+    void processMagicMatcher(const QMimeMagicRuleMatcher &matcher) { matchers.append(matcher); }
+};
+}
+
+// A rule only matches if one of its sub-rules matches too, so each leaf defines one path.
+static void collectPaths(const QList<QMimeMagicRule> &rules, RulePath &path, QList<RulePath> &paths)
+{
+    for (QList<QMimeMagicRule>::const_iterator it = rules.constBegin(); it != rules.constEnd(); ++it) {
+        path.append(&*it);
+        if (it->m_subMatches.isEmpty())
+            paths.append(path);
+        else
+            collectPaths(it->m_subMatches, path, paths);
+        path.removeLast();
+    }
+}
+
+// Places every rule of the path at the first offset of its range that does not clash
+// with the bytes written for the previous rules. Returns the offset of the last rule.
+static int writePath(const RulePath &path, QByteArray &data)
+{
+    QVector<bool> used;
+    int offset = -1;
+    foreach (const QMimeMagicRule *rule, path) {
+        const QByteArray bytes = rule->matchBytes();
+        offset = -1;
+        for (int pos = rule->startPos(); pos <= rule->endPos() && offset < 0; ++pos) {
+            offset = pos;
+            for (int i = 0; i < bytes.size() && pos + i < used.size(); ++i) {
+                if (used.at(pos + i) && data.at(pos + i) != bytes.at(i)) {
+                    offset = -1;
+                    break;
+                }
+            }
+        }
+        if (offset < 0)
+            return -1;
+        const int end = offset + bytes.size();
+        if (data.size() < end) {
+            data.append(QByteArray(end - data.size(), '\0'));
+            used.resize(end);
+        }
+        memcpy(data.data() + offset, bytes.constData(), bytes.size());
+        for (int i = offset; i < end; ++i)
+            used[i] = true;
+    }
+    return offset;
+}
+
+// Flips the lowest significant bit of the first masked byte of the rule at offset
+static bool breakRule(const QMimeMagicRule *rule, int offset, QByteArray &data)
+{
+    const QByteArray mask = rule->matchMask();
+    for (int i = 0; i < mask.size(); ++i) {
+        const uchar bits = mask.at(i);
+        if (bits) {
+            data[offset + i] = char(data.at(offset + i) ^ (bits & -bits));
+            return true;
+        }
+    }
+    return false;
+}
+
+static QByteArray ruleTypes(const RulePath &path)
+{
+    QByteArray result;
+    foreach (const QMimeMagicRule *rule, path) {
+        if (!result.isEmpty())
+            result += ',';
+        result += QMimeMagicRule::typeName(rule->type());
+    }
+    return result;
+}
+
+bool qmime_writeMagicCorpus(const QString &outputDirectory, const QStringList &packageFiles,
+                            const QMimeDatabase &database, QMimeMagicCorpusCounts *counts,
+                            QString *errorMessage)
+{
+    const QDir outputDir(outputDirectory);
+    if (!QDir().mkpath(outputDir.path())) {
+        *errorMessage = QString::fromLatin1("Cannot create %1").arg(outputDir.path());
+        return false;
+    }
+
+    MagicRuleCollector collector;
+    foreach (const QString &fileName, packageFiles) {
+        QFile file(fileName);
+        QString parseError;
+        if (!file.open(QIODevice::ReadOnly) || !collector.parse(&file, fileName, &parseError)) {
+            *errorMessage = QString::fromLatin1("Cannot parse %1: %2").arg(fileName, parseError);
+            return false;
+        }
+    }
+
+    QFile manifestFile(outputDir.filePath(QLatin1String("list")));
+    if (!manifestFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorMessage = QString::fromLatin1("Cannot write %1").arg(manifestFile.fileName());
+        return false;
+    }
+    QTextStream manifest(&manifestFile);
+    manifest << "# Synthetic magic headers generated by mimecorpusgen from:\n";
+    foreach (const QString &fileName, packageFiles)
+        manifest << "#   " << fileName << '\n';
+    manifest << "#\n"
+                "# Syntax: <filename> <rule mimetype> <positive|negative> <rule types> <detected mimetype>\n"
+                "#  where <rule types> lists the types of the rules on the path, outermost first,\n"
+                "#  and <detected mimetype> is what mimeTypeForData() returned when generating.\n\n";
+
+    QMimeMagicCorpusCounts written;
+    QHash<QString, int> samplesPerType;
+    foreach (const QMimeMagicRuleMatcher &matcher, collector.matchers) {
+        const QList<QMimeMagicRule> rules = matcher.magicRules();
+        QList<RulePath> paths;
+        RulePath path;
+        collectPaths(rules, path, paths);
+
+        foreach (const RulePath &rulePath, paths) {
+            QByteArray data;
+            const int offset = writePath(rulePath, data);
+            if (offset < 0 || !matcher.matches(data)) {
+                ++written.unsatisfiable;
+                continue;
+            }
+
+            QString baseName = matcher.mimetype();
+            baseName.replace(QLatin1Char('/'), QLatin1Char('-'));
+            baseName += QLatin1Char('_') + QString::number(samplesPerType[matcher.mimetype()]++);
+
+            QByteArray miss = data;
+            const bool hasNegative = breakRule(rulePath.last(), offset, miss) && !matcher.matches(miss);
+
+            for (int negative = 0; negative <= int(hasNegative); ++negative) {
+                const QString fileName = negative ? baseName + QLatin1String("_miss") : baseName;
+                const QByteArray &sample = negative ? miss : data;
+                QFile file(outputDir.filePath(fileName));
+                if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(sample) != sample.size()) {
+                    *errorMessage = QString::fromLatin1("Cannot write %1").arg(file.fileName());
+                    return false;
+                }
+                manifest << fileName << ' ' << matcher.mimetype() << ' '
+                         << (negative ? "negative" : "positive") << ' '
+                         << ruleTypes(rulePath) << ' '
+                         << database.mimeTypeForData(sample).name() << '\n';
+            }
+            ++written.positives;
+            written.negatives += int(hasNegative);
+        }
+    }
+
+    manifest.flush();
+    if (manifestFile.error() != QFile::NoError) {
+        *errorMessage = QString::fromLatin1("Cannot write %1").arg(manifestFile.fileName());
+        return false;
+    }
+    if (counts)
+        *counts = written;
+    return true;
+}
+
+QT_END_NAMESPACE
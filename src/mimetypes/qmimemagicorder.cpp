@@ -0,0 +1,304 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimemagicorder_p.h"
+
+#include "qmimememoryusage_p.h"
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qrunnable.h>
+#include <QtCore/qthreadpool.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeMagicOrder
+
+    \brief The QMimeMagicOrder class evaluates first the magic matchers that matched most often, without changing the result.
+
+    The matchers of a provider are entries in the order of its file, the first
+    one to match wins. Two entries of the same priority are exclusive when no
+    data can match both: every probe of the one compares, at some fixed offset,
+    bits that differ from those of every probe of the other. Like "%PDF-" and
+    "\x89PNG" at offset 0; a rule looking at a few offsets gives a probe for
+    each of them. The order of exclusive entries doesn't matter, the
+    data matches at most one of them; the others keep the order of the file.
+    Within each group of equal priority, the entries are then sorted by hits,
+    as far as these constraints allow, and the groups stay in order.
+
+    The first order to use and the hits since then belong to the caller, which
+    serializes the calls. Every so often, a job of the global thread pool sorts
+    a copy of the hits, and the caller picks the new order up at the next call
+    to order(). The exclusions are computed by the first job, not when loading.
+*/
+
+// Hits before the first new order, and at most between two of them
+static const int firstReorder = 64;
+static const int maxReorderInterval = 4096;
+// Offsets of a rule looked at one by one, larger ranges aren't fixed
+static const int maxProbesPerRule = 8;
+
+struct QMimeMagicOrder::Shared
+{
+    explicit Shared(const QVector<Entry> &theEntries)
+        : entries(theEntries), exclusionsComputed(false), running(0), published(0) {}
+
+    const QVector<Entry> entries;
+
+    // Only used by the jobs, one at a time: for each entry, the later ones of
+    // its group that aren't exclusive with it, and how many earlier ones aren't
+    QVector<QVector<int> > successors;
+    QVector<int> predecessorCounts;
+    bool exclusionsComputed;
+
+    QAtomicInt running; // a job is queued or running
+    QAtomicInt published; // order is newer than the order of the caller
+    QMutex mutex;
+    QVector<int> order;
+};
+
+static inline uchar maskAt(const QMimeMagicOrder::Probe &probe, int i)
+{
+    return probe.mask.isEmpty() ? uchar(0xff) : uchar(probe.mask.at(i));
+}
+
+// Whether no data can have the bytes of both probes
+static bool conflicts(const QMimeMagicOrder::Probe &a, const QMimeMagicOrder::Probe &b)
+{
+    const int begin = qMax(a.offset, b.offset);
+    const int end = qMin(a.offset + a.value.size(), b.offset + b.value.size());
+    for (int pos = begin; pos < end; ++pos) {
+        const int i = pos - a.offset;
+        const int j = pos - b.offset;
+        const uchar common = maskAt(a, i) & maskAt(b, j);
+        if ((uchar(a.value.at(i)) & common) != (uchar(b.value.at(j)) & common))
+            return true;
+    }
+    return false;
+}
+
+static bool exclusive(const QMimeMagicOrder::Entry &a, const QMimeMagicOrder::Entry &b)
+{
+    if (!a.isFixed || !b.isFixed)
+        return false;
+    foreach (const QMimeMagicOrder::Probe &probeA, a.probes) {
+        foreach (const QMimeMagicOrder::Probe &probeB, b.probes) {
+            if (!conflicts(probeA, probeB))
+                return false;
+        }
+    }
+    return true;
+}
+
+// The end of the group of equal priority starting at begin
+static int groupEnd(const QVector<QMimeMagicOrder::Entry> &entries, int begin)
+{
+    int end = begin + 1;
+    while (end < entries.count() && entries.at(end).priority == entries.at(begin).priority)
+        ++end;
+    return end;
+}
+
+class QMimeMagicOrder::ReorderJob : public QRunnable
+{
+public:
+    ReorderJob(const QSharedPointer<Shared> &shared, const QVector<int> &hits)
+        : m_shared(shared), m_hits(hits) {}
+
+    virtual void run()
+    {
+        if (!m_shared->exclusionsComputed)
+            computeExclusions();
+        const QVector<int> newOrder = reorder();
+        {
+            QMutexLocker locker(&m_shared->mutex);
+            m_shared->order = newOrder;
+        }
+        m_shared->published.fetchAndStoreRelease(1);
+        m_shared->running.fetchAndStoreRelease(0);
+    }
+
+private:
+    void computeExclusions()
+    {
+        const QVector<Entry> &entries = m_shared->entries;
+        const int count = entries.count();
+        m_shared->successors.resize(count);
+        m_shared->predecessorCounts.fill(0, count);
+        for (int begin = 0; begin < count; ) {
+            const int end = groupEnd(entries, begin);
+            for (int i = begin; i < end; ++i) {
+                for (int j = i + 1; j < end; ++j) {
+                    if (!exclusive(entries.at(i), entries.at(j))) {
+                        m_shared->successors[i].append(j);
+                        ++m_shared->predecessorCounts[j];
+                    }
+                }
+            }
+            begin = end;
+        }
+        m_shared->exclusionsComputed = true;
+    }
+
+    // Within each group, the entry with the most hits among those whose
+    // predecessors are all placed, the earliest one for equal hits
+    QVector<int> reorder() const
+    {
+        const QVector<Entry> &entries = m_shared->entries;
+        const int count = entries.count();
+        QVector<int> newOrder;
+        newOrder.reserve(count);
+        QVector<int> pending = m_shared->predecessorCounts;
+        QVector<int> ready;
+        for (int begin = 0; begin < count; ) {
+            const int end = groupEnd(entries, begin);
+            ready.clear();
+            for (int i = begin; i < end; ++i) {
+                if (pending.at(i) == 0)
+                    ready.append(i);
+            }
+            while (!ready.isEmpty()) {
+                int best = 0;
+                for (int k = 1; k < ready.count(); ++k) {
+                    const int hits = m_hits.at(ready.at(k));
+                    const int bestHits = m_hits.at(ready.at(best));
+                    if (hits > bestHits || (hits == bestHits && ready.at(k) < ready.at(best)))
+                        best = k;
+                }
+                const int entry = ready.at(best);
+                ready.remove(best);
+                newOrder.append(entry);
+                foreach (int next, m_shared->successors.at(entry)) {
+                    if (--pending[next] == 0)
+                        ready.append(next);
+                }
+            }
+            begin = end;
+        }
+        Q_ASSERT(newOrder.count() == count);
+        return newOrder;
+    }
+
+    const QSharedPointer<Shared> m_shared;
+    const QVector<int> m_hits;
+};
+
+void QMimeMagicOrder::Entry::addRule(int firstOffset, int offsets, const QByteArray &value, const QByteArray &mask)
+{
+    if (offsets > maxProbesPerRule || value.isEmpty() || (!mask.isEmpty() && mask.size() != value.size())) {
+        isFixed = false;
+        return;
+    }
+    for (int i = 0; i < offsets; ++i)
+        probes.append(Probe(firstOffset + i, value, mask));
+}
+
+QMimeMagicOrder::QMimeMagicOrder()
+    : m_hitCount(0), m_nextReorder(firstReorder)
+{
+}
+
+QMimeMagicOrder::~QMimeMagicOrder()
+{
+    // A running job keeps the shared data alive, and its order is dropped
+}
+
+void QMimeMagicOrder::setEntries(const QVector<Entry> &entries)
+{
+    clear();
+    if (entries.isEmpty())
+        return;
+    m_shared = QSharedPointer<Shared>(new Shared(entries));
+    m_order.resize(entries.count());
+    for (int i = 0; i < entries.count(); ++i)
+        m_order[i] = i;
+    m_hits.fill(0, entries.count());
+}
+
+void QMimeMagicOrder::clear()
+{
+    m_shared.clear();
+    m_order.clear();
+    m_hits.clear();
+    m_hitCount = 0;
+    m_nextReorder = firstReorder;
+}
+
+const QVector<int> &QMimeMagicOrder::order()
+{
+    if (m_shared && m_shared->published.testAndSetAcquire(1, 0)) {
+        QMutexLocker locker(&m_shared->mutex);
+        m_order = m_shared->order;
+    }
+    return m_order;
+}
+
+void QMimeMagicOrder::hit(int entry)
+{
+    ++m_hits[entry];
+    if (++m_hitCount < m_nextReorder)
+        return;
+    // If the previous job isn't done, the next hit tries again
+    if (!m_shared->running.testAndSetOrdered(0, 1))
+        return;
+    m_nextReorder = m_hitCount + qBound(firstReorder, m_hitCount, maxReorderInterval);
+    QThreadPool::globalInstance()->start(new ReorderJob(m_shared, m_hits));
+}
+
+qint64 QMimeMagicOrder::heapSize() const
+{
+    qint64 size = QMimeMemoryUsage::heapSize(m_order) + QMimeMemoryUsage::heapSize(m_hits);
+    if (m_shared) {
+        size += sizeof(Shared) + QMimeMemoryUsage::VectorHeaderSize + m_shared->entries.count() * qint64(sizeof(Entry));
+        foreach (const Entry &entry, m_shared->entries) {
+            size += QMimeMemoryUsage::arraySize(entry.probes);
+            foreach (const Probe &probe, entry.probes)
+                size += QMimeMemoryUsage::heapSize(probe.value) + QMimeMemoryUsage::heapSize(probe.mask);
+        }
+    }
+    return size;
+}
+
+QT_END_NAMESPACE
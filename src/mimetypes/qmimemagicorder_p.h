@@ -0,0 +1,109 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEMAGICORDER_P_H
+#define QMIMEMAGICORDER_P_H
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qvector.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMimeMagicOrder
+{
+public:
+    // Bytes that the data has at a fixed offset, for the bits of the mask
+    struct Probe
+    {
+        Probe(int theOffset, const QByteArray &theValue, const QByteArray &theMask = QByteArray())
+            : offset(theOffset), value(theValue), mask(theMask) {}
+
+        int offset;
+        QByteArray value;
+        QByteArray mask; // empty for all the bits, else as long as value
+    };
+
+    // What the data needs for a matcher to match: one of the probes. Matchers
+    // that look at a large range of offsets aren't fixed, they may match anything.
+    struct Entry
+    {
+        Entry() : priority(0), isFixed(true) {}
+
+        // The value of a top-level rule, compared at offsets positions from firstOffset
+        void addRule(int firstOffset, int offsets, const QByteArray &value, const QByteArray &mask = QByteArray());
+
+        int priority;
+        bool isFixed;
+        QList<Probe> probes;
+    };
+
+    QMimeMagicOrder();
+    ~QMimeMagicOrder();
+
+    // The entries in the order of the file, equal priorities next to each other
+    void setEntries(const QVector<Entry> &entries);
+    void clear();
+    inline bool isEmpty() const { return m_order.isEmpty(); }
+
+    // The entries in the order to evaluate them, the first match wins
+    const QVector<int> &order();
+    void hit(int entry);
+
+    qint64 heapSize() const;
+
+private:
+    Q_DISABLE_COPY(QMimeMagicOrder)
+
+    struct Shared;
+    class ReorderJob;
+
+    QSharedPointer<Shared> m_shared; // with the job computing the next order
+    QVector<int> m_order;
+    QVector<int> m_hits;
+    int m_hitCount;
+    int m_nextReorder; // m_hitCount when the next order is computed
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEMAGICORDER_P_H
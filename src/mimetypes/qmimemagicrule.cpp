@@ -44,6 +44,9 @@
 
 #include "qmimemagicrule_p.h"
 
+#include "qmimedetectionbudget_p.h"
+#include "qmimememoryusage_p.h"
+
 #include <QtCore/QList>
 #include <QtCore/QDebug>
 #include <qendian.h>
@@ -119,7 +122,7 @@ bool QMimeMagicRule::matchSubstring(const char *dataPtr, int dataSize, int range
 {
     // Size of searched data.
     // Example: value="ABC", rangeLength=3 -> we need 3+3-1=5 bytes (ABCxx,xABCx,xxABC would match)
-    const int dataNeeded = qMin(rangeLength + valueLength - 1, dataSize - rangeStart);
+    const int dataNeeded = QMimeMagicRule::comparedDataSize(dataSize, rangeStart, rangeLength, valueLength);
 
     if (!mask) {
         // callgrind says QByteArray::indexOf is much slower, since our strings are typically too
@@ -153,8 +156,10 @@ bool QMimeMagicRule::matchSubstring(const char *dataPtr, int dataSize, int range
                     break;
                 }
             }
-            if (valid)
+            if (valid) {
                 found = true;
+                break;
+            }
         }
         if (!found)
             return false;
@@ -355,13 +360,103 @@ QByteArray QMimeMagicRule::mask() const
     return result;
 }
 
+template <typename T>
+static inline QByteArray hostBytes(quint32 number)
+{
+    const T value(number);
+    return QByteArray(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+QByteArray QMimeMagicRule::matchBytes() const
+{
+    switch (d->type) {
+    case String:
+        return d->pattern;
+    case Byte:
+        return hostBytes<quint8>(d->number);
+    case Big16:
+    case Host16:
+    case Little16:
+        return hostBytes<quint16>(d->number);
+    case Big32:
+    case Host32:
+    case Little32:
+        return hostBytes<quint32>(d->number);
+    default:
+        return QByteArray();
+    }
+}
+
+QByteArray QMimeMagicRule::matchMask() const
+{
+    switch (d->type) {
+    case String:
+        return d->mask;
+    case Byte:
+        return hostBytes<quint8>(d->numberMask);
+    case Big16:
+    case Host16:
+    case Little16:
+        return hostBytes<quint16>(d->numberMask);
+    case Big32:
+    case Host32:
+    case Little32:
+        return hostBytes<quint32>(d->numberMask);
+    default:
+        return QByteArray();
+    }
+}
+
 bool QMimeMagicRule::isValid() const
 {
     return d->matchFunction;
 }
 
-bool QMimeMagicRule::matches(const QByteArray &data) const
+// The number of bytes of data needed to evaluate the rule and its sub-rules
+int QMimeMagicRule::extent() const
+{
+    int result = d->endPos + matchBytes().size();
+    foreach (const QMimeMagicRule &subMatch, m_subMatches)
+        result = qMax(result, subMatch.extent());
+    return result;
+}
+
+// For QMimeDatabase::memoryUsage(), see QMimeMemoryUsage
+qint64 QMimeMagicRule::heapSize() const
+{
+    return sizeof(QMimeMagicRulePrivate) + QMimeMemoryUsage::heapSize(d->value)
+           + QMimeMemoryUsage::heapSize(d->mask) + QMimeMemoryUsage::heapSize(d->pattern)
+           + QMimeMemoryUsage::heapSize(m_subMatches);
+}
+
+// The number of bytes of data the rule compares at most, for QMimeBudgetTracker
+static int comparedBytes(const QMimeMagicRulePrivate *d, int dataSize)
 {
+    int valueLength = 1;
+    switch (d->type) {
+    case QMimeMagicRule::String:
+        valueLength = d->pattern.size();
+        break;
+    case QMimeMagicRule::Host16:
+    case QMimeMagicRule::Big16:
+    case QMimeMagicRule::Little16:
+        valueLength = 2;
+        break;
+    case QMimeMagicRule::Host32:
+    case QMimeMagicRule::Big32:
+    case QMimeMagicRule::Little32:
+        valueLength = 4;
+        break;
+    default:
+        break;
+    }
+    return QMimeMagicRule::comparedDataSize(dataSize, d->startPos, d->endPos - d->startPos + 1, valueLength);
+}
+
+bool QMimeMagicRule::matches(const QByteArray &data, QMimeBudgetTracker *budget) const
+{
+    if (budget && !budget->spend(comparedBytes(d.data(), data.size())))
+        return false;
     const bool ok = d->matchFunction && d->matchFunction(d.data(), data);
     if (!ok)
         return false;
@@ -374,7 +469,7 @@ bool QMimeMagicRule::matches(const QByteArray &data) const
     // Check that one of the submatches matches too
     for ( QList<QMimeMagicRule>::const_iterator it = m_subMatches.begin(), end = m_subMatches.end() ;
           it != end ; ++it ) {
-        if ((*it).matches(data)) {
+        if ((*it).matches(data, budget)) {
             // One of the hierarchies matched -> mimetype recognized.
             return true;
         }
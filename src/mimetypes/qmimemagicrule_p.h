@@ -48,6 +48,7 @@
 
 QT_BEGIN_NAMESPACE
 
+class QMimeBudgetTracker;
 class QMimeMagicRulePrivate;
 class QMimeMagicRule
 {
@@ -68,9 +69,16 @@ public:
     int endPos() const;
     QByteArray mask() const;
 
+    // The bytes compared against the data and the mask applied to both, in memory order
+    QByteArray matchBytes() const;
+    QByteArray matchMask() const;
+
     bool isValid() const;
+    int extent() const;
+    qint64 heapSize() const;
 
-    bool matches(const QByteArray &data) const;
+    // A null budget means no limit, see QMimeBudgetTracker
+    bool matches(const QByteArray &data, QMimeBudgetTracker *budget = 0) const;
 
     QList<QMimeMagicRule> m_subMatches;
 
@@ -78,6 +86,11 @@ public:
     static QByteArray typeName(Type type);
 
     static bool matchSubstring(const char *dataPtr, int dataSize, int rangeStart, int rangeLength, int valueLength, const char *valueData, const char *mask);
+    // How many bytes of data a value can be compared with
+    static inline int comparedDataSize(int dataSize, int rangeStart, int rangeLength, int valueLength)
+    {
+        return qMax(0, qMin(rangeLength + valueLength - 1, dataSize - rangeStart));
+    }
 
 private:
     const QScopedPointer<QMimeMagicRulePrivate> d;
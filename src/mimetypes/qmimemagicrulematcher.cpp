@@ -43,6 +43,7 @@
 
 #include "qmimemagicrulematcher_p.h"
 
+#include "qmimedetectionbudget_p.h"
 #include "qmimetype_p.h"
 
 QT_BEGIN_NAMESPACE
@@ -88,16 +89,26 @@ QList<QMimeMagicRule> QMimeMagicRuleMatcher::magicRules() const
 }
 
 // Check for a match on contents of a file
-bool QMimeMagicRuleMatcher::matches(const QByteArray &data) const
+bool QMimeMagicRuleMatcher::matches(const QByteArray &data, QMimeBudgetTracker *budget) const
 {
     foreach (const QMimeMagicRule &magicRule, m_list) {
-        if (magicRule.matches(data))
+        if (magicRule.matches(data, budget))
             return true;
+        if (budget && budget->isExhausted())
+            return false;
     }
 
     return false;
 }
 
+int QMimeMagicRuleMatcher::extent() const
+{
+    int result = 0;
+    foreach (const QMimeMagicRule &rule, m_list)
+        result = qMax(result, rule.extent());
+    return result;
+}
+
 // Return a priority value from 1..100
 unsigned QMimeMagicRuleMatcher::priority() const
 {
@@ -50,6 +50,8 @@
 
 QT_BEGIN_NAMESPACE
 
+class QMimeBudgetTracker;
+
 class QMimeMagicRuleMatcher
 {
 public:
@@ -61,7 +63,8 @@ public:
     void addRules(const QList<QMimeMagicRule> &rules);
     QList<QMimeMagicRule> magicRules() const;
 
-    bool matches(const QByteArray &data) const;
+    bool matches(const QByteArray &data, QMimeBudgetTracker *budget = 0) const;
+    int extent() const;
 
     unsigned priority() const;
 
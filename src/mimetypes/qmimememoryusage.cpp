@@ -0,0 +1,259 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimememoryusage_p.h"
+
+#include "qmimeglobpattern_p.h"
+#include "qmimemagicrule_p.h"
+#include "qmimemagicrulematcher_p.h"
+#include "qmimetype_p.h"
+
+#include <string.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMimeDatabaseMemoryUsage
+    \brief The QMimeDatabaseMemoryUsage class tells how much memory the loaded MIME database uses.
+
+    The memory is broken down by component, as heap memory (estimated from the
+    sizes of the containers the database uses) and as memory mapped from
+    mime.cache files, which is shared by all processes using the same files.
+
+    Only what was loaded so far is counted: the XML provider loads everything
+    at once, while the mime.cache provider loads comments, icons and the list
+    of all types on demand.
+
+    \sa QMimeDatabase::memoryUsage()
+*/
+
+/*!
+    \enum QMimeDatabaseMemoryUsage::Component
+
+    \value MimeTypes The QMimeType instances held by the database, with their
+    names, icons and glob patterns, and the lists of all types.
+    \value LocaleComments The translated comments of the types.
+    \value Aliases The alias table of the XML provider.
+    \value Parents The inheritance table of the XML provider.
+    \value GlobPatterns The glob pattern tables of the XML provider, and the
+    patterns read from the package files by the mime.cache provider.
+    \value MagicRules The magic rules of the XML provider.
+    \value NameIndex The name and alias index of the mime.cache provider.
+    \value CacheFiles The mime.cache files: their mappings, and the objects
+    managing them.
+*/
+
+QMimeDatabaseMemoryUsagePrivate::QMimeDatabaseMemoryUsagePrivate()
+{
+    memset(heap, 0, sizeof(heap));
+    memset(mapped, 0, sizeof(mapped));
+}
+
+void QMimeMemoryUsage::addHeap(Component component, qint64 bytes)
+{
+    m_usage.d->heap[component] += bytes;
+}
+
+void QMimeMemoryUsage::addMapped(Component component, qint64 bytes)
+{
+    m_usage.d->mapped[component] += bytes;
+}
+
+qint64 QMimeMemoryUsage::heapSize(const QString &str)
+{
+    return str.capacity() ? ArrayHeaderSize + 2 * qint64(str.capacity() + 1) : 0;
+}
+
+qint64 QMimeMemoryUsage::heapSize(const QByteArray &array)
+{
+    return array.capacity() ? ArrayHeaderSize + qint64(array.capacity() + 1) : 0;
+}
+
+qint64 QMimeMemoryUsage::heapSize(const QMimeType &mimeType)
+{
+    const QMimeTypePrivate *d = mimeType.d.constData();
+    if (!d)
+        return 0;
+    return sizeof(QMimeTypePrivate) + heapSize(d->name) + heapSize(d->genericIconName)
+           + heapSize(d->iconName) + heapSize(d->globPatterns);
+}
+
+qint64 QMimeMemoryUsage::localeCommentsSize(const QMimeType &mimeType)
+{
+    const QMimeTypePrivate *d = mimeType.d.constData();
+    return d ? heapSize(d->localeComments) : 0;
+}
+
+qint64 QMimeMemoryUsage::heapSize(const QMimeGlobPattern &glob)
+{
+    return heapSize(glob.pattern()) + heapSize(glob.mimeType());
+}
+
+qint64 QMimeMemoryUsage::heapSize(const QMimeAllGlobPatterns &globs)
+{
+    return globs.m_fastPatterns.heapSize() + heapSize(globs.m_highWeightGlobs)
+           + heapSize(globs.m_lowWeightGlobs);
+}
+
+qint64 QMimeMemoryUsage::heapSize(const QMimeMagicRule &rule)
+{
+    return rule.heapSize();
+}
+
+qint64 QMimeMemoryUsage::heapSize(const QMimeMagicRuleMatcher &matcher)
+{
+    return heapSize(matcher.magicRules()) + heapSize(matcher.mimetype());
+}
+
+/*!
+    Constructs an empty memory usage.
+*/
+QMimeDatabaseMemoryUsage::QMimeDatabaseMemoryUsage()
+    : d(new QMimeDatabaseMemoryUsagePrivate)
+{
+}
+
+/*!
+    Constructs a copy of \a other.
+*/
+QMimeDatabaseMemoryUsage::QMimeDatabaseMemoryUsage(const QMimeDatabaseMemoryUsage &other)
+    : d(other.d)
+{
+}
+
+/*!
+    Assigns \a other to this memory usage.
+*/
+QMimeDatabaseMemoryUsage &QMimeDatabaseMemoryUsage::operator=(const QMimeDatabaseMemoryUsage &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Destroys the memory usage.
+*/
+QMimeDatabaseMemoryUsage::~QMimeDatabaseMemoryUsage()
+{
+}
+
+/*!
+    Returns the heap memory used by \a component, in bytes.
+*/
+qint64 QMimeDatabaseMemoryUsage::heapBytes(Component component) const
+{
+    return d->heap[component];
+}
+
+/*!
+    Returns the memory mapped for \a component, in bytes.
+*/
+qint64 QMimeDatabaseMemoryUsage::mappedBytes(Component component) const
+{
+    return d->mapped[component];
+}
+
+/*!
+    Returns the heap memory used by all components, in bytes.
+*/
+qint64 QMimeDatabaseMemoryUsage::totalHeapBytes() const
+{
+    qint64 total = 0;
+    for (int i = 0; i < ComponentCount; ++i)
+        total += d->heap[i];
+    return total;
+}
+
+/*!
+    Returns the memory mapped for all components, in bytes.
+*/
+qint64 QMimeDatabaseMemoryUsage::totalMappedBytes() const
+{
+    qint64 total = 0;
+    for (int i = 0; i < ComponentCount; ++i)
+        total += d->mapped[i];
+    return total;
+}
+
+/*!
+    Returns a name for \a component, for logging.
+*/
+QString QMimeDatabaseMemoryUsage::componentName(Component component)
+{
+    switch (component) {
+    case MimeTypes:
+        return QLatin1String("MIME types");
+    case LocaleComments:
+        return QLatin1String("locale comments");
+    case Aliases:
+        return QLatin1String("aliases");
+    case Parents:
+        return QLatin1String("parents");
+    case GlobPatterns:
+        return QLatin1String("glob patterns");
+    case MagicRules:
+        return QLatin1String("magic rules");
+    case NameIndex:
+        return QLatin1String("name index");
+    case CacheFiles:
+        return QLatin1String("cache files");
+    }
+    return QString();
+}
+
+/*!
+    Returns the memory usage as text, one line per component, for logging.
+*/
+QString QMimeDatabaseMemoryUsage::toString() const
+{
+    QString result = QString::fromLatin1("QMimeDatabase memory usage: %1 bytes heap, %2 bytes mapped\n")
+            .arg(totalHeapBytes()).arg(totalMappedBytes());
+    for (int i = 0; i < ComponentCount; ++i) {
+        const Component component = Component(i);
+        result += QString::fromLatin1("  %1: %2 bytes heap, %3 bytes mapped\n")
+                .arg(componentName(component)).arg(heapBytes(component)).arg(mappedBytes(component));
+    }
+    return result;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,171 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMEMEMORYUSAGE_P_H
+#define QMIMEMEMORYUSAGE_P_H
+
+#include "qmimedatabase.h"
+
+#include <QtCore/qhash.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qset.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qvector.h>
+
+QT_BEGIN_NAMESPACE
+
+class QMimeAllGlobPatterns;
+class QMimeGlobPattern;
+class QMimeMagicRule;
+class QMimeMagicRuleMatcher;
+
+class QMimeDatabaseMemoryUsagePrivate : public QSharedData
+{
+public:
+    QMimeDatabaseMemoryUsagePrivate();
+
+    qint64 heap[QMimeDatabaseMemoryUsage::ComponentCount];
+    qint64 mapped[QMimeDatabaseMemoryUsage::ComponentCount];
+};
+
+/*
+   Collects QMimeDatabaseMemoryUsage from the providers, and estimates what the
+   Qt containers they use allocate. heapSize() is the memory owned by a value,
+   not counting the value itself; implicitly shared data is counted for every
+   owner, so the numbers are upper bounds.
+ */
+class QMimeMemoryUsage
+{
+public:
+    typedef QMimeDatabaseMemoryUsage::Component Component;
+
+    // Allocation headers of QString, QByteArray, QList and QVector in Qt 4
+    enum {
+        ArrayHeaderSize = 3 * sizeof(int) + sizeof(void *) + sizeof(int),
+        ListHeaderSize = 4 * sizeof(int) + sizeof(void *),
+        VectorHeaderSize = 4 * sizeof(int)
+    };
+
+    void addHeap(Component component, qint64 bytes);
+    void addMapped(Component component, qint64 bytes);
+    QMimeDatabaseMemoryUsage result() const { return m_usage; }
+
+    static inline qint64 heapSize(int) { return 0; }
+    static inline qint64 heapSize(uint) { return 0; }
+    static qint64 heapSize(const QString &str);
+    static qint64 heapSize(const QByteArray &array);
+    static qint64 heapSize(const QMimeType &mimeType); // without the locale comments
+    static qint64 localeCommentsSize(const QMimeType &mimeType);
+    static qint64 heapSize(const QMimeGlobPattern &glob);
+    static qint64 heapSize(const QMimeAllGlobPatterns &globs);
+    static qint64 heapSize(const QMimeMagicRule &rule);
+    static qint64 heapSize(const QMimeMagicRuleMatcher &matcher);
+
+    // The array of the list only, not what the elements own
+    template <typename T>
+    static qint64 arraySize(const QList<T> &list)
+    {
+        if (list.isEmpty())
+            return 0;
+        qint64 size = ListHeaderSize + list.size() * qint64(sizeof(void *));
+        if (QTypeInfo<T>::isLarge || QTypeInfo<T>::isStatic)
+            size += list.size() * qint64(sizeof(T));
+        return size;
+    }
+
+    template <typename T>
+    static qint64 heapSize(const QList<T> &list)
+    {
+        qint64 size = arraySize(list);
+        for (typename QList<T>::const_iterator it = list.constBegin(); it != list.constEnd(); ++it)
+            size += heapSize(*it);
+        return size;
+    }
+
+    template <typename T>
+    static qint64 heapSize(const QVector<T> &vector)
+    {
+        if (vector.capacity() == 0)
+            return 0;
+        qint64 size = VectorHeaderSize + vector.capacity() * qint64(sizeof(T));
+        for (typename QVector<T>::const_iterator it = vector.constBegin(); it != vector.constEnd(); ++it)
+            size += heapSize(*it);
+        return size;
+    }
+
+    // The buckets and nodes of the hash only
+    template <typename K, typename V>
+    static qint64 hashSize(const QHash<K, V> &hash)
+    {
+        if (hash.capacity() == 0)
+            return 0;
+        return sizeof(QHashData) + hash.capacity() * qint64(sizeof(void *))
+               + hash.size() * qint64(sizeof(QHashNode<K, V>));
+    }
+
+    template <typename K, typename V>
+    static qint64 heapSize(const QHash<K, V> &hash)
+    {
+        qint64 size = hashSize(hash);
+        for (typename QHash<K, V>::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it)
+            size += heapSize(it.key()) + heapSize(it.value());
+        return size;
+    }
+
+    template <typename T>
+    static qint64 heapSize(const QSet<T> &set)
+    {
+        if (set.capacity() == 0)
+            return 0;
+        qint64 size = sizeof(QHashData) + set.capacity() * qint64(sizeof(void *))
+                      + set.size() * qint64(sizeof(QHashNode<T, QHashDummyValue>));
+        for (typename QSet<T>::const_iterator it = set.constBegin(); it != set.constEnd(); ++it)
+            size += heapSize(*it);
+        return size;
+    }
+
+private:
+    QMimeDatabaseMemoryUsage m_usage;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMEMEMORYUSAGE_P_H
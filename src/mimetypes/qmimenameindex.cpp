@@ -0,0 +1,244 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimenameindex_p.h"
+
+#include "qmimememoryusage_p.h"
+
+#include <QtCore/QtAlgorithms>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeNameIndex
+
+    \brief The QMimeNameIndex class maps a fixed set of MIME type names and aliases to integers.
+
+    It is a minimal perfect hash built with "hash and displace": the keys are
+    spread over a few buckets, and each bucket gets a displacement such that
+    all of its keys land in free slots of a table with exactly one slot per key.
+    A lookup is one pass over the key to hash it, and one string comparison
+    with the only key that could be in its slot.
+
+    Building is done once, when the set of names is loaded.
+*/
+
+// Average number of keys per bucket
+static const int keysPerBucket = 4;
+
+static inline quint64 mix(quint64 x)
+{
+    x ^= x >> 30;
+    x *= Q_UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 27;
+    x *= Q_UINT64_C(0x94d049bb133111eb);
+    x ^= x >> 31;
+    return x;
+}
+
+QMimeNameIndex::QMimeNameIndex()
+    : m_seed(0), m_numBuckets(0)
+{
+}
+
+// FNV-1a over the UTF-16 code units
+quint64 QMimeNameIndex::hash(const QString &key)
+{
+    quint64 h = Q_UINT64_C(14695981039346656037);
+    const ushort *p = key.utf16();
+    const ushort *end = p + key.size();
+    for ( ; p != end; ++p) {
+        h ^= *p;
+        h *= Q_UINT64_C(1099511628211);
+    }
+    return h;
+}
+
+void QMimeNameIndex::hashParts(quint64 h, quint32 *bucket, quint32 *f1, quint32 *f2) const
+{
+    const quint64 a = mix(h ^ m_seed);
+    const quint64 b = mix(a);
+    const quint32 n = m_keys.size();
+    *bucket = quint32(a) % m_numBuckets;
+    *f1 = quint32(a >> 32) % n;
+    *f2 = quint32(b) % n;
+}
+
+/*!
+    Builds the index for \a entries, trying at most \a maxSeeds seeds. Returns
+    false if no perfect hash could be found, which does not happen in practice;
+    the index then uses a plain QHash.
+*/
+bool QMimeNameIndex::build(const QHash<QString, int> &entries, int maxSeeds)
+{
+    clear();
+    if (entries.isEmpty())
+        return true;
+
+    QVector<QString> keys;
+    QVector<int> values;
+    keys.reserve(entries.size());
+    values.reserve(entries.size());
+    for (QHash<QString, int>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        keys.append(it.key());
+        values.append(it.value());
+    }
+
+    for (int i = 0; i < maxSeeds; ++i) {
+        if (tryBuild(keys, values, mix(quint64(i) + 1)))
+            return true;
+    }
+    clear();
+    m_fallback = entries;
+    return false;
+}
+
+namespace {
+struct BucketSize
+{
+    quint32 bucket;
+    int size;
+    // Biggest buckets first, they are the hardest to place
+    bool operator<(const BucketSize &other) const { return size > other.size; }
+};
+}
+
+bool QMimeNameIndex::tryBuild(const QVector<QString> &keys, const QVector<int> &values, quint64 seed)
+{
+    const quint32 n = keys.size();
+    m_seed = seed;
+    m_numBuckets = n / keysPerBucket + 1;
+    m_keys.resize(n); // hashParts() uses the table size
+
+    QVector<quint32> bucketOf(n), f1(n), f2(n);
+    QVector<QVector<int> > buckets(m_numBuckets);
+    for (quint32 i = 0; i < n; ++i) {
+        hashParts(hash(keys.at(i)), &bucketOf[i], &f1[i], &f2[i]);
+        buckets[bucketOf.at(i)].append(i);
+    }
+
+    QVector<BucketSize> order(m_numBuckets);
+    for (quint32 b = 0; b < m_numBuckets; ++b) {
+        order[b].bucket = b;
+        order[b].size = buckets.at(b).size();
+    }
+    qStableSort(order.begin(), order.end());
+
+    m_displacements.fill(0, m_numBuckets);
+    QVector<bool> used(n, false);
+    QVector<quint32> slots;
+    const quint64 maxDisplacement = quint64(n) * n;
+    for (quint32 i = 0; i < m_numBuckets && order.at(i).size > 0; ++i) {
+        const QVector<int> &bucket = buckets.at(order.at(i).bucket);
+        bool placed = false;
+        for (quint64 d = 0; d < maxDisplacement && !placed; ++d) {
+            const quint64 d0 = d / n;
+            const quint64 d1 = d % n;
+            slots.clear();
+            placed = true;
+            foreach (int key, bucket) {
+                const quint32 slot = (f1.at(key) + d0 * f2.at(key) + d1) % n;
+                if (used.at(slot) || slots.contains(slot)) {
+                    placed = false;
+                    break;
+                }
+                slots.append(slot);
+            }
+            if (placed) {
+                foreach (quint32 slot, slots)
+                    used[slot] = true;
+                m_displacements[order.at(i).bucket] = quint32(d);
+            }
+        }
+        if (!placed)
+            return false;
+    }
+
+    m_values.resize(n);
+    for (quint32 i = 0; i < n; ++i) {
+        const quint64 d = m_displacements.at(bucketOf.at(i));
+        const quint32 slot = (f1.at(i) + (d / n) * f2.at(i) + d % n) % n;
+        m_keys[slot] = keys.at(i);
+        m_values[slot] = values.at(i);
+    }
+    return true;
+}
+
+void QMimeNameIndex::clear()
+{
+    m_seed = 0;
+    m_numBuckets = 0;
+    m_displacements.clear();
+    m_keys.clear();
+    m_values.clear();
+    m_fallback.clear();
+}
+
+/*!
+    Returns the value for \a key, or -1 if \a key is not in the index.
+*/
+int QMimeNameIndex::value(const QString &key) const
+{
+    if (m_keys.isEmpty())
+        return m_fallback.value(key, -1);
+    const quint32 n = m_keys.size();
+    quint32 bucket, f1, f2;
+    hashParts(hash(key), &bucket, &f1, &f2);
+    const quint64 d = m_displacements.at(bucket);
+    const quint32 slot = (f1 + (d / n) * f2 + d % n) % n;
+    if (m_keys.at(slot) != key)
+        return -1;
+    return m_values.at(slot);
+}
+
+/*!
+    Returns the heap memory used by the index, see QMimeDatabase::memoryUsage().
+*/
+qint64 QMimeNameIndex::heapSize() const
+{
+    return QMimeMemoryUsage::heapSize(m_displacements) + QMimeMemoryUsage::heapSize(m_keys)
+           + QMimeMemoryUsage::heapSize(m_values) + QMimeMemoryUsage::heapSize(m_fallback);
+}
+
+QT_END_NAMESPACE
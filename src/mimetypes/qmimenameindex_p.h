@@ -0,0 +1,87 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMENAMEINDEX_P_H
+#define QMIMENAMEINDEX_P_H
+
+#include <QtCore/qhash.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qvector.h>
+
+#include "qmime_global.h"
+
+QT_BEGIN_NAMESPACE
+
+class QMIME_AUTOTEST_EXPORT QMimeNameIndex
+{
+public:
+    enum {
+        DefaultMaxSeeds = 16 // seeds tried before giving up, one is nearly always enough
+    };
+
+    QMimeNameIndex();
+
+    bool build(const QHash<QString, int> &entries, int maxSeeds = DefaultMaxSeeds);
+    void clear();
+
+    inline bool isEmpty() const { return m_keys.isEmpty() && m_fallback.isEmpty(); }
+    inline bool isPerfect() const { return !m_keys.isEmpty(); }
+
+    int value(const QString &key) const;
+
+    qint64 heapSize() const;
+
+private:
+    static quint64 hash(const QString &key);
+    bool tryBuild(const QVector<QString> &keys, const QVector<int> &values, quint64 seed);
+    inline void hashParts(quint64 h, quint32 *bucket, quint32 *f1, quint32 *f2) const;
+
+    quint64 m_seed;
+    quint32 m_numBuckets;
+    QVector<quint32> m_displacements; // per bucket
+    QVector<QString> m_keys;          // per slot
+    QVector<int> m_values;            // per slot
+    QHash<QString, int> m_fallback;   // if no perfect hash was found
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMENAMEINDEX_P_H
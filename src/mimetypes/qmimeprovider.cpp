@@ -42,8 +42,11 @@
 #include "qmimeprovider_p.h"
 
 #include "qmimetypeparser_p.h"
-#include <qstandardpaths.h>
+#include "qmimedetectionbudget_p.h"
+#include "qmimeglobfilter_p.h"
 #include "qmimemagicrulematcher_p.h"
+#include "qmimestatistics_p.h"
+#include "qmimetrace_p.h"
 
 #include <QXmlStreamReader>
 #include <QDir>
@@ -52,6 +55,9 @@
 #include <QDebug>
 #include <QDateTime>
 #include <QtEndian>
+#include <QtAlgorithms>
+
+#include <string.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -76,6 +82,17 @@ QMimeProviderBase::QMimeProviderBase(QMimeDatabasePrivate *db)
 {
 }
 
+QMimeType QMimeProviderBase::mimeTypeForNameOrAlias(const QString &nameOrAlias)
+{
+    return mimeTypeForName(resolveAlias(nameOrAlias));
+}
+
+// For the providers whose globs are QStrings anyway
+QStringList QMimeProviderBase::findByEncodedFileName(const char *fileName, int length, QString *foundSuffix)
+{
+    return findByFileName(QFile::decodeName(QByteArray::fromRawData(fileName, length)), foundSuffix);
+}
+
 QMIME_EXPORT int qmime_secondsBetweenChecks = 5; // exported for the unit test
 
 bool QMimeProviderBase::shouldCheck()
@@ -84,11 +101,12 @@ bool QMimeProviderBase::shouldCheck()
     if (m_lastCheck.isValid() && m_lastCheck.secsTo(now) < qmime_secondsBetweenChecks)
         return false;
     m_lastCheck = now;
+    m_db->clearLocateCache();
     return true;
 }
 
 QMimeBinaryProvider::QMimeBinaryProvider(QMimeDatabasePrivate *db)
-    : QMimeProviderBase(db), m_mimetypeListLoaded(false)
+    : QMimeProviderBase(db), m_mimetypeListLoaded(false), m_metaDataLoaded(false)
 {
 }
 
@@ -114,36 +132,48 @@ struct QMimeBinaryProvider::CacheFile
     {
         return reinterpret_cast<const char *>(data + offset);
     }
-    bool load();
+    bool load(const char *cause);
     bool reload();
+    void prefault() const;
+    void buildGlobFilter();
+    void buildMagicOrder();
 
     QFile file;
     uchar *data;
     QDateTime m_mtime;
+    QMimeGlobFilter globFilter; // the names that may match a glob of this file
+    QMimeMagicOrder magicOrder; // for QMimeDatabase::AdaptiveMagicOrder, built on demand
     bool m_valid;
 };
 
 QMimeBinaryProvider::CacheFile::CacheFile(const QString &fileName)
     : file(fileName), m_valid(false)
 {
-    load();
+    load("new");
 }
 
 QMimeBinaryProvider::CacheFile::~CacheFile()
 {
 }
 
-bool QMimeBinaryProvider::CacheFile::load()
+bool QMimeBinaryProvider::CacheFile::load(const char *cause)
 {
-    if (!file.open(QIODevice::ReadOnly))
-        return false;
-    data = file.map(0, file.size());
-    if (data) {
-        const int major = getUint16(0);
-        const int minor = getUint16(2);
-        m_valid = (major == 1 && minor >= 1 && minor <= 2);
+    if (QMIME_TRACE_ENABLED(cache_reload_entry))
+        QMIME_TRACE2(cache_reload_entry, QFile::encodeName(file.fileName()).constData(), cause);
+    magicOrder.clear();
+    if (file.open(QIODevice::ReadOnly)) {
+        data = file.map(0, file.size());
+        if (data) {
+            const int major = getUint16(0);
+            const int minor = getUint16(2);
+            m_valid = (major == 1 && minor >= 1 && minor <= 2);
+        }
+        m_mtime = QFileInfo(file).lastModified();
     }
-    m_mtime = QFileInfo(file).lastModified();
+    if (m_valid)
+        buildGlobFilter();
+    if (QMIME_TRACE_ENABLED(cache_reload_return))
+        QMIME_TRACE2(cache_reload_return, QFile::encodeName(file.fileName()).constData(), int(m_valid));
     return m_valid;
 }
 
@@ -155,21 +185,19 @@ bool QMimeBinaryProvider::CacheFile::reload()
         file.close();
     }
     data = 0;
-    return load();
+    return load("modified");
 }
 
-QMimeBinaryProvider::CacheFile *QMimeBinaryProvider::CacheFileList::findCacheFile(const QString &fileName) const
+// Reads a byte of every page, so that the whole file is in memory before it is needed
+void QMimeBinaryProvider::CacheFile::prefault() const
 {
-    for (const_iterator it = begin(); it != end(); ++it) {
-        if ((*it)->file.fileName() == fileName)
-            return *it;
-    }
-    return 0;
-}
-
-QMimeBinaryProvider::~QMimeBinaryProvider()
-{
-    qDeleteAll(m_cacheFiles);
+    if (!m_valid)
+        return;
+    const qint64 size = file.size();
+    volatile uchar sum = 0;
+    for (qint64 offset = 0; offset < size; offset += 4096)
+        sum += data[offset];
+    Q_UNUSED(sum);
 }
 
 // Position of the "list offsets" values, at the beginning of the mime.cache file
@@ -185,6 +213,78 @@ enum {
     PosGenericIconsListOffset = 36
 };
 
+// Names matching nothing are the common case for hashes, temporary files and
+// the like: the filter saves them the walk of the lists and of the suffix tree.
+void QMimeBinaryProvider::CacheFile::buildGlobFilter()
+{
+    globFilter.clear();
+    const int listOffsets[] = { int(getUint32(PosLiteralListOffset)), int(getUint32(PosGlobListOffset)) };
+    for (int list = 0; list < 2; ++list) {
+        const int off = listOffsets[list];
+        const int numGlobs = getUint32(off);
+        for (int i = 0; i < numGlobs; ++i)
+            globFilter.addPattern(getCharStar(getUint32(off + 4 + 12 * i)));
+    }
+
+    // The roots are the last characters of the suffixes, their children the ones before
+    const int reverseSuffixTreeOffset = getUint32(PosReverseSuffixTreeOffset);
+    const int numRoots = getUint32(reverseSuffixTreeOffset);
+    const int firstRootOffset = getUint32(reverseSuffixTreeOffset + 4);
+    for (int i = 0; i < numRoots; ++i) {
+        const int off = firstRootOffset + 12 * i;
+        const uint last = getUint32(off);
+        const int numChildren = getUint32(off + 4);
+        const int childrenOffset = getUint32(off + 8);
+        for (int j = 0; j < numChildren; ++j) {
+            const uint beforeLast = getUint32(childrenOffset + 12 * j);
+            if (beforeLast == 0) // a leaf: the suffix is one character long
+                globFilter.addSuffix(last);
+            else
+                globFilter.addSuffix(beforeLast, last);
+        }
+    }
+    globFilter.build();
+}
+
+// What the data needs for each match of the magic list, see QMimeMagicOrder
+void QMimeBinaryProvider::CacheFile::buildMagicOrder()
+{
+    const int magicListOffset = getUint32(PosMagicListOffset);
+    const int numMatches = getUint32(magicListOffset);
+    const int firstMatchOffset = getUint32(magicListOffset + 8);
+    QVector<QMimeMagicOrder::Entry> entries(numMatches);
+    for (int i = 0; i < numMatches; ++i) {
+        const int off = firstMatchOffset + i * 16;
+        QMimeMagicOrder::Entry &entry = entries[i];
+        entry.priority = getUint32(off);
+        const int numMatchlets = getUint32(off + 8);
+        const int firstMatchletOffset = getUint32(off + 12);
+        for (int matchlet = 0; matchlet < numMatchlets; ++matchlet) {
+            const int matchletOff = firstMatchletOffset + matchlet * 32;
+            const int valueLength = getUint32(matchletOff + 12);
+            const int maskOffset = getUint32(matchletOff + 20);
+            const QByteArray value(getCharStar(getUint32(matchletOff + 16)), valueLength);
+            const QByteArray mask = maskOffset ? QByteArray(getCharStar(maskOffset), valueLength) : QByteArray();
+            entry.addRule(getUint32(matchletOff), getUint32(matchletOff + 4), value, mask);
+        }
+    }
+    magicOrder.setEntries(entries);
+}
+
+QMimeBinaryProvider::CacheFile *QMimeBinaryProvider::CacheFileList::findCacheFile(const QString &fileName) const
+{
+    for (const_iterator it = begin(); it != end(); ++it) {
+        if ((*it)->file.fileName() == fileName)
+            return *it;
+    }
+    return 0;
+}
+
+QMimeBinaryProvider::~QMimeBinaryProvider()
+{
+    qDeleteAll(m_cacheFiles);
+}
+
 bool QMimeBinaryProvider::isValid()
 {
 #if defined(QT_USE_MMAP)
@@ -201,7 +301,10 @@ bool QMimeBinaryProvider::isValid()
 
     // We found exactly one file; is it the user-modified mimes, or a system file?
     const QString foundFile = m_cacheFiles.first()->file.fileName();
-    const QString localCacheFile = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + QLatin1String("/mime/mime.cache");
+    const QString localMimeDir = m_db->writableMimeDirectory();
+    if (localMimeDir.isEmpty()) // explicit directories, take what we were given
+        return true;
+    const QString localCacheFile = localMimeDir + QLatin1String("/mime.cache");
 
     return foundFile != localCacheFile;
 #else
@@ -235,13 +338,16 @@ void QMimeBinaryProvider::checkCache()
 {
     if (!shouldCheck())
         return;
+    QMimeStatisticsTimer timer(QMimeDatabaseStatistics::CacheCheck);
 
     // First iterate over existing known cache files and check for uptodate
-    if (m_cacheFiles.checkCacheChanged())
+    if (m_cacheFiles.checkCacheChanged()) {
         m_mimetypeListLoaded = false;
+        m_metaDataLoaded = false;
+    }
 
     // Then check if new cache files appeared
-    const QStringList cacheFileNames = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime/mime.cache"));
+    const QStringList cacheFileNames = m_db->locateAll(QLatin1String("mime.cache"));
     if (cacheFileNames != m_cacheFileNames) {
         foreach (const QString &cacheFileName, cacheFileNames) {
             CacheFile *cacheFile = m_cacheFiles.findCacheFile(cacheFileName);
@@ -256,13 +362,15 @@ void QMimeBinaryProvider::checkCache()
         }
         m_cacheFileNames = cacheFileNames;
         m_mimetypeListLoaded = false;
+        m_metaDataLoaded = false;
     }
 }
 
-static QMimeType mimeTypeForNameUnchecked(const QString &name)
+static QMimeType mimeTypeForNameUnchecked(QMimeDatabasePrivate *db, const QString &name)
 {
     QMimeTypePrivate data;
     data.name = name;
+    data.database = db;
     // The rest is retrieved on demand.
     // comment and globPatterns: in loadMimeTypePrivate
     // iconName: in loadIcon
@@ -275,12 +383,24 @@ QMimeType QMimeBinaryProvider::mimeTypeForName(const QString &name)
     checkCache();
     if (!m_mimetypeListLoaded)
         loadMimeTypeList();
-    if (!m_mimetypeNames.contains(name))
+    const int index = m_nameIndex.value(name);
+    if (index == -1 || m_mimetypeNames.at(index) != name)
+        return QMimeType(); // unknown mimetype, or an alias
+    return m_mimeTypes.at(index);
+}
+
+QMimeType QMimeBinaryProvider::mimeTypeForNameOrAlias(const QString &nameOrAlias)
+{
+    checkCache();
+    if (!m_mimetypeListLoaded)
+        loadMimeTypeList();
+    const int index = m_nameIndex.value(nameOrAlias);
+    if (index == -1)
         return QMimeType(); // unknown mimetype
-    return mimeTypeForNameUnchecked(name);
+    return m_mimeTypes.at(index);
 }
 
-QStringList QMimeBinaryProvider::findByFileName(const QString &fileName, QString *foundSuffix)
+QStringList QMimeBinaryProvider::findByFileName(const QString &fileName, QString *foundSuffix, int *weightPtr, int *patternLengthPtr)
 {
     checkCache();
     if (fileName.isEmpty())
@@ -289,18 +409,52 @@ QStringList QMimeBinaryProvider::findByFileName(const QString &fileName, QString
     QMimeGlobMatchResult result;
     // TODO this parses in the order (local, global). Check that it handles "NOGLOBS" correctly.
     foreach (CacheFile *cacheFile, m_cacheFiles) {
+        if (!cacheFile->globFilter.mayMatch(lowerFileName))
+            continue;
         matchGlobList(result, cacheFile, cacheFile->getUint32(PosLiteralListOffset), fileName);
         matchGlobList(result, cacheFile, cacheFile->getUint32(PosGlobListOffset), fileName);
         const int reverseSuffixTreeOffset = cacheFile->getUint32(PosReverseSuffixTreeOffset);
         const int numRoots = cacheFile->getUint32(reverseSuffixTreeOffset);
         const int firstRootOffset = cacheFile->getUint32(reverseSuffixTreeOffset + 4);
         matchSuffixTree(result, cacheFile, numRoots, firstRootOffset, lowerFileName, fileName.length() - 1, false);
-        if (result.m_matchingMimeTypes.isEmpty())
+        if (result.isEmpty())
             matchSuffixTree(result, cacheFile, numRoots, firstRootOffset, fileName, fileName.length() - 1, true);
     }
     if (foundSuffix)
-        *foundSuffix = result.m_foundSuffix;
-    return result.m_matchingMimeTypes;
+        *foundSuffix = result.foundSuffix(fileName);
+    if (weightPtr)
+        *weightPtr = result.weight();
+    if (patternLengthPtr)
+        *patternLengthPtr = result.matchingPatternLength();
+    return result.matchingMimeTypes();
+}
+
+QStringList QMimeBinaryProvider::findByEncodedFileName(const char *fileName, int length, QString *foundSuffix)
+{
+    // The suffix tree holds code points: only ASCII names can be walked byte by byte
+    for (int i = 0; i < length; ++i) {
+        if (uchar(fileName[i]) >= 0x80)
+            return QMimeProviderBase::findByEncodedFileName(fileName, length, foundSuffix);
+    }
+    checkCache();
+    if (length == 0)
+        return QStringList();
+    QMimeGlobMatchResult result;
+    foreach (CacheFile *cacheFile, m_cacheFiles) {
+        if (!cacheFile->globFilter.mayMatch(fileName, length))
+            continue;
+        matchGlobList(result, cacheFile, cacheFile->getUint32(PosLiteralListOffset), fileName, length);
+        matchGlobList(result, cacheFile, cacheFile->getUint32(PosGlobListOffset), fileName, length);
+        const int reverseSuffixTreeOffset = cacheFile->getUint32(PosReverseSuffixTreeOffset);
+        const int numRoots = cacheFile->getUint32(reverseSuffixTreeOffset);
+        const int firstRootOffset = cacheFile->getUint32(reverseSuffixTreeOffset + 4);
+        matchSuffixTree(result, cacheFile, numRoots, firstRootOffset, fileName, length, length - 1, false);
+        if (result.isEmpty())
+            matchSuffixTree(result, cacheFile, numRoots, firstRootOffset, fileName, length, length - 1, true);
+    }
+    if (foundSuffix)
+        *foundSuffix = result.foundSuffix(fileName, length);
+    return result.matchingMimeTypes();
 }
 
 void QMimeBinaryProvider::matchGlobList(QMimeGlobMatchResult &result, CacheFile *cacheFile, int off, const QString &fileName)
@@ -314,7 +468,8 @@ void QMimeBinaryProvider::matchGlobList(QMimeGlobMatchResult &result, CacheFile
         const int weight = flagsAndWeight & 0xff;
         const bool caseSensitive = flagsAndWeight & 0x100;
         const Qt::CaseSensitivity qtCaseSensitive = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
-        const QString pattern = QLatin1String(cacheFile->getCharStar(globOffset));
+        const char *globPattern = cacheFile->getCharStar(globOffset);
+        const QString pattern = QLatin1String(globPattern);
 
         const char *mimeType = cacheFile->getCharStar(mimeTypeOffset);
         //qDebug() << pattern << mimeType << weight << caseSensitive;
@@ -322,7 +477,7 @@ void QMimeBinaryProvider::matchGlobList(QMimeGlobMatchResult &result, CacheFile
 
         // TODO: this could be done faster for literals where a simple == would do.
         if (glob.matchFileName(fileName))
-            result.addMatch(QLatin1String(mimeType), weight, pattern);
+            result.addMatch(mimeType, weight, globPattern);
     }
 }
 
@@ -358,7 +513,7 @@ bool QMimeBinaryProvider::matchSuffixTree(QMimeGlobMatchResult &result, QMimeBin
                     const int weight = flagsAndWeight & 0xff;
                     const bool caseSensitive = flagsAndWeight & 0x100;
                     if (caseSensitiveCheck || !caseSensitive) {
-                        result.addMatch(QLatin1String(mimeType), weight, QLatin1Char('*') + fileName.mid(charPos+1));
+                        result.addTailMatch(mimeType, weight, fileName, fileName.length() - charPos - 1, !caseSensitiveCheck);
                         success = true;
                     }
                 }
@@ -369,7 +524,142 @@ bool QMimeBinaryProvider::matchSuffixTree(QMimeGlobMatchResult &result, QMimeBin
     return false;
 }
 
-bool QMimeBinaryProvider::matchMagicRule(QMimeBinaryProvider::CacheFile *cacheFile, int numMatchlets, int firstOffset, const QByteArray &data)
+static inline char asciiLower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+// Matches c, lowercased already for a case-insensitive glob, against the
+// literal, '?' or "[...]" set at pattern, and moves pattern past it.
+static bool matchGlobCharacter(const char *&pattern, char c, bool caseSensitive)
+{
+    if (*pattern == '?') {
+        ++pattern;
+        return true;
+    }
+    if (*pattern == '[') {
+        const char *p = pattern + 1;
+        const bool negate = *p == '!' || *p == '^';
+        if (negate)
+            ++p;
+        const char *setStart = p;
+        bool found = false;
+        while (*p && (*p != ']' || p == setStart)) {
+            char first = *p;
+            char last = *p;
+            if (p[1] == '-' && p[2] && p[2] != ']') {
+                last = p[2];
+                p += 3;
+            } else {
+                ++p;
+            }
+            if (!caseSensitive) {
+                first = asciiLower(first);
+                last = asciiLower(last);
+            }
+            if (uchar(first) <= uchar(c) && uchar(c) <= uchar(last))
+                found = true;
+        }
+        if (*p == ']') {
+            pattern = p + 1;
+            return found != negate;
+        }
+        // No closing bracket, so the '[' is a literal
+    }
+    const char expected = caseSensitive ? *pattern : asciiLower(*pattern);
+    ++pattern;
+    return expected == c;
+}
+
+// The shell wildcards of QRegExp::WildcardUnix, on the bytes of an ASCII file name
+static bool matchGlobPattern(const char *pattern, const char *fileName, int length, bool caseSensitive)
+{
+    const char *starPattern = 0; // just after the last '*' seen
+    int starPos = 0;             // where the text it matches ends, so far
+    int pos = 0;
+    while (pos < length) {
+        if (*pattern == '*') {
+            starPattern = ++pattern;
+            starPos = pos;
+            continue;
+        }
+        const char c = caseSensitive ? fileName[pos] : asciiLower(fileName[pos]);
+        const char *next = pattern;
+        if (*pattern && matchGlobCharacter(next, c, caseSensitive)) {
+            pattern = next;
+            ++pos;
+            continue;
+        }
+        if (!starPattern)
+            return false;
+        // Let the last '*' match one more character
+        pattern = starPattern;
+        pos = ++starPos;
+    }
+    while (*pattern == '*')
+        ++pattern;
+    return *pattern == '\0';
+}
+
+void QMimeBinaryProvider::matchGlobList(QMimeGlobMatchResult &result, CacheFile *cacheFile, int off, const char *fileName, int length)
+{
+    const int numGlobs = cacheFile->getUint32(off);
+    for (int i = 0; i < numGlobs; ++i) {
+        const int globOffset = cacheFile->getUint32(off + 4 + 12 * i);
+        const int mimeTypeOffset = cacheFile->getUint32(off + 4 + 12 * i + 4);
+        const int flagsAndWeight = cacheFile->getUint32(off + 4 + 12 * i + 8);
+        const int weight = flagsAndWeight & 0xff;
+        const bool caseSensitive = flagsAndWeight & 0x100;
+        const char *globPattern = cacheFile->getCharStar(globOffset);
+        if (matchGlobPattern(globPattern, fileName, length, caseSensitive))
+            result.addMatch(cacheFile->getCharStar(mimeTypeOffset), weight, globPattern);
+    }
+}
+
+bool QMimeBinaryProvider::matchSuffixTree(QMimeGlobMatchResult &result, QMimeBinaryProvider::CacheFile *cacheFile, int numEntries, int firstOffset, const char *fileName, int length, int charPos, bool caseSensitiveCheck)
+{
+    const uint fileChar = uchar(caseSensitiveCheck ? fileName[charPos] : asciiLower(fileName[charPos]));
+    int min = 0;
+    int max = numEntries - 1;
+    while (min <= max) {
+        const int mid = (min + max) / 2;
+        const int off = firstOffset + 12 * mid;
+        const uint ch = cacheFile->getUint32(off);
+        if (ch < fileChar)
+            min = mid + 1;
+        else if (ch > fileChar)
+            max = mid - 1;
+        else {
+            --charPos;
+            int numChildren = cacheFile->getUint32(off + 4);
+            int childrenOffset = cacheFile->getUint32(off + 8);
+            bool success = false;
+            if (charPos > 0)
+                success = matchSuffixTree(result, cacheFile, numChildren, childrenOffset, fileName, length, charPos, caseSensitiveCheck);
+            if (!success) {
+                for (int i = 0; i < numChildren; ++i) {
+                    const int childOff = childrenOffset + 12 * i;
+                    const int mch = cacheFile->getUint32(childOff);
+                    if (mch != 0)
+                        break;
+                    const int mimeTypeOffset = cacheFile->getUint32(childOff + 4);
+                    const char *mimeType = cacheFile->getCharStar(mimeTypeOffset);
+                    const int flagsAndWeight = cacheFile->getUint32(childOff + 8);
+                    const int weight = flagsAndWeight & 0xff;
+                    const bool caseSensitive = flagsAndWeight & 0x100;
+                    if (caseSensitiveCheck || !caseSensitive) {
+                        result.addTailMatch(mimeType, weight, fileName, length, length - charPos - 1, !caseSensitiveCheck);
+                        success = true;
+                    }
+                }
+            }
+            return success;
+        }
+    }
+    return false;
+}
+
+bool QMimeBinaryProvider::matchMagicRule(QMimeBinaryProvider::CacheFile *cacheFile, int numMatchlets, int firstOffset, const QByteArray &data, QMimeBudgetTracker *budget)
 {
     const char *dataPtr = data.constData();
     const int dataSize = data.size();
@@ -379,6 +669,8 @@ bool QMimeBinaryProvider::matchMagicRule(QMimeBinaryProvider::CacheFile *cacheFi
         const int rangeLength = cacheFile->getUint32(off + 4);
         //const int wordSize = cacheFile->getUint32(off + 8);
         const int valueLength = cacheFile->getUint32(off + 12);
+        if (budget && !budget->spend(QMimeMagicRule::comparedDataSize(dataSize, rangeStart, rangeLength, valueLength)))
+            return false;
         const int valueOffset = cacheFile->getUint32(off + 16);
         const int maskOffset = cacheFile->getUint32(off + 20);
         const char *mask = maskOffset ? cacheFile->getCharStar(maskOffset) : NULL;
@@ -391,33 +683,53 @@ bool QMimeBinaryProvider::matchMagicRule(QMimeBinaryProvider::CacheFile *cacheFi
         if (numChildren == 0) // No submatch? Then we are done.
             return true;
         // Check that one of the submatches matches too
-        if (matchMagicRule(cacheFile, numChildren, firstChildOffset, data))
+        if (matchMagicRule(cacheFile, numChildren, firstChildOffset, data, budget))
             return true;
     }
     return false;
 }
 
-QMimeType QMimeBinaryProvider::findByMagic(const QByteArray &data, int *accuracyPtr)
+QMimeType QMimeBinaryProvider::findByMagic(const QByteArray &data, int *accuracyPtr, QMimeBudgetTracker *budget)
 {
     checkCache();
+    QMimeMagicProfile profile(budget);
+    budget = profile.tracker();
+    const bool adaptive = m_db->m_detectionFlags & QMimeDatabase::AdaptiveMagicOrder;
     foreach (CacheFile *cacheFile, m_cacheFiles) {
         const int magicListOffset = cacheFile->getUint32(PosMagicListOffset);
         const int numMatches = cacheFile->getUint32(magicListOffset);
         //const int maxExtent = cacheFile->getUint32(magicListOffset + 4);
         const int firstMatchOffset = cacheFile->getUint32(magicListOffset + 8);
 
-        for (int i = 0; i < numMatches; ++i) {
+        // The order of the matches only changes within their priority, where the first one of the file would win anyway
+        if (adaptive && cacheFile->magicOrder.isEmpty())
+            cacheFile->buildMagicOrder();
+        const QVector<int> *order = adaptive ? &cacheFile->magicOrder.order() : 0;
+
+        for (int n = 0; n < numMatches; ++n) {
+            const int i = order ? order->at(n) : n;
             const int off = firstMatchOffset + i * 16;
             const int numMatchlets = cacheFile->getUint32(off + 8);
             const int firstMatchletOffset = cacheFile->getUint32(off + 12);
-            if (matchMagicRule(cacheFile, numMatchlets, firstMatchletOffset, data)) {
-                const int mimeTypeOffset = cacheFile->getUint32(off + 4);
-                const char *mimeType = cacheFile->getCharStar(mimeTypeOffset);
+            const int mimeTypeOffset = cacheFile->getUint32(off + 4);
+            const char *mimeType = cacheFile->getCharStar(mimeTypeOffset);
+            profile.start();
+            const bool matched = matchMagicRule(cacheFile, numMatchlets, firstMatchletOffset, data, budget);
+            profile.stop(mimeType, cacheFile->getUint32(off), matched);
+            if (matched) {
+                if (order)
+                    cacheFile->magicOrder.hit(i);
                 *accuracyPtr = cacheFile->getUint32(off);
                 // Return the first match. We have no rules for conflicting magic data...
                 // (mime.cache itself is sorted, but what about local overrides with a lower prio?)
-                return mimeTypeForNameUnchecked(QLatin1String(mimeType));
+                // The handle built by loadMimeTypeList(), unless an alias hides the type
+                const QString name = QLatin1String(mimeType);
+                const QMimeType result = mimeTypeForName(name);
+                return result.isValid() ? result : mimeTypeForNameUnchecked(m_db, name);
             }
+            // The matches are sorted by priority, so nothing was found so far
+            if (budget && budget->isExhausted())
+                return QMimeType();
         }
     }
     return QMimeType();
@@ -494,53 +806,259 @@ QString QMimeBinaryProvider::resolveAlias(const QString &name)
     return name;
 }
 
+// Adds the names in a "types" file, one per line
+static void readTypesFile(const QString &fileName, QSet<QString> &names)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    const QByteArray data = file.readAll();
+    const char *p = data.constData();
+    const char *end = p + data.size();
+    while (p < end) {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+        if (eol != p)
+            names.insert(QString::fromLatin1(p, eol - p));
+        p = eol + 1;
+    }
+}
+
 void QMimeBinaryProvider::loadMimeTypeList()
 {
     if (!m_mimetypeListLoaded) {
         m_mimetypeListLoaded = true;
-        m_mimetypeNames.clear();
         // Unfortunately mime.cache doesn't have a full list of all mimetypes.
         // So we have to parse the plain-text files called "types".
-        const QStringList typesFilenames = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime/types"));
-        foreach (const QString &typeFilename, typesFilenames) {
-            QFile file(typeFilename);
-            if (file.open(QIODevice::ReadOnly)) {
-                while (!file.atEnd()) {
-                    QByteArray line = file.readLine();
-                    line.chop(1);
-                    m_mimetypeNames.insert(QString::fromLatin1(line.constData(), line.size()));
-                }
+        QSet<QString> names;
+        const QStringList typesFilenames = m_db->locateAll(QLatin1String("types"));
+        foreach (const QString &typeFilename, typesFilenames)
+            readTypesFile(typeFilename, names);
+
+        m_mimetypeNames = names.toList();
+        qSort(m_mimetypeNames);
+        m_mimeTypes.clear();
+        m_mimeTypes.reserve(m_mimetypeNames.size());
+        QHash<QString, int> nameIndexes;
+        nameIndexes.reserve(m_mimetypeNames.size());
+        for (int i = 0; i < m_mimetypeNames.size(); ++i) {
+            const QString &name = m_mimetypeNames.at(i);
+            nameIndexes.insert(name, i);
+            m_mimeTypes.append(mimeTypeForNameUnchecked(m_db, name));
+        }
+
+        // Aliases map straight to the index of their type. Like in resolveAlias(),
+        // the first cache file wins, and an alias hides a type of the same name.
+        QHash<QString, int> entries = nameIndexes;
+        QSet<QString> aliases;
+        foreach (CacheFile *cacheFile, m_cacheFiles) {
+            const int aliasListOffset = cacheFile->getUint32(PosAliasListOffset);
+            const int numEntries = cacheFile->getUint32(aliasListOffset);
+            for (int i = 0; i < numEntries; ++i) {
+                const int off = aliasListOffset + 4 + 8 * i;
+                const QString alias = QLatin1String(cacheFile->getCharStar(cacheFile->getUint32(off)));
+                if (aliases.contains(alias))
+                    continue;
+                aliases.insert(alias);
+                const QString mimeType = QLatin1String(cacheFile->getCharStar(cacheFile->getUint32(off + 4)));
+                const int index = nameIndexes.value(mimeType, -1);
+                if (index == -1)
+                    entries.remove(alias);
+                else
+                    entries.insert(alias, index);
             }
         }
+        m_nameIndex.build(entries);
+    }
+}
+
+int QMimeBinaryProvider::maxMagicExtent()
+{
+    checkCache();
+    int result = 0;
+    foreach (CacheFile *cacheFile, m_cacheFiles) {
+        const int magicListOffset = cacheFile->getUint32(PosMagicListOffset);
+        result = qMax(result, int(cacheFile->getUint32(magicListOffset + 4)));
+    }
+    return result;
+}
+
+QStringList QMimeBinaryProvider::adaptiveMagicOrder()
+{
+    checkCache();
+    QStringList result;
+    foreach (CacheFile *cacheFile, m_cacheFiles) {
+        const int magicListOffset = cacheFile->getUint32(PosMagicListOffset);
+        const int firstMatchOffset = cacheFile->getUint32(magicListOffset + 8);
+        foreach (int i, cacheFile->magicOrder.order())
+            result.append(QLatin1String(cacheFile->getCharStar(cacheFile->getUint32(firstMatchOffset + i * 16 + 4))));
+    }
+    return result;
+}
+
+void QMimeBinaryProvider::addMemoryUsage(QMimeMemoryUsage &usage)
+{
+    usage.addHeap(QMimeDatabaseMemoryUsage::CacheFiles, QMimeMemoryUsage::arraySize(m_cacheFiles)
+                  + QMimeMemoryUsage::heapSize(m_cacheFileNames));
+    foreach (CacheFile *cacheFile, m_cacheFiles) {
+        usage.addHeap(QMimeDatabaseMemoryUsage::CacheFiles,
+                      sizeof(CacheFile) + QMimeMemoryUsage::heapSize(cacheFile->file.fileName()));
+        usage.addHeap(QMimeDatabaseMemoryUsage::GlobPatterns, cacheFile->globFilter.heapSize());
+        usage.addHeap(QMimeDatabaseMemoryUsage::MagicRules, cacheFile->magicOrder.heapSize());
+        if (cacheFile->isValid())
+            usage.addMapped(QMimeDatabaseMemoryUsage::CacheFiles, cacheFile->file.size());
+    }
+
+    // The interned types, shared with the callers of mimeTypeForName() and allMimeTypes()
+    qint64 mimeTypes = QMimeMemoryUsage::heapSize(m_mimetypeNames) + QMimeMemoryUsage::arraySize(m_mimeTypes);
+    qint64 comments = 0;
+    foreach (const QMimeType &mime, m_mimeTypes) {
+        mimeTypes += QMimeMemoryUsage::heapSize(mime);
+        comments += QMimeMemoryUsage::localeCommentsSize(mime);
+    }
+    usage.addHeap(QMimeDatabaseMemoryUsage::NameIndex, m_nameIndex.heapSize());
+
+    qint64 globs = 0;
+    mimeTypes += QMimeMemoryUsage::hashSize(m_metaData);
+    comments += QMimeMemoryUsage::heapSize(m_metaDataLanguages);
+    for (MetaDataHash::const_iterator it = m_metaData.constBegin(); it != m_metaData.constEnd(); ++it) {
+        mimeTypes += QMimeMemoryUsage::heapSize(it.key()) + QMimeMemoryUsage::heapSize(it.value().iconName);
+        comments += QMimeMemoryUsage::heapSize(it.value().localeComments);
+        globs += QMimeMemoryUsage::heapSize(it.value().globPatterns);
+    }
+    usage.addHeap(QMimeDatabaseMemoryUsage::MimeTypes, mimeTypes);
+    usage.addHeap(QMimeDatabaseMemoryUsage::LocaleComments, comments);
+    usage.addHeap(QMimeDatabaseMemoryUsage::GlobPatterns, globs);
+}
+
+void QMimeBinaryProvider::warmUp(QMimeDatabase::WarmUpFlags flags)
+{
+    checkCache();
+    // Globs, magic and the hierarchy are read straight from the mapped cache files
+    if (flags & (QMimeDatabase::WarmUpGlobs | QMimeDatabase::WarmUpMagic | QMimeDatabase::WarmUpHierarchy)) {
+        foreach (CacheFile *cacheFile, m_cacheFiles)
+            cacheFile->prefault();
+    }
+    if (!flags)
+        return;
+    loadMimeTypeList();
+    // What QMimeType::globPatterns() and comment() return comes from the package files
+    if (flags & (QMimeDatabase::WarmUpGlobs | QMimeDatabase::WarmUpComments)) {
+        foreach (const QMimeType &mime, m_mimeTypes)
+            loadMimeTypePrivate(*mime.d);
     }
 }
 
 QList<QMimeType> QMimeBinaryProvider::allMimeTypes()
 {
-    QList<QMimeType> result;
+    checkCache();
     loadMimeTypeList();
+    return m_mimeTypes;
+}
 
-    for (QSet<QString>::const_iterator it = m_mimetypeNames.constBegin();
-          it != m_mimetypeNames.constEnd(); ++it)
-        result.append(mimeTypeForNameUnchecked(*it));
+// The main pattern, i.e. the first one with a '*', goes first in the list of patterns
+static void moveMainPatternFirst(QStringList &globPatterns)
+{
+    for (int i = 0; i < globPatterns.size(); ++i) {
+        if (globPatterns.at(i).startsWith(QLatin1Char('*'))) {
+            if (i > 0)
+                globPatterns.move(i, 0);
+            return;
+        }
+    }
+}
 
-    return result;
+void QMimeBinaryProvider::addMetaData(const QMimeType &mt)
+{
+    // Files are parsed global first, then local: later files extend or override earlier ones
+    MetaData &metaData = m_metaData[mt.d->name];
+    QMimeTypePrivate::LocaleHash::const_iterator it = mt.d->localeComments.constBegin();
+    for ( ; it != mt.d->localeComments.constEnd(); ++it)
+        metaData.localeComments.insert(it.key(), it.value());
+    if (!mt.d->iconName.isEmpty())
+        metaData.iconName = mt.d->iconName;
+    foreach (const QString &pattern, mt.d->globPatterns) {
+        if (!metaData.globPatterns.contains(pattern))
+            metaData.globPatterns.append(pattern);
+    }
+}
+
+void QMimeBinaryProvider::removeGlobPatterns(const QString &name)
+{
+    const MetaDataHash::iterator it = m_metaData.find(name);
+    if (it != m_metaData.end())
+        it.value().globPatterns.clear();
 }
 
+// The per-type files in mime/ are generated by update-mime-database from the package files,
+// so parsing the few package files once is much cheaper than opening one file per type
+// on demand. The result is valid as long as the cache files don't change.
+void QMimeBinaryProvider::loadMetaData()
+{
+    if (m_metaDataLoaded)
+        return;
+    m_metaDataLoaded = true;
+    QMimeStatisticsTimer timer(QMimeDatabaseStatistics::XmlParsing);
+    m_metaData.clear();
+    m_metaDataLanguages = QMimeTypePrivate::commentLanguages();
+
+    const QStringList packageDirs = m_db->locateAll(QLatin1String("packages"), true);
+    QMimeMetaDataParser parser(*this, m_metaDataLanguages);
+    QListIterator<QString> dirIter(packageDirs);
+    dirIter.toBack();
+    while (dirIter.hasPrevious()) { // global first, then local.
+        const QString packageDir = dirIter.previous();
+        const QStringList files = QDir(packageDir).entryList(QStringList() << QLatin1String("*.xml"), QDir::Files);
+        foreach (const QString &file, files) {
+            const QString fileName = packageDir + QLatin1Char('/') + file;
+            QFile qfile(fileName);
+            if (!qfile.open(QIODevice::ReadOnly))
+                continue;
+            QString errorMessage;
+            if (!parser.parse(&qfile, fileName, &errorMessage))
+                qWarning("QMimeDatabase: Error loading %s\n%s", qPrintable(fileName), qPrintable(errorMessage));
+        }
+    }
+
+    for (MetaDataHash::iterator it = m_metaData.begin(); it != m_metaData.end(); ++it)
+        moveMainPatternFirst(it.value().globPatterns);
+}
+
+// Called with the database locked, see QMimeType. loaded is only set once the fields are filled.
 void QMimeBinaryProvider::loadMimeTypePrivate(QMimeTypePrivate &data)
 {
     if (data.loaded)
         return;
-    data.loaded = true;
     // load comment and globPatterns
 
+    checkCache();
+    loadMetaData();
+    const MetaDataHash::const_iterator it = m_metaData.constFind(data.name);
+    if (it == m_metaData.constEnd()) {
+        // Not in any package file (or no package files installed at all)
+        loadMimeTypeXml(data);
+    } else {
+        const MetaData &metaData = it.value();
+        data.localeComments = metaData.localeComments;
+        if (!metaData.iconName.isEmpty())
+            data.iconName = metaData.iconName;
+        data.globPatterns = metaData.globPatterns;
+    }
+    data.loaded = true;
+}
+
+// Reads the file generated by update-mime-database for this type only
+void QMimeBinaryProvider::loadMimeTypeXml(QMimeTypePrivate &data)
+{
+    QMimeStatisticsTimer timer(QMimeDatabaseStatistics::XmlParsing);
     const QString file = data.name + QLatin1String(".xml");
-    const QStringList mimeFiles = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QString::fromLatin1("mime/") + file);
+    const QStringList mimeFiles = m_db->locateAll(file);
     if (mimeFiles.isEmpty()) {
         // TODO: ask Thiago about this
         qWarning() << "No file found for" << file << ", even though the file appeared in a directory listing.";
         qWarning() << "Either it was just removed, or the directory doesn't have executable permission...";
-        qWarning() << QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime"), QStandardPaths::LocateDirectory);
+        qWarning() << m_db->locateAll(QString(), true);
         return;
     }
 
@@ -690,39 +1208,109 @@ QMimeType QMimeXMLProvider::mimeTypeForName(const QString &name)
     return m_nameMimeTypeMap.value(name);
 }
 
-QStringList QMimeXMLProvider::findByFileName(const QString &fileName, QString *foundSuffix)
+QStringList QMimeXMLProvider::findByFileName(const QString &fileName, QString *foundSuffix, int *weightPtr, int *patternLengthPtr)
 {
     ensureLoaded();
 
-    const QStringList matchingMimeTypes = m_mimeTypeGlobs.matchingGlobs(fileName, foundSuffix);
+    const QStringList matchingMimeTypes = m_mimeTypeGlobs.matchingGlobs(fileName, foundSuffix, weightPtr, patternLengthPtr);
     return matchingMimeTypes;
 }
 
-QMimeType QMimeXMLProvider::findByMagic(const QByteArray &data, int *accuracyPtr)
+QMimeType QMimeXMLProvider::findByMagic(const QByteArray &data, int *accuracyPtr, QMimeBudgetTracker *budget)
 {
     ensureLoaded();
+    if (m_db->m_detectionFlags & QMimeDatabase::AdaptiveMagicOrder)
+        return findByAdaptiveMagic(data, accuracyPtr, budget);
 
     QString candidate;
+    QMimeMagicProfile profile(budget);
+    budget = profile.tracker();
 
     foreach (const QMimeMagicRuleMatcher &matcher, m_magicMatchers) {
-        if (matcher.matches(data)) {
+        profile.start();
+        const bool matched = matcher.matches(data, budget);
+        profile.stop(matcher.mimetype(), matcher.priority(), matched);
+        if (matched) {
             const int priority = matcher.priority();
             if (priority > *accuracyPtr) {
                 *accuracyPtr = priority;
                 candidate = matcher.mimetype();
             }
         }
+        if (budget && budget->isExhausted())
+            break;
     }
     return mimeTypeForName(candidate);
 }
 
+static bool higherMagicPriority(const QMimeMagicRuleMatcher &m1, const QMimeMagicRuleMatcher &m2)
+{
+    return m1.priority() > m2.priority();
+}
+
+// What the data needs for the matcher to match, see QMimeMagicOrder
+static QMimeMagicOrder::Entry magicOrderEntry(const QMimeMagicRuleMatcher &matcher)
+{
+    QMimeMagicOrder::Entry entry;
+    entry.priority = matcher.priority();
+    foreach (const QMimeMagicRule &rule, matcher.magicRules()) {
+        if (!rule.isValid()) // never matches
+            continue;
+        // matchNumber() looks at endPos + 1 too
+        const int offsets = rule.endPos() - rule.startPos() + (rule.type() == QMimeMagicRule::String ? 1 : 2);
+        entry.addRule(rule.startPos(), offsets, rule.matchBytes(), rule.matchMask());
+    }
+    return entry;
+}
+
+// Same result as findByMagic(): the first match of the highest priority, in
+// the order of the files. The matchers are sorted by priority, so that the
+// first match wins, and m_magicOrder only changes the order within a priority.
+QMimeType QMimeXMLProvider::findByAdaptiveMagic(const QByteArray &data, int *accuracyPtr, QMimeBudgetTracker *budget)
+{
+    if (m_magicOrder.isEmpty() && !m_magicMatchers.isEmpty()) {
+        m_magicMatchersByPriority = m_magicMatchers;
+        qStableSort(m_magicMatchersByPriority.begin(), m_magicMatchersByPriority.end(), higherMagicPriority);
+        QVector<QMimeMagicOrder::Entry> entries;
+        entries.reserve(m_magicMatchersByPriority.count());
+        foreach (const QMimeMagicRuleMatcher &matcher, m_magicMatchersByPriority)
+            entries.append(magicOrderEntry(matcher));
+        m_magicOrder.setEntries(entries);
+    }
+
+    QMimeMagicProfile profile(budget);
+    budget = profile.tracker();
+
+    const QVector<int> &order = m_magicOrder.order();
+    for (int n = 0; n < order.count(); ++n) {
+        const int i = order.at(n);
+        const QMimeMagicRuleMatcher &matcher = m_magicMatchersByPriority.at(i);
+        const int priority = matcher.priority();
+        if (priority <= *accuracyPtr) // nor can the next ones do better
+            break;
+        profile.start();
+        const bool matched = matcher.matches(data, budget);
+        profile.stop(matcher.mimetype(), priority, matched);
+        if (matched) {
+            m_magicOrder.hit(i);
+            *accuracyPtr = priority;
+            return mimeTypeForName(matcher.mimetype());
+        }
+        if (budget && budget->isExhausted())
+            break;
+    }
+    return QMimeType();
+}
+
 void QMimeXMLProvider::ensureLoaded()
 {
     if (!m_loaded || shouldCheck()) {
+        QMIME_TRACE1(xml_load_entry, m_loaded ? "check" : "new");
+        QMimeStatisticsTimer timer(QMimeDatabaseStatistics::CacheCheck);
         bool fdoXmlFound = false;
         QStringList allFiles;
 
-        const QStringList packageDirs = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime/packages"), QStandardPaths::LocateDirectory);
+        const QStringList packageDirs = m_db->locateAll(QLatin1String("packages"), true);
         //qDebug() << "packageDirs=" << packageDirs;
         foreach (const QString &packageDir, packageDirs) {
             QDir dir(packageDir);
@@ -741,8 +1329,10 @@ void QMimeXMLProvider::ensureLoaded()
             allFiles.prepend(QLatin1String(":/qt-project.org/qmime/freedesktop.org.xml"));
         }
 
-        if (m_allFiles == allFiles)
+        if (m_allFiles == allFiles) {
+            QMIME_TRACE2(xml_load_return, allFiles.count(), 0);
             return;
+        }
         m_allFiles = allFiles;
 
         m_nameMimeTypeMap.clear();
@@ -750,11 +1340,16 @@ void QMimeXMLProvider::ensureLoaded()
         m_parents.clear();
         m_mimeTypeGlobs.clear();
         m_magicMatchers.clear();
+        m_magicMatchersByPriority.clear();
+        m_magicOrder.clear();
+        m_allMimeTypes.clear();
+        m_commentLanguages = QMimeTypePrivate::commentLanguages();
 
         //qDebug() << "Loading" << m_allFiles;
 
         foreach (const QString &file, allFiles)
             load(file);
+        QMIME_TRACE2(xml_load_return, allFiles.count(), 1);
     }
 }
 
@@ -768,9 +1363,10 @@ void QMimeXMLProvider::load(const QString &fileName)
 bool QMimeXMLProvider::load(const QString &fileName, QString *errorMessage)
 {
     m_loaded = true;
+    QMimeStatisticsTimer timer(QMimeDatabaseStatistics::XmlParsing);
 
     QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (!file.open(QIODevice::ReadOnly)) { // no text mode: the recorded locations are byte offsets
         if (errorMessage)
             *errorMessage = QString::fromLatin1("Cannot open %1: %2").arg(fileName, file.errorString());
         return false;
@@ -779,7 +1375,7 @@ bool QMimeXMLProvider::load(const QString &fileName, QString *errorMessage)
     if (errorMessage)
         errorMessage->clear();
 
-    QMimeTypeParser parser(*this);
+    QMimeTypeParser parser(*this, m_commentLanguages);
     return parser.parse(&file, fileName, errorMessage);
 }
 
@@ -790,7 +1386,10 @@ void QMimeXMLProvider::addGlobPattern(const QMimeGlobPattern &glob)
 
 void QMimeXMLProvider::addMimeType(const QMimeType &mt)
 {
-    m_nameMimeTypeMap.insert(mt.name(), mt);
+    m_allMimeTypes.clear();
+    QMimeTypePrivate data(mt);
+    data.database = m_db;
+    m_nameMimeTypeMap.insert(mt.name(), QMimeType(data));
 }
 
 QStringList QMimeXMLProvider::parents(const QString &mime)
@@ -821,15 +1420,357 @@ void QMimeXMLProvider::addAlias(const QString &alias, const QString &name)
     m_aliases.insert(alias, name);
 }
 
+int QMimeXMLProvider::maxMagicExtent()
+{
+    ensureLoaded();
+    int result = 0;
+    foreach (const QMimeMagicRuleMatcher &matcher, m_magicMatchers)
+        result = qMax(result, matcher.extent());
+    return result;
+}
+
+QStringList QMimeXMLProvider::adaptiveMagicOrder()
+{
+    QStringList result;
+    foreach (int i, m_magicOrder.order())
+        result.append(m_magicMatchersByPriority.at(i).mimetype());
+    return result;
+}
+
+void QMimeXMLProvider::addMemoryUsage(QMimeMemoryUsage &usage)
+{
+    qint64 mimeTypes = QMimeMemoryUsage::hashSize(m_nameMimeTypeMap) + QMimeMemoryUsage::arraySize(m_allMimeTypes)
+                       + QMimeMemoryUsage::heapSize(m_allFiles);
+    qint64 comments = QMimeMemoryUsage::heapSize(m_commentLanguages);
+    for (NameMimeTypeMap::const_iterator it = m_nameMimeTypeMap.constBegin(); it != m_nameMimeTypeMap.constEnd(); ++it) {
+        mimeTypes += QMimeMemoryUsage::heapSize(it.key()) + QMimeMemoryUsage::heapSize(it.value());
+        comments += QMimeMemoryUsage::localeCommentsSize(it.value());
+    }
+
+    usage.addHeap(QMimeDatabaseMemoryUsage::MimeTypes, mimeTypes);
+    usage.addHeap(QMimeDatabaseMemoryUsage::LocaleComments, comments);
+    usage.addHeap(QMimeDatabaseMemoryUsage::Aliases, QMimeMemoryUsage::heapSize(m_aliases));
+    usage.addHeap(QMimeDatabaseMemoryUsage::Parents, QMimeMemoryUsage::heapSize(m_parents));
+    usage.addHeap(QMimeDatabaseMemoryUsage::GlobPatterns, QMimeMemoryUsage::heapSize(m_mimeTypeGlobs));
+    usage.addHeap(QMimeDatabaseMemoryUsage::MagicRules, QMimeMemoryUsage::heapSize(m_magicMatchers)
+                  + QMimeMemoryUsage::arraySize(m_magicMatchersByPriority) + m_magicOrder.heapSize());
+}
+
+void QMimeXMLProvider::warmUp(QMimeDatabase::WarmUpFlags flags)
+{
+    // All of it is parsed at once anyway
+    if (flags)
+        allMimeTypes();
+}
+
 QList<QMimeType> QMimeXMLProvider::allMimeTypes()
 {
     ensureLoaded();
-    return m_nameMimeTypeMap.values();
+    if (m_allMimeTypes.isEmpty())
+        m_allMimeTypes = m_nameMimeTypeMap.values();
+    return m_allMimeTypes;
 }
 
 void QMimeXMLProvider::addMagicMatcher(const QMimeMagicRuleMatcher &matcher)
 {
     m_magicMatchers.append(matcher);
+    m_magicMatchersByPriority.clear();
+    m_magicOrder.clear();
+}
+
+QMimeOverlayProvider::QMimeOverlayProvider(QMimeDatabasePrivate *db, QMimeDatabasePrivate *base)
+    : QMimeProviderBase(db), m_base(base)
+{
+}
+
+bool QMimeOverlayProvider::isValid()
+{
+    return true;
+}
+
+QMimeProviderBase *QMimeOverlayProvider::baseProvider() const
+{
+    return m_base ? m_base->provider() : m_db->baseProvider();
+}
+
+// The base database of a tenant is shared with other threads, our own provider is
+// already protected by the caller holding m_db->mutex.
+QMutex *QMimeOverlayProvider::baseMutex() const
+{
+    return m_base ? &m_base->mutex : 0;
+}
+
+QMimeType QMimeOverlayProvider::mimeTypeForName(const QString &name)
+{
+    const NameMimeTypeMap::const_iterator it = m_nameMimeTypeMap.constFind(name);
+    if (it != m_nameMimeTypeMap.constEnd())
+        return it.value();
+    QMutexLocker locker(baseMutex());
+    return baseProvider()->mimeTypeForName(name);
+}
+
+QMimeType QMimeOverlayProvider::mimeTypeForNameOrAlias(const QString &nameOrAlias)
+{
+    const QString name = m_aliases.value(nameOrAlias, nameOrAlias);
+    const NameMimeTypeMap::const_iterator it = m_nameMimeTypeMap.constFind(name);
+    if (it != m_nameMimeTypeMap.constEnd())
+        return it.value();
+    QMutexLocker locker(baseMutex());
+    return baseProvider()->mimeTypeForNameOrAlias(name);
+}
+
+QStringList QMimeOverlayProvider::findByFileName(const QString &fileName, QString *foundSuffix, int *weightPtr, int *patternLengthPtr)
+{
+    QString suffix;
+    int weight = 0;
+    int patternLength = 0;
+    const QStringList matchingMimeTypes = m_mimeTypeGlobs.matchingGlobs(fileName, &suffix, &weight, &patternLength);
+
+    QString baseSuffix;
+    int baseWeight = 0;
+    int basePatternLength = 0;
+    QMutexLocker locker(baseMutex());
+    QStringList baseMimeTypes = baseProvider()->findByFileName(fileName, &baseSuffix, &baseWeight, &basePatternLength);
+    locker.unlock();
+    removeDeletedGlobs(baseMimeTypes, &baseSuffix);
+
+    // Like QMimeGlobMatchResult: the higher weight wins, then the longer pattern.
+    // On a tie our globs win, like a local directory overriding the global one.
+    const bool baseWins = !baseMimeTypes.isEmpty()
+            && (matchingMimeTypes.isEmpty() || baseWeight > weight
+                || (baseWeight == weight && basePatternLength > patternLength));
+    if (foundSuffix)
+        *foundSuffix = baseWins ? baseSuffix : suffix;
+    if (weightPtr)
+        *weightPtr = baseWins ? baseWeight : weight;
+    if (patternLengthPtr)
+        *patternLengthPtr = baseWins ? basePatternLength : patternLength;
+    return baseWins ? baseMimeTypes : matchingMimeTypes;
+}
+
+QStringList QMimeOverlayProvider::findByEncodedFileName(const char *fileName, int length, QString *foundSuffix)
+{
+    if (!m_mimeTypeGlobs.isEmpty())
+        return QMimeProviderBase::findByEncodedFileName(fileName, length, foundSuffix);
+
+    QMutexLocker locker(baseMutex());
+    QStringList baseMimeTypes = baseProvider()->findByEncodedFileName(fileName, length, foundSuffix);
+    locker.unlock();
+    removeDeletedGlobs(baseMimeTypes, foundSuffix);
+    return baseMimeTypes;
+}
+
+// The types whose globs were deleted by a registered <glob-deleteall/> don't match by name
+void QMimeOverlayProvider::removeDeletedGlobs(QStringList &baseMimeTypes, QString *foundSuffix) const
+{
+    if (m_globsDeleted.isEmpty())
+        return;
+    QMutableStringListIterator it(baseMimeTypes);
+    while (it.hasNext()) {
+        if (m_globsDeleted.contains(it.next()))
+            it.remove();
+    }
+    if (baseMimeTypes.isEmpty() && foundSuffix)
+        foundSuffix->clear();
+}
+
+QStringList QMimeOverlayProvider::parents(const QString &mime)
+{
+    const ParentsHash::const_iterator it = m_parents.constFind(mime);
+    if (it != m_parents.constEnd())
+        return it.value();
+    QMutexLocker locker(baseMutex());
+    return baseProvider()->parents(mime);
+}
+
+QString QMimeOverlayProvider::resolveAlias(const QString &name)
+{
+    const AliasHash::const_iterator it = m_aliases.constFind(name);
+    if (it != m_aliases.constEnd())
+        return it.value();
+    if (m_nameMimeTypeMap.contains(name))
+        return name;
+    QMutexLocker locker(baseMutex());
+    return baseProvider()->resolveAlias(name);
+}
+
+QMimeType QMimeOverlayProvider::findByMagic(const QByteArray &data, int *accuracyPtr, QMimeBudgetTracker *budget)
+{
+    QString candidate;
+    int priority = 0;
+    {
+        QMimeMagicProfile profile(budget);
+        QMimeBudgetTracker *tracker = profile.tracker();
+        foreach (const QMimeMagicRuleMatcher &matcher, m_magicMatchers) {
+            if (int(matcher.priority()) <= priority)
+                continue;
+            profile.start();
+            const bool matched = matcher.matches(data, tracker);
+            profile.stop(matcher.mimetype(), matcher.priority(), matched);
+            if (matched) {
+                priority = matcher.priority();
+                candidate = matcher.mimetype();
+            }
+            if (tracker && tracker->isExhausted())
+                break;
+        }
+    }
+
+    int baseAccuracy = 0;
+    QMimeType baseMimeType;
+    if (!budget || !budget->isExhausted()) {
+        QMutexLocker locker(baseMutex());
+        baseMimeType = baseProvider()->findByMagic(data, &baseAccuracy, budget);
+    }
+
+    // Ties go to the registered types
+    if (!candidate.isEmpty() && priority >= baseAccuracy) {
+        *accuracyPtr = priority;
+        return mimeTypeForName(candidate);
+    }
+    if (baseMimeType.isValid())
+        *accuracyPtr = baseAccuracy;
+    return baseMimeType;
+}
+
+int QMimeOverlayProvider::maxMagicExtent()
+{
+    int result = 0;
+    foreach (const QMimeMagicRuleMatcher &matcher, m_magicMatchers)
+        result = qMax(result, matcher.extent());
+
+    QMutexLocker locker(baseMutex());
+    return qMax(result, baseProvider()->maxMagicExtent());
+}
+
+// Only the base provider learns an order, the registered matchers are tried first
+QStringList QMimeOverlayProvider::adaptiveMagicOrder()
+{
+    QMutexLocker locker(baseMutex());
+    return baseProvider()->adaptiveMagicOrder();
+}
+
+void QMimeOverlayProvider::addMemoryUsage(QMimeMemoryUsage &usage)
+{
+    qint64 mimeTypes = QMimeMemoryUsage::hashSize(m_nameMimeTypeMap);
+    qint64 comments = 0;
+    for (NameMimeTypeMap::const_iterator it = m_nameMimeTypeMap.constBegin(); it != m_nameMimeTypeMap.constEnd(); ++it) {
+        mimeTypes += QMimeMemoryUsage::heapSize(it.key()) + QMimeMemoryUsage::heapSize(it.value());
+        comments += QMimeMemoryUsage::localeCommentsSize(it.value());
+    }
+    usage.addHeap(QMimeDatabaseMemoryUsage::MimeTypes, mimeTypes);
+    usage.addHeap(QMimeDatabaseMemoryUsage::LocaleComments, comments);
+    usage.addHeap(QMimeDatabaseMemoryUsage::Aliases, QMimeMemoryUsage::heapSize(m_aliases));
+    usage.addHeap(QMimeDatabaseMemoryUsage::Parents, QMimeMemoryUsage::heapSize(m_parents));
+    usage.addHeap(QMimeDatabaseMemoryUsage::GlobPatterns, QMimeMemoryUsage::heapSize(m_mimeTypeGlobs)
+                  + QMimeMemoryUsage::heapSize(m_globsDeleted));
+    usage.addHeap(QMimeDatabaseMemoryUsage::MagicRules, QMimeMemoryUsage::heapSize(m_magicMatchers));
+
+    // A tenant also pays for its share of the base database
+    QMutexLocker locker(baseMutex());
+    baseProvider()->addMemoryUsage(usage);
+}
+
+void QMimeOverlayProvider::warmUp(QMimeDatabase::WarmUpFlags flags)
+{
+    // The registered types are complete already
+    QMutexLocker locker(baseMutex());
+    baseProvider()->warmUp(flags);
+}
+
+QList<QMimeType> QMimeOverlayProvider::allMimeTypes()
+{
+    QMutexLocker locker(baseMutex());
+    const QList<QMimeType> baseMimeTypes = baseProvider()->allMimeTypes();
+    locker.unlock();
+
+    QList<QMimeType> result;
+    result.reserve(baseMimeTypes.size() + m_nameMimeTypeMap.size());
+    foreach (const QMimeType &mime, baseMimeTypes) {
+        if (!m_nameMimeTypeMap.contains(mime.name()))
+            result.append(mime);
+    }
+    result += m_nameMimeTypeMap.values();
+    return result;
+}
+
+// The registered types are complete, the others come from the base provider
+
+void QMimeOverlayProvider::loadMimeTypePrivate(QMimeTypePrivate &data)
+{
+    if (!m_nameMimeTypeMap.contains(data.name)) {
+        QMutexLocker locker(baseMutex());
+        baseProvider()->loadMimeTypePrivate(data);
+    }
+}
+
+void QMimeOverlayProvider::loadIcon(QMimeTypePrivate &data)
+{
+    if (!m_nameMimeTypeMap.contains(data.name)) {
+        QMutexLocker locker(baseMutex());
+        baseProvider()->loadIcon(data);
+    }
+}
+
+void QMimeOverlayProvider::loadGenericIcon(QMimeTypePrivate &data)
+{
+    if (!m_nameMimeTypeMap.contains(data.name)) {
+        QMutexLocker locker(baseMutex());
+        baseProvider()->loadGenericIcon(data);
+    }
+}
+
+bool QMimeOverlayProvider::registerMimeTypes(QIODevice *device, QString *errorMessage)
+{
+    QFile *file = qobject_cast<QFile *>(device);
+    const QString fileName = file ? file->fileName() : QString::fromLatin1("registered data");
+    const bool openedByUs = !device->isOpen();
+    if (openedByUs && !device->open(QIODevice::ReadOnly)) {
+        if (errorMessage)
+            *errorMessage = QString::fromLatin1("Cannot open %1: %2").arg(fileName, device->errorString());
+        return false;
+    }
+
+    Registration registration;
+    QMimeOverlayParser parser(registration);
+    QString parseError;
+    const bool ok = parser.parse(device, fileName, &parseError);
+    if (openedByUs)
+        device->close();
+    if (!ok) {
+        if (errorMessage)
+            *errorMessage = parseError;
+        return false;
+    }
+
+    // A type registered again replaces its previous definition
+    foreach (const QMimeType &mt, registration.mimeTypes) {
+        const QString &name = mt.name();
+        m_mimeTypeGlobs.removeMimeType(name);
+        m_parents.remove(name);
+        QMutableListIterator<QMimeMagicRuleMatcher> it(m_magicMatchers);
+        while (it.hasNext()) {
+            if (it.next().mimetype() == name)
+                it.remove();
+        }
+
+        QMimeTypePrivate data(mt);
+        data.database = m_db;
+        data.loaded = true;
+        m_nameMimeTypeMap.insert(name, QMimeType(data));
+    }
+    foreach (const QString &name, registration.globsDeleted) {
+        m_mimeTypeGlobs.removeMimeType(name);
+        m_globsDeleted.insert(name);
+    }
+    foreach (const QMimeGlobPattern &glob, registration.globs)
+        m_mimeTypeGlobs.addGlob(glob);
+    for (int i = 0; i < registration.parents.size(); ++i)
+        m_parents[registration.parents.at(i).first].append(registration.parents.at(i).second);
+    for (int i = 0; i < registration.aliases.size(); ++i)
+        m_aliases.insert(registration.aliases.at(i).first, registration.aliases.at(i).second);
+    m_magicMatchers += registration.magicMatchers;
+    return true;
 }
 
 QT_END_NAMESPACE
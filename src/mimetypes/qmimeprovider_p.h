@@ -44,10 +44,15 @@
 
 #include <QtCore/qdatetime.h>
 #include "qmimedatabase_p.h"
+#include "qmimemagicorder_p.h"
+#include "qmimememoryusage_p.h"
+#include "qmimenameindex_p.h"
 #include <QtCore/qset.h>
+#include <QtCore/qpair.h>
 
 QT_BEGIN_NAMESPACE
 
+class QMimeBudgetTracker;
 class QMimeMagicRuleMatcher;
 
 class QMimeProviderBase
@@ -58,10 +63,24 @@ public:
 
     virtual bool isValid() = 0;
     virtual QMimeType mimeTypeForName(const QString &name) = 0;
-    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix) = 0;
+    virtual QMimeType mimeTypeForNameOrAlias(const QString &nameOrAlias);
+    // weightPtr and patternLengthPtr, if not 0, receive the weight and the pattern length of the matches
+    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix, int *weightPtr = 0, int *patternLengthPtr = 0) = 0;
+    // fileName in the encoding of QFile::encodeName(), without its path
+    virtual QStringList findByEncodedFileName(const char *fileName, int length, QString *foundSuffix);
     virtual QStringList parents(const QString &mime) = 0;
     virtual QString resolveAlias(const QString &name) = 0;
-    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr) = 0;
+    // Gives up when budget, if not 0, is exhausted, and returns the best match so far
+    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr, QMimeBudgetTracker *budget) = 0;
+    // How many bytes of data findByMagic() looks at, at most
+    virtual int maxMagicExtent() = 0;
+    // The MIME types of the magic matchers in the order findByMagic() tries them with
+    // QMimeDatabase::AdaptiveMagicOrder, empty until that order was built
+    virtual QStringList adaptiveMagicOrder() { return QStringList(); }
+    // What is loaded so far, see QMimeDatabase::memoryUsage()
+    virtual void addMemoryUsage(QMimeMemoryUsage &usage) = 0;
+    // Loads now what flags needs, see QMimeDatabase::warmUp()
+    virtual void warmUp(QMimeDatabase::WarmUpFlags flags) = 0;
     virtual QList<QMimeType> allMimeTypes() = 0;
     virtual void loadMimeTypePrivate(QMimeTypePrivate &) {}
     virtual void loadIcon(QMimeTypePrivate &) {}
@@ -84,23 +103,37 @@ public:
 
     virtual bool isValid();
     virtual QMimeType mimeTypeForName(const QString &name);
-    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix);
+    virtual QMimeType mimeTypeForNameOrAlias(const QString &nameOrAlias);
+    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix, int *weightPtr = 0, int *patternLengthPtr = 0);
+    virtual QStringList findByEncodedFileName(const char *fileName, int length, QString *foundSuffix);
     virtual QStringList parents(const QString &mime);
     virtual QString resolveAlias(const QString &name);
-    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr);
+    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr, QMimeBudgetTracker *budget);
+    virtual int maxMagicExtent();
+    virtual QStringList adaptiveMagicOrder();
+    virtual void addMemoryUsage(QMimeMemoryUsage &usage);
+    virtual void warmUp(QMimeDatabase::WarmUpFlags flags);
     virtual QList<QMimeType> allMimeTypes();
     virtual void loadMimeTypePrivate(QMimeTypePrivate &);
     virtual void loadIcon(QMimeTypePrivate &);
     virtual void loadGenericIcon(QMimeTypePrivate &);
 
+    // Called by the metadata parser
+    void addMetaData(const QMimeType &mt);
+    void removeGlobPatterns(const QString &name);
+
 private:
     struct CacheFile;
 
     void matchGlobList(QMimeGlobMatchResult &result, CacheFile *cacheFile, int offset, const QString &fileName);
+    void matchGlobList(QMimeGlobMatchResult &result, CacheFile *cacheFile, int offset, const char *fileName, int length);
     bool matchSuffixTree(QMimeGlobMatchResult &result, CacheFile *cacheFile, int numEntries, int firstOffset, const QString &fileName, int charPos, bool caseSensitiveCheck);
-    bool matchMagicRule(CacheFile *cacheFile, int numMatchlets, int firstOffset, const QByteArray &data);
+    bool matchSuffixTree(QMimeGlobMatchResult &result, CacheFile *cacheFile, int numEntries, int firstOffset, const char *fileName, int length, int charPos, bool caseSensitiveCheck);
+    bool matchMagicRule(CacheFile *cacheFile, int numMatchlets, int firstOffset, const QByteArray &data, QMimeBudgetTracker *budget);
     QString iconForMime(CacheFile *cacheFile, int posListOffset, const QByteArray &inputMime);
     void loadMimeTypeList();
+    void loadMetaData();
+    void loadMimeTypeXml(QMimeTypePrivate &data);
     void checkCache();
 
     class CacheFileList : public QList<CacheFile *>
@@ -111,8 +144,23 @@ private:
     };
     CacheFileList m_cacheFiles;
     QStringList m_cacheFileNames;
-    QSet<QString> m_mimetypeNames;
+    // Built once per cache generation, shared with the callers of allMimeTypes()
+    QStringList m_mimetypeNames; // sorted
+    QList<QMimeType> m_mimeTypes; // same order as m_mimetypeNames
+    QMimeNameIndex m_nameIndex; // names and aliases -> index in m_mimetypeNames
     bool m_mimetypeListLoaded;
+
+    // What mime.cache doesn't have, for all types at once
+    struct MetaData
+    {
+        QMimeTypePrivate::LocaleHash localeComments; // only the commentLanguages()
+        QString iconName;
+        QStringList globPatterns;
+    };
+    typedef QHash<QString, MetaData> MetaDataHash;
+    MetaDataHash m_metaData;
+    QStringList m_metaDataLanguages;
+    bool m_metaDataLoaded;
 };
 
 /*
@@ -125,10 +173,14 @@ public:
 
     virtual bool isValid();
     virtual QMimeType mimeTypeForName(const QString &name);
-    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix);
+    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix, int *weightPtr = 0, int *patternLengthPtr = 0);
     virtual QStringList parents(const QString &mime);
     virtual QString resolveAlias(const QString &name);
-    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr);
+    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr, QMimeBudgetTracker *budget);
+    virtual int maxMagicExtent();
+    virtual QStringList adaptiveMagicOrder();
+    virtual void addMemoryUsage(QMimeMemoryUsage &usage);
+    virtual void warmUp(QMimeDatabase::WarmUpFlags flags);
     virtual QList<QMimeType> allMimeTypes();
 
     bool load(const QString &fileName, QString *errorMessage);
@@ -143,6 +195,7 @@ public:
 private:
     void ensureLoaded();
     void load(const QString &fileName);
+    QMimeType findByAdaptiveMagic(const QByteArray &data, int *accuracyPtr, QMimeBudgetTracker *budget);
 
     bool m_loaded;
 
@@ -157,7 +210,72 @@ private:
     QMimeAllGlobPatterns m_mimeTypeGlobs;
 
     QList<QMimeMagicRuleMatcher> m_magicMatchers;
+    // For QMimeDatabase::AdaptiveMagicOrder, built on demand
+    QList<QMimeMagicRuleMatcher> m_magicMatchersByPriority;
+    QMimeMagicOrder m_magicOrder;
     QStringList m_allFiles;
+    QList<QMimeType> m_allMimeTypes; // m_nameMimeTypeMap.values(), built on demand
+
+    // Only the comments in these languages are kept, the ones QMimeType::comment() looks at
+    QStringList m_commentLanguages;
+};
+
+/*
+   Types registered at runtime with QMimeDatabase::registerMimeTypes(), consulted
+   before the provider of the database underneath
+ */
+class QMimeOverlayProvider : public QMimeProviderBase
+{
+public:
+    // base is the database of a tenant database, 0 to layer over the own provider of db
+    QMimeOverlayProvider(QMimeDatabasePrivate *db, QMimeDatabasePrivate *base);
+
+    virtual bool isValid();
+    virtual QMimeType mimeTypeForName(const QString &name);
+    virtual QMimeType mimeTypeForNameOrAlias(const QString &nameOrAlias);
+    virtual QStringList findByFileName(const QString &fileName, QString *foundSuffix, int *weightPtr = 0, int *patternLengthPtr = 0);
+    virtual QStringList findByEncodedFileName(const char *fileName, int length, QString *foundSuffix);
+    virtual QStringList parents(const QString &mime);
+    virtual QString resolveAlias(const QString &name);
+    virtual QMimeType findByMagic(const QByteArray &data, int *accuracyPtr, QMimeBudgetTracker *budget);
+    virtual int maxMagicExtent();
+    virtual QStringList adaptiveMagicOrder();
+    virtual void addMemoryUsage(QMimeMemoryUsage &usage);
+    virtual void warmUp(QMimeDatabase::WarmUpFlags flags);
+    virtual QList<QMimeType> allMimeTypes();
+    virtual void loadMimeTypePrivate(QMimeTypePrivate &data);
+    virtual void loadIcon(QMimeTypePrivate &data);
+    virtual void loadGenericIcon(QMimeTypePrivate &data);
+
+    bool registerMimeTypes(QIODevice *device, QString *errorMessage);
+
+    // What the parser found in one document, applied only if all of it parsed fine
+    struct Registration
+    {
+        QList<QMimeType> mimeTypes;
+        QList<QMimeGlobPattern> globs;
+        QStringList globsDeleted;
+        QList<QPair<QString, QString> > parents; // child, parent
+        QList<QPair<QString, QString> > aliases; // alias, name
+        QList<QMimeMagicRuleMatcher> magicMatchers;
+    };
+
+private:
+    QMimeProviderBase *baseProvider() const;
+    QMutex *baseMutex() const;
+    void removeDeletedGlobs(QStringList &baseMimeTypes, QString *foundSuffix) const;
+
+    QMimeDatabasePrivate *m_base;
+
+    typedef QHash<QString, QMimeType> NameMimeTypeMap;
+    NameMimeTypeMap m_nameMimeTypeMap;
+    typedef QHash<QString, QString> AliasHash;
+    AliasHash m_aliases;
+    typedef QHash<QString, QStringList> ParentsHash;
+    ParentsHash m_parents;
+    QMimeAllGlobPatterns m_mimeTypeGlobs;
+    QSet<QString> m_globsDeleted; // hides the base globs of these types
+    QList<QMimeMagicRuleMatcher> m_magicMatchers;
 };
 
 QT_END_NAMESPACE
@@ -0,0 +1,562 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimestatistics_p.h"
+
+#include <QtCore/QList>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QtAlgorithms>
+
+#include <stdio.h>
+#include <string.h>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QMimeDatabaseStatistics
+    \brief The QMimeDatabaseStatistics class holds counters and latency histograms of QMimeDatabase.
+
+    Statistics are only collected when the environment variable QT_MIME_STATISTICS
+    is set to 1 when the application starts. Setting it to "dump" also prints
+    them to stderr when the application exits.
+
+    For each stage of MIME type detection, the number of times it ran, the total
+    time spent in it and a histogram of its durations are available. Collection is
+    cheap: every thread records into its own counters, which are only summed up
+    by QMimeDatabase::statistics().
+
+    Setting the environment variable QT_MIME_MAGIC_STATISTICS to 1 also counts
+    the evaluations, matches, compared bytes and time of every magic matcher,
+    that is of the magic rules of a MIME type at a given priority, for both
+    the XML and the mime.cache providers. This shows which rules cost the most
+    on the data of an application, and which ones actually match. It is more
+    expensive, as the clock is read around every matcher.
+
+    \sa QMimeDatabase::statistics()
+*/
+
+/*!
+    \class QMimeDatabaseStatistics::MagicMatcherCounters
+    \brief The MagicMatcherCounters class holds the counters of the magic rules of one MIME type at one priority.
+
+    \sa QMimeDatabaseStatistics::magicMatcherCounters()
+*/
+
+/*!
+    \variable QMimeDatabaseStatistics::MagicMatcherCounters::mimeType
+    The MIME type the rules are for.
+*/
+
+/*!
+    \variable QMimeDatabaseStatistics::MagicMatcherCounters::priority
+    The priority of the rules.
+*/
+
+/*!
+    \variable QMimeDatabaseStatistics::MagicMatcherCounters::evaluations
+    How many times the rules were evaluated.
+*/
+
+/*!
+    \variable QMimeDatabaseStatistics::MagicMatcherCounters::ruleEvaluations
+    How many rules and sub-rules were evaluated in total.
+*/
+
+/*!
+    \variable QMimeDatabaseStatistics::MagicMatcherCounters::matches
+    How many times the rules matched.
+*/
+
+/*!
+    \variable QMimeDatabaseStatistics::MagicMatcherCounters::bytesCompared
+    How many bytes of data the rules compared, at most: for each rule evaluated,
+    the bytes in its range.
+*/
+
+/*!
+    \variable QMimeDatabaseStatistics::MagicMatcherCounters::totalTime
+    The total time spent evaluating the rules, in nanoseconds.
+*/
+
+/*!
+    \enum QMimeDatabaseStatistics::Stage
+
+    \value CacheCheck Checking whether the MIME database files changed, and reloading them.
+    \value GlobMatching Matching a file name against the glob patterns.
+    \value MagicMatching Matching data against the magic rules.
+    \value DeviceRead Reading the beginning of a file or device for magic matching.
+    \value XmlParsing Parsing XML files for comments and glob patterns of types.
+    \value MutexWait Waiting for another thread to be done with the database.
+*/
+
+enum StatisticsMode {
+    StatisticsDisabled,
+    StatisticsEnabled,
+    StatisticsDumpedAtExit
+};
+
+static StatisticsMode readStatisticsMode()
+{
+    const QByteArray value = qgetenv("QT_MIME_STATISTICS");
+    if (value.isEmpty() || value == "0")
+        return StatisticsDisabled;
+    if (value == "dump")
+        return StatisticsDumpedAtExit;
+    return StatisticsEnabled;
+}
+
+static StatisticsMode statisticsMode()
+{
+    static const StatisticsMode mode = readStatisticsMode();
+    return mode;
+}
+
+static bool readMagicProfilingMode()
+{
+    const QByteArray value = qgetenv("QT_MIME_MAGIC_STATISTICS");
+    return !value.isEmpty() && value != "0";
+}
+
+static bool magicProfilingMode()
+{
+    static const bool enabled = readMagicProfilingMode();
+    return enabled;
+}
+
+static bool moreCostly(const QMimeDatabaseStatistics::MagicMatcherCounters &c1,
+                       const QMimeDatabaseStatistics::MagicMatcherCounters &c2)
+{
+    return c1.totalTime > c2.totalTime;
+}
+
+static int histogramBucket(qint64 nsecs)
+{
+    int bucket = 0;
+    while (nsecs > 1 && bucket < QMimeDatabaseStatistics::HistogramSize - 1) {
+        nsecs >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void QMimeStatisticsCounters::clear()
+{
+    memset(count, 0, sizeof(count));
+    memset(totalTime, 0, sizeof(totalTime));
+    memset(histogram, 0, sizeof(histogram));
+}
+
+void QMimeStatisticsCounters::add(const QMimeStatisticsCounters &other)
+{
+    for (int stage = 0; stage < QMimeDatabaseStatistics::StageCount; ++stage) {
+        count[stage] += other.count[stage];
+        totalTime[stage] += other.totalTime[stage];
+        for (int bucket = 0; bucket < QMimeDatabaseStatistics::HistogramSize; ++bucket)
+            histogram[stage][bucket] += other.histogram[stage][bucket];
+    }
+}
+
+void QMimeStatisticsCounters::record(QMimeDatabaseStatistics::Stage stage, qint64 nsecs)
+{
+    ++count[stage];
+    totalTime[stage] += nsecs;
+    ++histogram[stage][histogramBucket(nsecs)];
+}
+
+class QMimeStatisticsRegistry
+{
+public:
+    ~QMimeStatisticsRegistry();
+
+    QMimeStatisticsCounters sum();
+
+    QMutex mutex;
+    QList<QMimeStatisticsCounters *> threadCounters; // of the running threads
+    QMimeStatisticsCounters finishedThreads;
+    QMimeMagicCounterHash magicMatchers; // of all threads
+};
+
+Q_GLOBAL_STATIC(QMimeStatisticsRegistry, statisticsRegistry)
+
+// The counters of running threads are read without synchronization,
+// so the sum may miss the very last increments.
+QMimeStatisticsCounters QMimeStatisticsRegistry::sum()
+{
+    QMutexLocker locker(&mutex);
+    QMimeStatisticsCounters result = finishedThreads;
+    foreach (const QMimeStatisticsCounters *counters, threadCounters)
+        result.add(*counters);
+    return result;
+}
+
+QMimeStatisticsRegistry::~QMimeStatisticsRegistry()
+{
+    if (statisticsMode() != StatisticsDumpedAtExit)
+        return;
+    QMimeDatabaseStatistics statistics = QMimeStatistics::snapshot(*this);
+    fprintf(stderr, "%s", qPrintable(statistics.toString()));
+}
+
+// Owned by QThreadStorage: hands its counters over to the registry when its thread finishes
+class QMimeThreadStatistics
+{
+public:
+    QMimeThreadStatistics()
+    {
+        if (QMimeStatisticsRegistry *registry = statisticsRegistry()) {
+            QMutexLocker locker(&registry->mutex);
+            registry->threadCounters.append(&counters);
+        }
+    }
+
+    ~QMimeThreadStatistics()
+    {
+        if (QMimeStatisticsRegistry *registry = statisticsRegistry()) {
+            QMutexLocker locker(&registry->mutex);
+            registry->finishedThreads.add(counters);
+            registry->threadCounters.removeAll(&counters);
+        }
+    }
+
+    QMimeStatisticsCounters counters;
+};
+
+Q_GLOBAL_STATIC(QThreadStorage<QMimeThreadStatistics *>, threadStatistics)
+
+/*!
+    \internal
+    Returns true if QT_MIME_STATISTICS enables collection.
+*/
+bool QMimeStatistics::isEnabled()
+{
+    return statisticsMode() != StatisticsDisabled;
+}
+
+/*!
+    \internal
+    Returns true if QT_MIME_MAGIC_STATISTICS enables the counters of the magic matchers.
+*/
+bool QMimeStatistics::isMagicProfilingEnabled()
+{
+    return magicProfilingMode();
+}
+
+/*!
+    \internal
+    Records that \a stage ran for \a nsecs nanoseconds in the current thread.
+*/
+void QMimeStatistics::record(QMimeDatabaseStatistics::Stage stage, qint64 nsecs)
+{
+    QThreadStorage<QMimeThreadStatistics *> *storage = threadStatistics();
+    if (!storage) // exiting
+        return;
+    QMimeThreadStatistics *statistics = storage->localData();
+    if (!statistics) {
+        statistics = new QMimeThreadStatistics;
+        storage->setLocalData(statistics);
+    }
+    statistics->counters.record(stage, nsecs);
+}
+
+/*!
+    \internal
+    Adds \a counters, collected by one QMimeMagicProfile, to those of all threads.
+*/
+void QMimeStatistics::recordMagic(const QMimeMagicCounterHash &counters)
+{
+    QMimeStatisticsRegistry *registry = statisticsRegistry();
+    if (!registry || counters.isEmpty())
+        return;
+    QMutexLocker locker(&registry->mutex);
+    for (QMimeMagicCounterHash::const_iterator it = counters.constBegin(); it != counters.constEnd(); ++it) {
+        QMimeDatabaseStatistics::MagicMatcherCounters &total = registry->magicMatchers[it.key()];
+        total.mimeType = it.value().mimeType;
+        total.priority = it.value().priority;
+        total.evaluations += it.value().evaluations;
+        total.ruleEvaluations += it.value().ruleEvaluations;
+        total.matches += it.value().matches;
+        total.bytesCompared += it.value().bytesCompared;
+        total.totalTime += it.value().totalTime;
+    }
+}
+
+/*!
+    \internal
+    Locks \a mutex, recording the time spent waiting for it.
+*/
+void QMimeStatistics::lock(QMutex *mutex)
+{
+    if (!isEnabled()) {
+        mutex->lock();
+        return;
+    }
+    if (mutex->tryLock()) {
+        record(QMimeDatabaseStatistics::MutexWait, 0);
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    mutex->lock();
+    record(QMimeDatabaseStatistics::MutexWait, timer.nsecsElapsed());
+}
+
+QMimeDatabaseStatistics QMimeStatistics::snapshot(QMimeStatisticsRegistry &registry)
+{
+    QMimeDatabaseStatistics result;
+    result.d->enabled = isEnabled();
+    result.d->counters = registry.sum();
+    result.d->magicProfilingEnabled = isMagicProfilingEnabled();
+    {
+        QMutexLocker locker(&registry.mutex);
+        result.d->magicMatchers = registry.magicMatchers.values();
+    }
+    qStableSort(result.d->magicMatchers.begin(), result.d->magicMatchers.end(), moreCostly);
+    return result;
+}
+
+/*!
+    \internal
+    Returns the statistics of all threads so far.
+*/
+QMimeDatabaseStatistics QMimeStatistics::snapshot()
+{
+    QMimeStatisticsRegistry *registry = statisticsRegistry();
+    if (!registry)
+        return QMimeDatabaseStatistics();
+    return snapshot(*registry);
+}
+
+QMimeMagicProfile::QMimeMagicProfile(QMimeBudgetTracker *budget)
+    : m_enabled(QMimeStatistics::isMagicProfilingEnabled()),
+      m_tracker(budget),
+      m_evaluations(0),
+      m_bytesCompared(0)
+{
+    if (m_enabled && !m_tracker)
+        m_tracker = &m_counter;
+}
+
+QMimeMagicProfile::~QMimeMagicProfile()
+{
+    if (m_enabled)
+        QMimeStatistics::recordMagic(m_counters);
+}
+
+void QMimeMagicProfile::startMatcher()
+{
+    m_evaluations = m_tracker->evaluations();
+    m_bytesCompared = m_tracker->bytesCompared();
+    m_timer.start();
+}
+
+void QMimeMagicProfile::recordMatcher(const QString &mimeType, int priority, bool matched)
+{
+    const qint64 nsecs = m_timer.nsecsElapsed();
+    QMimeDatabaseStatistics::MagicMatcherCounters &counters = m_counters[qMakePair(mimeType, priority)];
+    counters.mimeType = mimeType;
+    counters.priority = priority;
+    ++counters.evaluations;
+    counters.ruleEvaluations += m_tracker->evaluations() - m_evaluations;
+    counters.matches += matched;
+    counters.bytesCompared += m_tracker->bytesCompared() - m_bytesCompared;
+    counters.totalTime += nsecs;
+}
+
+/*!
+    Constructs empty counters.
+*/
+QMimeDatabaseStatistics::MagicMatcherCounters::MagicMatcherCounters()
+    : priority(0), evaluations(0), ruleEvaluations(0), matches(0), bytesCompared(0), totalTime(0)
+{
+}
+
+/*!
+    Constructs empty statistics.
+*/
+QMimeDatabaseStatistics::QMimeDatabaseStatistics()
+    : d(new QMimeDatabaseStatisticsPrivate)
+{
+}
+
+/*!
+    Constructs a copy of \a other.
+*/
+QMimeDatabaseStatistics::QMimeDatabaseStatistics(const QMimeDatabaseStatistics &other)
+    : d(other.d)
+{
+}
+
+/*!
+    Assigns \a other to these statistics.
+*/
+QMimeDatabaseStatistics &QMimeDatabaseStatistics::operator=(const QMimeDatabaseStatistics &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+    Destroys the statistics.
+*/
+QMimeDatabaseStatistics::~QMimeDatabaseStatistics()
+{
+}
+
+/*!
+    Returns true if statistics were collected, i.e. QT_MIME_STATISTICS is set.
+*/
+bool QMimeDatabaseStatistics::isEnabled() const
+{
+    return d->enabled;
+}
+
+/*!
+    Returns how many times \a stage ran.
+*/
+qint64 QMimeDatabaseStatistics::count(Stage stage) const
+{
+    return d->counters.count[stage];
+}
+
+/*!
+    Returns the total time spent in \a stage, in nanoseconds.
+*/
+qint64 QMimeDatabaseStatistics::totalTime(Stage stage) const
+{
+    return d->counters.totalTime[stage];
+}
+
+/*!
+    Returns the histogram of the durations of \a stage: the item at index i
+    counts the runs which took from 2^i to 2^(i+1) nanoseconds. The first item
+    also counts runs below one nanosecond, the last one all longer runs.
+*/
+QVector<qint64> QMimeDatabaseStatistics::histogram(Stage stage) const
+{
+    QVector<qint64> result(HistogramSize);
+    for (int bucket = 0; bucket < HistogramSize; ++bucket)
+        result[bucket] = d->counters.histogram[stage][bucket];
+    return result;
+}
+
+/*!
+    Returns true if the counters of the magic matchers were collected, i.e.
+    QT_MIME_MAGIC_STATISTICS is set.
+*/
+bool QMimeDatabaseStatistics::isMagicProfilingEnabled() const
+{
+    return d->magicProfilingEnabled;
+}
+
+/*!
+    Returns the counters of the magic matchers evaluated so far, the ones
+    which took the most time first.
+*/
+QList<QMimeDatabaseStatistics::MagicMatcherCounters> QMimeDatabaseStatistics::magicMatcherCounters() const
+{
+    return d->magicMatchers;
+}
+
+/*!
+    Returns a short English name for \a stage.
+*/
+QString QMimeDatabaseStatistics::stageName(Stage stage)
+{
+    switch (stage) {
+    case CacheCheck:
+        return QLatin1String("cache check");
+    case GlobMatching:
+        return QLatin1String("glob matching");
+    case MagicMatching:
+        return QLatin1String("magic matching");
+    case DeviceRead:
+        return QLatin1String("device read");
+    case XmlParsing:
+        return QLatin1String("XML parsing");
+    case MutexWait:
+        return QLatin1String("mutex wait");
+    }
+    return QString();
+}
+
+/*!
+    Returns the statistics as text, one line per stage, for logging.
+    Histogram buckets are written as "lower bound in ns:count", empty ones are left out.
+    The magic matchers follow, if they were profiled, one line each, the most
+    costly first.
+*/
+QString QMimeDatabaseStatistics::toString() const
+{
+    QString result;
+    if (d->enabled)
+        result = QLatin1String("QMimeDatabase statistics:\n");
+    else
+        result = QLatin1String("QMimeDatabase statistics: disabled, set QT_MIME_STATISTICS=1\n");
+    for (int i = 0; d->enabled && i < StageCount; ++i) {
+        const Stage stage = Stage(i);
+        result += QString::fromLatin1("  %1: %2 times, %3 us total")
+                .arg(stageName(stage)).arg(count(stage)).arg(totalTime(stage) / 1000);
+        if (count(stage) > 0) {
+            result += QLatin1String(", histogram:");
+            for (int bucket = 0; bucket < HistogramSize; ++bucket) {
+                const qint64 n = d->counters.histogram[stage][bucket];
+                if (n > 0)
+                    result += QString::fromLatin1(" %1:%2").arg(bucket == 0 ? 0 : qint64(1) << bucket).arg(n);
+            }
+        }
+        result += QLatin1Char('\n');
+    }
+
+    if (d->magicProfilingEnabled) {
+        result += QLatin1String("QMimeDatabase magic matchers, most costly first:\n");
+        foreach (const MagicMatcherCounters &counters, d->magicMatchers) {
+            result += QString::fromLatin1("  %1 (priority %2): %3 us total, %4 times, %5 matches, %6 rules, %7 bytes\n")
+                    .arg(counters.mimeType).arg(counters.priority).arg(counters.totalTime / 1000)
+                    .arg(counters.evaluations).arg(counters.matches).arg(counters.ruleEvaluations)
+                    .arg(counters.bytesCompared);
+        }
+    }
+    return result;
+}
+
+QT_END_NAMESPACE
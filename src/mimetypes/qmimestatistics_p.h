@@ -0,0 +1,207 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMESTATISTICS_P_H
+#define QMIMESTATISTICS_P_H
+
+#include "qmimedatabase.h"
+#include "qmimedetectionbudget_p.h"
+
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qpair.h>
+
+QT_BEGIN_NAMESPACE
+
+struct QMimeStatisticsCounters
+{
+    QMimeStatisticsCounters() { clear(); }
+
+    void clear();
+    void add(const QMimeStatisticsCounters &other);
+    void record(QMimeDatabaseStatistics::Stage stage, qint64 nsecs);
+
+    qint64 count[QMimeDatabaseStatistics::StageCount];
+    qint64 totalTime[QMimeDatabaseStatistics::StageCount];
+    // bucket i counts durations in [2^i, 2^(i+1)) nanoseconds, bucket 0 also has 0
+    qint64 histogram[QMimeDatabaseStatistics::StageCount][QMimeDatabaseStatistics::HistogramSize];
+};
+
+// The counters of the magic matchers, by MIME type and priority
+typedef QHash<QPair<QString, int>, QMimeDatabaseStatistics::MagicMatcherCounters> QMimeMagicCounterHash;
+
+class QMimeDatabaseStatisticsPrivate : public QSharedData
+{
+public:
+    QMimeDatabaseStatisticsPrivate() : enabled(false), magicProfilingEnabled(false) {}
+
+    bool enabled;
+    QMimeStatisticsCounters counters;
+    bool magicProfilingEnabled;
+    QList<QMimeDatabaseStatistics::MagicMatcherCounters> magicMatchers; // most costly first
+};
+
+/*
+   Collection of QMimeDatabaseStatistics, enabled by the QT_MIME_STATISTICS environment variable.
+   Each thread records into its own counters, they are only summed up by snapshot().
+ */
+class QMimeStatisticsRegistry;
+class QMimeStatistics
+{
+public:
+    static bool isEnabled();
+    static bool isMagicProfilingEnabled();
+    static void record(QMimeDatabaseStatistics::Stage stage, qint64 nsecs);
+    static void recordMagic(const QMimeMagicCounterHash &counters);
+    static void lock(QMutex *mutex);
+    static QMimeDatabaseStatistics snapshot();
+
+private:
+    friend class QMimeStatisticsRegistry;
+    static QMimeDatabaseStatistics snapshot(QMimeStatisticsRegistry &registry);
+};
+
+// Records the time until it goes out of scope, if statistics are enabled
+class QMimeStatisticsTimer
+{
+    Q_DISABLE_COPY(QMimeStatisticsTimer)
+
+public:
+    explicit QMimeStatisticsTimer(QMimeDatabaseStatistics::Stage stage)
+        : m_stage(stage), m_enabled(QMimeStatistics::isEnabled())
+    {
+        if (m_enabled)
+            m_timer.start();
+    }
+
+    ~QMimeStatisticsTimer()
+    {
+        if (m_enabled)
+            QMimeStatistics::record(m_stage, m_timer.nsecsElapsed());
+    }
+
+private:
+    QMimeDatabaseStatistics::Stage m_stage;
+    bool m_enabled;
+    QElapsedTimer m_timer;
+};
+
+/*
+   Records the cost of the magic matchers evaluated by one findByMagic(), if
+   QT_MIME_MAGIC_STATISTICS is set, and hands them over to QMimeStatistics
+   when it goes out of scope. The rules are to be evaluated with tracker(),
+   which counts them and the bytes they compare.
+ */
+class QMimeMagicProfile
+{
+    Q_DISABLE_COPY(QMimeMagicProfile)
+
+public:
+    explicit QMimeMagicProfile(QMimeBudgetTracker *budget);
+    ~QMimeMagicProfile();
+
+    // budget, or a tracker counting the cost if there is none
+    QMimeBudgetTracker *tracker() const { return m_tracker; }
+
+    inline void start()
+    {
+        if (m_enabled)
+            startMatcher();
+    }
+
+    inline void stop(const QString &mimeType, int priority, bool matched)
+    {
+        if (m_enabled)
+            recordMatcher(mimeType, priority, matched);
+    }
+
+    inline void stop(const char *mimeType, int priority, bool matched)
+    {
+        if (m_enabled)
+            recordMatcher(QString::fromLatin1(mimeType), priority, matched);
+    }
+
+private:
+    void startMatcher();
+    void recordMatcher(const QString &mimeType, int priority, bool matched);
+
+    const bool m_enabled;
+    QMimeBudgetTracker m_counter;
+    QMimeBudgetTracker *m_tracker;
+    QElapsedTimer m_timer;
+    int m_evaluations;
+    qint64 m_bytesCompared;
+    QMimeMagicCounterHash m_counters;
+};
+
+// QMutexLocker which records the time spent waiting for the mutex
+class QMimeDatabaseLocker
+{
+    Q_DISABLE_COPY(QMimeDatabaseLocker)
+
+public:
+    explicit QMimeDatabaseLocker(QMutex *mutex)
+        : m_mutex(mutex), m_locked(true)
+    {
+        QMimeStatistics::lock(mutex);
+    }
+
+    ~QMimeDatabaseLocker()
+    {
+        if (m_locked)
+            m_mutex->unlock();
+    }
+
+    void unlock()
+    {
+        m_mutex->unlock();
+        m_locked = false;
+    }
+
+private:
+    QMutex *m_mutex;
+    bool m_locked;
+};
+
+QT_END_NAMESPACE
+
+#endif // QMIMESTATISTICS_P_H
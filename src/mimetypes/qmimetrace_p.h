@@ -0,0 +1,100 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef QMIMETRACE_P_H
+#define QMIMETRACE_P_H
+
+//
+// Static tracepoints (USDT) for perf, bpftrace and SystemTap, provider "qtmimetypes".
+//
+// Built with "qmake CONFIG+=mime_usdt" (needs <sys/sdt.h>, e.g. from systemtap-sdt-dev),
+// otherwise all of this expands to nothing and the arguments are never evaluated.
+// Each probe has a semaphore which the tracer increments while attached, so that
+// arguments that are costly to compute (file names) are only built when someone listens:
+//
+//     if (QMIME_TRACE_ENABLED(find_by_file_name_entry))
+//         QMIME_TRACE1(find_by_file_name_entry, fileName.toUtf8().constData());
+//
+// Example: bpftrace -e 'usdt:libQtMimeTypes.so:qtmimetypes:find_by_magic_return { @[str(arg0)] = count(); }'
+//
+
+#include <QtCore/qglobal.h>
+
+// Probe name, then arguments
+#define QMIME_TRACEPOINTS(X) \
+    X(mime_type_for_file_entry)   /* file name */ \
+    X(mime_type_for_file_return)  /* file name, chosen type */ \
+    X(file_name_and_data_entry)   /* file name */ \
+    X(file_name_and_data_return)  /* file name, chosen type, bytes read */ \
+    X(find_by_magic_entry)        /* bytes */ \
+    X(find_by_magic_return)       /* type or "", accuracy */ \
+    X(find_by_file_name_entry)    /* file name */ \
+    X(find_by_file_name_return)   /* file name, number of matching types */ \
+    X(cache_reload_entry)         /* mime.cache path, cause: "new" or "modified" */ \
+    X(cache_reload_return)        /* mime.cache path, 1 if valid */ \
+    X(xml_load_entry)             /* cause: "new" or "check" */ \
+    X(xml_load_return)            /* number of package files, 1 if they were (re)parsed */
+
+#ifdef QMIME_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define QMIME_TRACE_SEMAPHORE(probe) qtmimetypes_##probe##_semaphore
+#define QMIME_DECLARE_TRACE_SEMAPHORE(probe) extern "C" unsigned short QMIME_TRACE_SEMAPHORE(probe);
+QMIME_TRACEPOINTS(QMIME_DECLARE_TRACE_SEMAPHORE)
+#undef QMIME_DECLARE_TRACE_SEMAPHORE
+
+#define QMIME_TRACE_ENABLED(probe) __builtin_expect(QMIME_TRACE_SEMAPHORE(probe) != 0, 0)
+#define QMIME_TRACE1(probe, a) DTRACE_PROBE1(qtmimetypes, probe, a)
+#define QMIME_TRACE2(probe, a, b) DTRACE_PROBE2(qtmimetypes, probe, a, b)
+#define QMIME_TRACE3(probe, a, b, c) DTRACE_PROBE3(qtmimetypes, probe, a, b, c)
+
+#else
+
+#define QMIME_TRACE_ENABLED(probe) false
+#define QMIME_TRACE1(probe, a) do { } while (0)
+#define QMIME_TRACE2(probe, a, b) do { } while (0)
+#define QMIME_TRACE3(probe, a, b, c) do { } while (0)
+
+#endif // QMIME_USDT
+
+#endif // QMIMETRACE_P_H
@@ -46,6 +46,7 @@
 #include "qmimeprovider_p.h"
 
 #include "qmimeglobpattern_p.h"
+#include "qmimestatistics_p.h"
 
 #include <QtCore/QDebug>
 #include <QtCore/QLocale>
@@ -60,13 +61,25 @@ bool qt_isQMimeTypeDebuggingActivated (false);
 #define DBG() if (0) qDebug() << static_cast<const void *>(this) << Q_FUNC_INFO
 #endif
 
+static inline QMimeDatabasePrivate *databaseOf(const QMimeTypePrivate &d)
+{
+    return d.database ? d.database : QMimeDatabasePrivate::instance();
+}
+
+// Copies the fields of d with the database it comes from locked
+static QMimeTypePrivate lockedCopy(const QMimeTypePrivate &d)
+{
+    QMimeDatabaseLocker locker(&databaseOf(d)->mutex);
+    return d;
+}
+
 QMimeTypePrivate::QMimeTypePrivate()
         //name(),
         //localeComments(),
         //genericIconName(),
         //iconName(),
         //globPatterns()
-        : loaded(false)
+        : loaded(false), database(0)
 {}
 
 QMimeTypePrivate::QMimeTypePrivate(const QMimeType &other)
@@ -75,7 +88,8 @@ QMimeTypePrivate::QMimeTypePrivate(const QMimeType &other)
         genericIconName(other.d->genericIconName),
         iconName(other.d->iconName),
         globPatterns(other.d->globPatterns),
-        loaded(other.d->loaded)
+        loaded(other.d->loaded),
+        database(other.d->database)
 {}
 
 void QMimeTypePrivate::clear()
@@ -116,6 +130,24 @@ void QMimeTypePrivate::addGlobPattern(const QString &pattern)
     globPatterns.append(pattern);
 }
 
+/*!
+    \internal
+    Returns the languages used to look up QMimeType::comment(), most specific first:
+    the system language, then the same language without its country ("pt_BR" -> "pt").
+    Providers use this to keep only the comments that can actually be returned.
+*/
+QStringList QMimeTypePrivate::commentLanguages()
+{
+    const QString systemLanguage = QLocale::system().name();
+    const QString lang = systemLanguage == QLatin1String("C") ? QLatin1String("en_US") : systemLanguage;
+    QStringList languages;
+    languages << lang;
+    const int pos = lang.indexOf(QLatin1Char('_'));
+    if (pos != -1)
+        languages << lang.left(pos);
+    return languages;
+}
+
 /*!
     \class QMimeType
     \brief The QMimeType class describes types of file or data, represented by a MIME type string.
@@ -147,13 +179,8 @@ void QMimeTypePrivate::addGlobPattern(const QString &pattern)
 QMimeType::QMimeType() :
         d(new QMimeTypePrivate())
 {
+    // Only the name: providers construct types with the database locked.
     DBG() << "name():" << name();
-    //DBG() << "aliases():" << aliases();
-    DBG() << "genericIconName():" << genericIconName();
-    DBG() << "iconName():" << iconName();
-    DBG() << "globPatterns():" << globPatterns();
-    DBG() << "suffixes():" << suffixes();
-    DBG() << "preferredSuffix():" << preferredSuffix();
 }
 
 /*!
@@ -163,13 +190,8 @@ QMimeType::QMimeType() :
 QMimeType::QMimeType(const QMimeType &other) :
         d(other.d)
 {
+    // Only the name: providers construct types with the database locked.
     DBG() << "name():" << name();
-    //DBG() << "aliases():" << aliases();
-    DBG() << "genericIconName():" << genericIconName();
-    DBG() << "iconName():" << iconName();
-    DBG() << "globPatterns():" << globPatterns();
-    DBG() << "suffixes():" << suffixes();
-    DBG() << "preferredSuffix():" << preferredSuffix();
 }
 
 /*!
@@ -190,13 +212,8 @@ QMimeType &QMimeType::operator=(const QMimeType &other)
 QMimeType::QMimeType(const QMimeTypePrivate &dd) :
         d(new QMimeTypePrivate(dd))
 {
+    // Only the name: providers construct types with the database locked.
     DBG() << "name():" << name();
-    //DBG() << "aliases():" << aliases();
-    DBG() << "genericIconName():" << genericIconName();
-    DBG() << "iconName():" << iconName();
-    DBG() << "globPatterns():" << globPatterns();
-    DBG() << "suffixes():" << suffixes();
-    DBG() << "preferredSuffix():" << preferredSuffix();
 }
 
 /*!
@@ -217,13 +234,8 @@ QMimeType::QMimeType(const QMimeTypePrivate &dd) :
  */
 QMimeType::~QMimeType()
 {
+    // Only the name: providers construct types with the database locked.
     DBG() << "name():" << name();
-    //DBG() << "aliases():" << aliases();
-    DBG() << "genericIconName():" << genericIconName();
-    DBG() << "iconName():" << iconName();
-    DBG() << "globPatterns():" << globPatterns();
-    DBG() << "suffixes():" << suffixes();
-    DBG() << "preferredSuffix():" << preferredSuffix();
 }
 
 /*!
@@ -232,7 +244,10 @@ QMimeType::~QMimeType()
  */
 bool QMimeType::operator==(const QMimeType &other) const
 {
-    return d == other.d || *d == *other.d;
+    if (d == other.d)
+        return true;
+    // The lazily loaded fields may be filled by another thread: snapshot each side under its database lock
+    return lockedCopy(*d) == lockedCopy(*other.d);
 }
 
 /*!
@@ -258,7 +273,7 @@ bool QMimeType::isValid() const
  */
 bool QMimeType::isDefault() const
 {
-    return d->name == QMimeDatabasePrivate::instance()->defaultMimeType();
+    return d->name == databaseOf(*d)->defaultMimeType();
 }
 
 /*!
@@ -277,23 +292,14 @@ QString QMimeType::name() const
  */
 QString QMimeType::comment() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadMimeTypePrivate(*d);
+    QMimeDatabasePrivate *database = databaseOf(*d);
+    QMimeDatabaseLocker locker(&database->mutex);
+    database->provider()->loadMimeTypePrivate(*d);
 
-    QStringList languageList;
-    languageList << QLocale::system().name();
-    Q_FOREACH (const QString &language, languageList) {
-        const QString lang = language == QLatin1String("C") ? QLatin1String("en_US") : language;
+    Q_FOREACH (const QString &lang, QMimeTypePrivate::commentLanguages()) {
         const QString comm = d->localeComments.value(lang);
         if (!comm.isEmpty())
             return comm;
-        const int pos = lang.indexOf(QLatin1Char('_'));
-        if (pos != -1) {
-            // "pt_BR" not found? try just "pt"
-            const QString shortLang = lang.left(pos);
-            const QString commShort = d->localeComments.value(shortLang);
-            if (!commShort.isEmpty())
-                return commShort;
-        }
     }
 
     // Use the mimetype name as fallback
@@ -313,7 +319,9 @@ QString QMimeType::comment() const
  */
 QString QMimeType::genericIconName() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadGenericIcon(*d);
+    QMimeDatabasePrivate *database = databaseOf(*d);
+    QMimeDatabaseLocker locker(&database->mutex);
+    database->provider()->loadGenericIcon(*d);
     if (d->genericIconName.isEmpty()) {
         // From the spec:
         // If the generic icon name is empty (not specified by the mimetype definition)
@@ -337,7 +345,9 @@ QString QMimeType::genericIconName() const
  */
 QString QMimeType::iconName() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadIcon(*d);
+    QMimeDatabasePrivate *database = databaseOf(*d);
+    QMimeDatabaseLocker locker(&database->mutex);
+    database->provider()->loadIcon(*d);
     if (d->iconName.isEmpty()) {
         // Make default icon name from the mimetype name
         d->iconName = name();
@@ -354,7 +364,9 @@ QString QMimeType::iconName() const
  */
 QStringList QMimeType::globPatterns() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadMimeTypePrivate(*d);
+    QMimeDatabasePrivate *database = databaseOf(*d);
+    QMimeDatabaseLocker locker(&database->mutex);
+    database->provider()->loadMimeTypePrivate(*d);
     return d->globPatterns;
 }
 
@@ -372,12 +384,14 @@ QStringList QMimeType::globPatterns() const
 */
 QStringList QMimeType::parentMimeTypes() const
 {
-    return QMimeDatabasePrivate::instance()->provider()->parents(d->name);
+    QMimeDatabasePrivate *database = databaseOf(*d);
+    QMimeDatabaseLocker locker(&database->mutex);
+    return database->provider()->parents(d->name);
 }
 
-static void collectParentMimeTypes(const QString &mime, QStringList &allParents)
+static void collectParentMimeTypes(QMimeProviderBase *provider, const QString &mime, QStringList &allParents)
 {
-    QStringList parents = QMimeDatabasePrivate::instance()->provider()->parents(mime);
+    QStringList parents = provider->parents(mime);
     foreach (const QString &parent, parents) {
         // I would use QSet, but since order matters I better not
         if (!allParents.contains(parent))
@@ -386,7 +400,7 @@ static void collectParentMimeTypes(const QString &mime, QStringList &allParents)
     // We want a breadth-first search, so that the least-specific parent (octet-stream) is last
     // This means iterating twice, unfortunately.
     foreach (const QString &parent, parents) {
-        collectParentMimeTypes(parent, allParents);
+        collectParentMimeTypes(provider, parent, allParents);
     }
 }
 
@@ -402,8 +416,10 @@ static void collectParentMimeTypes(const QString &mime, QStringList &allParents)
 */
 QStringList QMimeType::allAncestors() const
 {
+    QMimeDatabasePrivate *database = databaseOf(*d);
+    QMimeDatabaseLocker locker(&database->mutex);
     QStringList allParents;
-    collectParentMimeTypes(d->name, allParents);
+    collectParentMimeTypes(database->provider(), d->name, allParents);
     return allParents;
 }
 
@@ -413,10 +429,8 @@ QStringList QMimeType::allAncestors() const
  */
 QStringList QMimeType::suffixes() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadMimeTypePrivate(*d);
-
     QStringList result;
-    foreach (const QString &pattern, d->globPatterns) {
+    foreach (const QString &pattern, globPatterns()) {
         // Not a simple suffix if if looks like: README or *. or *.* or *.JP*G or *.JP?
         if (pattern.startsWith(QLatin1String("*.")) &&
             pattern.length() > 2 &&
@@ -445,15 +459,15 @@ QString QMimeType::preferredSuffix() const
 */
 QString QMimeType::filterString() const
 {
-    QMimeDatabasePrivate::instance()->provider()->loadMimeTypePrivate(*d);
+    const QStringList patterns = globPatterns();
     QString filter;
 
-    if (!d->globPatterns.empty()) {
+    if (!patterns.empty()) {
         filter += comment() + QLatin1String(" (");
-        for (int i = 0; i < d->globPatterns.size(); ++i) {
+        for (int i = 0; i < patterns.size(); ++i) {
             if (i != 0)
                 filter += QLatin1Char(' ');
-            filter += d->globPatterns.at(i);
+            filter += patterns.at(i);
         }
         filter +=  QLatin1Char(')');
     }
@@ -471,7 +485,9 @@ bool QMimeType::inherits(const QString &mimeTypeName) const
 {
     if (d->name == mimeTypeName)
         return true;
-    return QMimeDatabasePrivate::instance()->inherits(d->name, mimeTypeName);
+    QMimeDatabasePrivate *database = databaseOf(*d);
+    QMimeDatabaseLocker locker(&database->mutex);
+    return database->inherits(d->name, mimeTypeName);
 }
 
 #undef DBG
@@ -105,6 +105,7 @@ protected:
     friend class QMimeXMLProvider;
     friend class QMimeBinaryProvider;
     friend class QMimeTypePrivate;
+    friend class QMimeMemoryUsage;
 
     QExplicitlySharedDataPointer<QMimeTypePrivate> d;
 };
@@ -49,6 +49,8 @@
 
 QT_BEGIN_NAMESPACE
 
+class QMimeDatabasePrivate;
+
 class Q_AUTOTEST_EXPORT QMimeTypePrivate : public QSharedData
 {
 public:
@@ -63,12 +65,18 @@ public:
 
     void addGlobPattern(const QString &pattern);
 
+    static QStringList commentLanguages();
+
+    // The types are shared by all the threads using a database. Apart from the name, which is
+    // set when the provider builds the type, the fields are filled lazily by the provider's
+    // load*() methods and are only read or written with the database mutex locked.
     QString name;
     LocaleHash localeComments;
     QString genericIconName;
     QString iconName;
     QStringList globPatterns;
     bool loaded;
+    QMimeDatabasePrivate *database; // the one the type comes from, 0 for the default database
 };
 
 QT_END_NAMESPACE
@@ -49,6 +49,7 @@
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDebug>
 #include <QtCore/QDir>
+#include <QtCore/QIODevice>
 #include <QtCore/QPair>
 #include <QtCore/QXmlStreamReader>
 #include <QtCore/QXmlStreamWriter>
@@ -66,6 +67,7 @@ static const char genericIconTagC[] = "generic-icon";
 static const char iconTagC[] = "icon";
 static const char nameAttributeC[] = "name";
 static const char globTagC[] = "glob";
+static const char globDeleteAllTagC[] = "glob-deleteall";
 static const char aliasTagC[] = "alias";
 static const char patternAttributeC[] = "pattern";
 static const char weightAttributeC[] = "weight";
@@ -108,6 +110,12 @@ static const char matchMaskAttributeC[] = "mask";
     Overwrite to process the sequence of parsed data
 */
 
+/*!
+    \fn virtual void QMimeTypeParserBase::processGlobDeleteAll(const QString &name);
+    Called for <glob-deleteall/>: the glob patterns of \a name defined by files
+    parsed earlier must be discarded. Does nothing by default.
+*/
+
 QMimeTypeParserBase::ParseState QMimeTypeParserBase::nextState(ParseState currentState, const QStringRef &startElement)
 {
     switch (currentState) {
@@ -124,6 +132,7 @@ QMimeTypeParserBase::ParseState QMimeTypeParserBase::nextState(ParseState curren
     case ParseGenericIcon:
     case ParseIcon:
     case ParseGlobPattern:
+    case ParseGlobDeleteAll:
     case ParseSubClass:
     case ParseAlias:
     case ParseOtherMimeTypeSubTag:
@@ -138,6 +147,8 @@ QMimeTypeParserBase::ParseState QMimeTypeParserBase::nextState(ParseState curren
             return ParseIcon;
         if (startElement == QLatin1String(globTagC))
             return ParseGlobPattern;
+        if (startElement == QLatin1String(globDeleteAllTagC))
+            return ParseGlobDeleteAll;
         if (startElement == QLatin1String(subClassTagC))
             return ParseSubClass;
         if (startElement == QLatin1String(aliasTagC))
@@ -246,6 +257,11 @@ bool QMimeTypeParserBase::parse(QIODevice *dev, const QString &fileName, QString
                 data.addGlobPattern(pattern); // just for QMimeType::globPatterns()
             }
                 break;
+            case ParseGlobDeleteAll:
+                // Patterns from previously parsed files (and from this element) no longer apply
+                data.globPatterns.clear();
+                processGlobDeleteAll(data.name);
+                break;
             case ParseSubClass: {
                 const QString inheritsFrom = atts.value(QLatin1String(mimeTypeAttributeC)).toString();
                 if (!inheritsFrom.isEmpty())
@@ -258,7 +274,8 @@ bool QMimeTypeParserBase::parse(QIODevice *dev, const QString &fileName, QString
                 const QString comment = reader.readElementText();
                 if (locale.isEmpty())
                     locale = QString::fromLatin1("en_US");
-                data.localeComments.insert(locale, comment);
+                if (m_commentLanguages.isEmpty() || m_commentLanguages.contains(locale))
+                    data.localeComments.insert(locale, comment);
             }
                 break;
             case ParseAlias: {
@@ -45,6 +45,7 @@
 
 #include "qmimedatabase_p.h"
 #include "qmimeprovider_p.h"
+#include "qmimemagicrulematcher_p.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -55,7 +56,9 @@ class QMimeTypeParserBase
     Q_DISABLE_COPY(QMimeTypeParserBase)
 
 public:
-    QMimeTypeParserBase() {}
+    // Only comments in commentLanguages are kept, all of them if it is empty
+    explicit QMimeTypeParserBase(const QStringList &commentLanguages = QStringList())
+        : m_commentLanguages(commentLanguages) {}
     virtual ~QMimeTypeParserBase() {}
 
     bool parse(QIODevice *dev, const QString &fileName, QString *errorMessage);
@@ -66,6 +69,7 @@ protected:
     virtual void processParent(const QString &child, const QString &parent) = 0;
     virtual void processAlias(const QString &alias, const QString &name) = 0;
     virtual void processMagicMatcher(const QMimeMagicRuleMatcher &matcher) = 0;
+    virtual void processGlobDeleteAll(const QString &) {}
 
 private:
     enum ParseState {
@@ -76,6 +80,7 @@ private:
         ParseGenericIcon,
         ParseIcon,
         ParseGlobPattern,
+        ParseGlobDeleteAll,
         ParseSubClass,
         ParseAlias,
         ParseMagic,
@@ -85,13 +90,16 @@ private:
     };
 
     static ParseState nextState(ParseState currentState, const QStringRef &startElement);
+
+    QStringList m_commentLanguages;
 };
 
 
 class QMimeTypeParser : public QMimeTypeParserBase
 {
 public:
-    explicit QMimeTypeParser(QMimeXMLProvider &provider) : m_provider(provider) {}
+    QMimeTypeParser(QMimeXMLProvider &provider, const QStringList &commentLanguages)
+        : QMimeTypeParserBase(commentLanguages), m_provider(provider) {}
 
 protected:
     inline bool process(const QMimeType &t, QString *)
@@ -113,6 +121,66 @@ private:
     QMimeXMLProvider &m_provider;
 };
 
+/*
+   Collects comments, icons and glob patterns from the package files for QMimeBinaryProvider,
+   which gets everything else from mime.cache.
+ */
+class QMimeMetaDataParser : public QMimeTypeParserBase
+{
+public:
+    QMimeMetaDataParser(QMimeBinaryProvider &provider, const QStringList &commentLanguages)
+        : QMimeTypeParserBase(commentLanguages), m_provider(provider) {}
+
+protected:
+    inline bool process(const QMimeType &t, QString *)
+    { m_provider.addMetaData(t); return true; }
+
+    inline bool process(const QMimeGlobPattern &, QString *)
+    { return true; }
+
+    inline void processParent(const QString &, const QString &) {}
+    inline void processAlias(const QString &, const QString &) {}
+    inline void processMagicMatcher(const QMimeMagicRuleMatcher &) {}
+
+    inline void processGlobDeleteAll(const QString &name)
+    { m_provider.removeGlobPatterns(name); }
+
+private:
+    QMimeBinaryProvider &m_provider;
+};
+
+/*
+   Collects the definitions passed to QMimeDatabase::registerMimeTypes()
+ */
+class QMimeOverlayParser : public QMimeTypeParserBase
+{
+public:
+    explicit QMimeOverlayParser(QMimeOverlayProvider::Registration &registration)
+        : m_registration(registration) {}
+
+protected:
+    inline bool process(const QMimeType &t, QString *)
+    { m_registration.mimeTypes.append(t); return true; }
+
+    inline bool process(const QMimeGlobPattern &glob, QString *)
+    { m_registration.globs.append(glob); return true; }
+
+    inline void processParent(const QString &child, const QString &parent)
+    { m_registration.parents.append(qMakePair(child, parent)); }
+
+    inline void processAlias(const QString &alias, const QString &name)
+    { m_registration.aliases.append(qMakePair(alias, name)); }
+
+    inline void processMagicMatcher(const QMimeMagicRuleMatcher &matcher)
+    { m_registration.magicMatchers.append(matcher); }
+
+    inline void processGlobDeleteAll(const QString &name)
+    { m_registration.globsDeleted.append(name); }
+
+private:
+    QMimeOverlayProvider::Registration &m_registration;
+};
+
 QT_END_NAMESPACE
 
 #endif // MIMETYPEPARSER_P_H
@@ -0,0 +1,204 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the QtCore module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#define QT_NO_CAST_FROM_ASCII
+
+#include "qmimezipcontainer_p.h"
+
+#include "qmimestatistics_p.h"
+
+#include <QtCore/QIODevice>
+#include <QtCore/QtEndian>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+    \class QMimeZipContainer
+
+    \brief The QMimeZipContainer class finds out what a zip archive contains.
+
+    Magic only sees "zip" for OpenDocument, EPUB, Office Open XML, Java and
+    Android archives. This looks at the first member, which is the "mimetype"
+    file in OpenDocument and EPUB archives, and then at the names in the
+    central directory.
+
+    \a head is the data already read from the current position of \a device.
+    The device is only used for the end of the archive (at most TailSize
+    bytes) and the central directory (at most CentralDirectorySize bytes),
+    if it is random-access. Its position is restored afterwards. Without a
+    device, \a head is the whole archive.
+ */
+
+// Local file header
+enum {
+    LocalHeaderSize = 30,
+    LocalFlags = 6,
+    LocalMethod = 8,
+    LocalCompressedSize = 18,
+    LocalNameLength = 26,
+    LocalExtraLength = 28
+};
+
+// End of central directory record
+enum {
+    EndRecordSize = 22,
+    EndDirectorySize = 12,
+    EndDirectoryOffset = 16
+};
+
+// Central directory file header
+enum {
+    CentralHeaderSize = 46,
+    CentralNameLength = 28,
+    CentralExtraLength = 30,
+    CentralCommentLength = 32
+};
+
+static inline quint16 uint16At(const QByteArray &data, int pos)
+{
+    return qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(data.constData() + pos));
+}
+
+static inline quint32 uint32At(const QByteArray &data, int pos)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(data.constData() + pos));
+}
+
+QMimeZipContainer::QMimeZipContainer(const QByteArray &head, QIODevice *device)
+    : m_head(head), m_device(device), m_start(device ? device->pos() : 0)
+{
+}
+
+/*!
+    Returns the name of the MIME type of the archive contents, or an empty
+    string if they aren't recognized.
+ */
+QString QMimeZipContainer::mimeType()
+{
+    if (!m_head.startsWith("PK\x03\x04"))
+        return QString();
+    const QString member = mimeTypeMember();
+    if (!member.isEmpty())
+        return member;
+    return mimeTypeFromCentralDirectory();
+}
+
+QByteArray QMimeZipContainer::read(qint64 offset, int length)
+{
+    if (offset < 0 || length <= 0)
+        return QByteArray();
+    if (!m_device || offset + length <= m_head.size())
+        return m_head.mid(offset, length);
+    if (m_device->isSequential())
+        return QByteArray();
+
+    QMimeStatisticsTimer timer(QMimeDatabaseStatistics::DeviceRead);
+    const qint64 pos = m_device->pos();
+    QByteArray data;
+    if (m_device->seek(m_start + offset))
+        data = m_device->read(length);
+    m_device->seek(pos);
+    return data;
+}
+
+// The uncompressed "mimetype" first member of OpenDocument and EPUB archives
+QString QMimeZipContainer::mimeTypeMember()
+{
+    if (m_head.size() < LocalHeaderSize)
+        return QString();
+    const int nameLength = uint16At(m_head, LocalNameLength);
+    if (m_head.mid(LocalHeaderSize, nameLength) != "mimetype")
+        return QString();
+    const bool hasDataDescriptor = uint16At(m_head, LocalFlags) & 0x8;
+    const quint32 size = uint32At(m_head, LocalCompressedSize);
+    if (uint16At(m_head, LocalMethod) != 0 || hasDataDescriptor || size == 0 || size > 255)
+        return QString();
+
+    const QByteArray content = read(LocalHeaderSize + nameLength + uint16At(m_head, LocalExtraLength), size);
+    if (content.size() != int(size) || !content.contains('/'))
+        return QString();
+    for (int i = 0; i < content.size(); ++i) {
+        if (content.at(i) <= ' ' || content.at(i) > '~')
+            return QString();
+    }
+    return QString::fromLatin1(content.constData(), content.size());
+}
+
+QString QMimeZipContainer::mimeTypeFromCentralDirectory()
+{
+    const qint64 size = m_device && !m_device->isSequential() ? m_device->size() - m_start : m_head.size();
+    const int tailSize = int(qMin<qint64>(size, TailSize));
+    const QByteArray tail = read(size - tailSize, tailSize);
+    const int end = tail.lastIndexOf("PK\x05\x06");
+    if (end < 0 || end + EndRecordSize > tail.size())
+        return QString();
+    const quint32 directoryOffset = uint32At(tail, end + EndDirectoryOffset);
+    if (directoryOffset == 0xffffffff) // zip64
+        return QString();
+    const int directorySize = int(qMin<quint32>(uint32At(tail, end + EndDirectorySize), CentralDirectorySize));
+    const QByteArray directory = read(directoryOffset, directorySize);
+
+    bool javaArchive = false;
+    int pos = 0;
+    while (pos + CentralHeaderSize <= directory.size() && directory.mid(pos, 4) == "PK\x01\x02") {
+        const int nameLength = uint16At(directory, pos + CentralNameLength);
+        if (pos + CentralHeaderSize + nameLength > directory.size())
+            break;
+        const QByteArray name = directory.mid(pos + CentralHeaderSize, nameLength);
+        if (name == "AndroidManifest.xml" || name == "classes.dex")
+            return QString::fromLatin1("application/vnd.android.package-archive");
+        if (name.startsWith("word/"))
+            return QString::fromLatin1("application/vnd.openxmlformats-officedocument.wordprocessingml.document");
+        if (name.startsWith("xl/"))
+            return QString::fromLatin1("application/vnd.openxmlformats-officedocument.spreadsheetml.sheet");
+        if (name.startsWith("ppt/"))
+            return QString::fromLatin1("application/vnd.openxmlformats-officedocument.presentationml.presentation");
+        // Android archives have one too, keep looking for their own files
+        if (name == "META-INF/MANIFEST.MF")
+            javaArchive = true;
+        pos += CentralHeaderSize + nameLength + uint16At(directory, pos + CentralExtraLength)
+               + uint16At(directory, pos + CentralCommentLength);
+    }
+    return javaArchive ? QString::fromLatin1("application/x-java-archive") : QString();
+}
+
+QT_END_NAMESPACE
@@ -40,18 +40,30 @@
 ****************************************************************************/
 
 #include <qmimedatabase.h>
+#include "qmimedatabase_p.h"
+#include "qmimemagiccorpus_p.h"
+#include "qmimenameindex_p.h"
 
 #include "qstandardpaths.h"
 
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QTextStream>
+#include <QtCore/QThreadPool>
 #include <QtCore/QtConcurrentRun>
 #include <QtCore/QFuture>
 
 #include <QtTest/QtTest>
 
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 static const char yastFileName[] ="yast2-metapackage-handler-mimetypes.xml";
+static const char magicCorpusFileName[] = "magic-corpus-mimetypes.xml";
 
 static int initializeLang()
 {
@@ -93,6 +105,10 @@ tst_QMimeDatabase::tst_QMimeDatabase()
 
 void tst_QMimeDatabase::initTestCase()
 {
+    // Read once, on the first use of a database
+    qputenv("QT_MIME_STATISTICS", "1");
+    qputenv("QT_MIME_MAGIC_STATISTICS", "1");
+
     QTemporaryFile _name;
     QString _dirName;
     if (_name.open()) {
@@ -146,6 +162,25 @@ void tst_QMimeDatabase::initTestCase()
              qPrintable(QString::fromLatin1("Cannot find '%1' starting from '%2'").
                         arg(yastFileName, QDir::currentPath())));
 
+#ifdef QMIME_BUILD_INTERNAL
+    // The headers of magicCorpus(), detected with only the rules they come from
+    const QString corpusMimeDir = m_temporaryDir.path() + QLatin1String("/magic-corpus-xdg/mime");
+    const QString corpusPackage = corpusMimeDir + QLatin1String("/packages/") + QLatin1String(magicCorpusFileName);
+    QVERIFY(here.mkpath(corpusMimeDir + QLatin1String("/packages")));
+    QVERIFY(QFile::copy(QLatin1String(SRCDIR) + QLatin1String(magicCorpusFileName), corpusPackage));
+    QMimeDatabase corpusDb(QStringList() << corpusMimeDir);
+    QMimeMagicCorpusCounts counts;
+    QString errorMessage;
+    const QString corpusDir = m_temporaryDir.path() + QLatin1String("/magic-corpus");
+    QVERIFY2(qmime_writeMagicCorpus(corpusDir, QStringList() << corpusPackage, corpusDb, &counts, &errorMessage),
+             qPrintable(errorMessage));
+    // Every rule path of the package has a header, and a near-miss
+    QCOMPARE(counts.unsatisfiable, 0);
+    QCOMPARE(counts.positives, 13);
+    QCOMPARE(counts.negatives, counts.positives);
+    m_magicCorpus = corpusDir;
+#endif
+
     init();
 }
 
@@ -228,6 +263,12 @@ void tst_QMimeDatabase::mimeTypeForFileName_data()
     QTest::newRow("glob that ends with *, also matches *.nfo. Higher weight wins.") << "README.nfo" << "text/x-nfo";
     // fdo bug 15436, needs shared-mime-info >= 0.40 (and this tests the globs2-parsing code).
     QTest::newRow("glob that ends with *, also matches *.pdf. *.pdf has higher weight") << "README.pdf" << "application/pdf";
+    QTest::newRow("glob that uses [] ranges") << "001.vdr" << "video/mpeg";
+    QTest::newRow("glob that ends with []") << "foo.ANIM7" << "video/x-anim";
+    QTest::newRow("one-character suffix") << "notes~" << "application/x-trash";
+    QTest::newRow("literal") << "AUTHORS" << "text/x-authors";
+    QTest::newRow("hash, matches nothing") << "3f786850e387550fdab836ed7e6dc881de23001b" << "application/octet-stream";
+    QTest::newRow("temporary file, matches nothing") << "tmpa9Xk2Q" << "application/octet-stream";
     QTest::newRow("directory") << "/" << "inode/directory";
     QTest::newRow("doesn't exist, no extension") << "IDontExist" << "application/octet-stream";
     QTest::newRow("doesn't exist but has known extension") << "IDontExist.txt" << "text/plain";
@@ -266,6 +307,31 @@ void tst_QMimeDatabase::mimeTypeForFileName()
     }
 }
 
+void tst_QMimeDatabase::mimeTypeForEncodedFileName_data()
+{
+    mimeTypeForFileName_data();
+
+    QTest::newRow("relative path") << "dir.txt/textfile.C" << "text/x-c++src";
+    QTest::newRow("absolute path") << "/tmp/README.nfo" << "text/x-nfo";
+    QTest::newRow("non-ASCII") << QString::fromUtf8("\xc3\xa9t\xc3\xa9.TXT") << "text/plain";
+}
+
+void tst_QMimeDatabase::mimeTypeForEncodedFileName()
+{
+    QFETCH(QString, fileName);
+    QFETCH(QString, expectedMimeType);
+    QMimeDatabase db;
+    const QByteArray encodedFileName = QFile::encodeName(fileName);
+    QCOMPARE(db.mimeTypeForFileName(encodedFileName).name(), expectedMimeType);
+    QCOMPARE(db.mimeTypeForFileName(encodedFileName.constData(), -1).name(), expectedMimeType);
+
+    QList<QMimeType> mimes = db.mimeTypesForFileName(encodedFileName.constData(), encodedFileName.size());
+    QList<QMimeType> expectedMimes = db.mimeTypesForFileName(fileName);
+    QCOMPARE(mimes.count(), expectedMimes.count());
+    for (int i = 0; i < mimes.count(); ++i)
+        QCOMPARE(mimes.at(i).name(), expectedMimes.at(i).name());
+}
+
 void tst_QMimeDatabase::mimeTypesForFileName_data()
 {
     QTest::addColumn<QString>("fileName");
@@ -374,6 +440,119 @@ void tst_QMimeDatabase::aliases()
     QVERIFY(!mustWriteMimeType);
 }
 
+#ifdef QMIME_BUILD_INTERNAL
+static void checkNameIndex(const QMimeNameIndex &index, const QHash<QString, int> &entries)
+{
+    for (QHash<QString, int>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it)
+        QCOMPARE(index.value(it.key()), it.value());
+
+    // A miss still lands in the slot of some key, only the comparison rejects it
+    const QStringList misses = QStringList()
+        << QString()
+        << QString::fromLatin1("application/x-qttest-")
+        << QString::fromLatin1("application/x-qttest-2000")
+        << QString::fromLatin1("Application/x-qttest-1")
+        << QString::fromLatin1("application/x-qttest-1 ")
+        << QString::fromLatin1("text/plai");
+    foreach (const QString &miss, misses)
+        QCOMPARE(index.value(miss), -1);
+}
+#endif
+
+void tst_QMimeDatabase::nameIndex()
+{
+#ifdef QMIME_BUILD_INTERNAL
+    QHash<QString, int> entries;
+    for (int i = 0; i < 2000; ++i)
+        entries.insert(QString::fromLatin1("application/x-qttest-%1").arg(i), i);
+    // Aliases share the value of their type
+    entries.insert(QString::fromLatin1("text/plain"), 7);
+    entries.insert(QString::fromLatin1("text/x-qttest-alias"), 7);
+
+    QMimeNameIndex index;
+    QVERIFY(index.isEmpty());
+    QCOMPARE(index.value(QString::fromLatin1("text/plain")), -1);
+
+    QVERIFY(index.build(entries));
+    QVERIFY(index.isPerfect());
+    checkNameIndex(index, entries);
+    if (QTest::currentTestFailed())
+        return;
+
+    // Without a seed to try, the QHash fallback gives the same answers
+    QMimeNameIndex fallback;
+    QVERIFY(!fallback.build(entries, 0));
+    QVERIFY(!fallback.isPerfect());
+    QVERIFY(!fallback.isEmpty());
+    checkNameIndex(fallback, entries);
+    if (QTest::currentTestFailed())
+        return;
+
+    // Building again forgets the previous keys, whichever way they were stored
+    QHash<QString, int> single;
+    single.insert(QString::fromLatin1("text/plain"), 0);
+    QVERIFY(fallback.build(single));
+    QVERIFY(fallback.isPerfect());
+    QCOMPARE(fallback.value(QString::fromLatin1("text/plain")), 0);
+    QCOMPARE(fallback.value(QString::fromLatin1("application/x-qttest-1")), -1);
+    QCOMPARE(fallback.value(QString::fromLatin1("text/x-qttest-alias")), -1);
+
+    QVERIFY(index.build(QHash<QString, int>()));
+    QVERIFY(index.isEmpty());
+    QCOMPARE(index.value(QString::fromLatin1("text/plain")), -1);
+#else
+    QSKIP("QMimeNameIndex is only exported from internal builds", SkipSingle);
+#endif
+}
+
+void tst_QMimeDatabase::aliasNameCollision()
+{
+    // A type that is also declared as the alias of another one is hidden by the alias,
+    // in the parsed package files as well as in the index of the cache
+    const QString xmlDir = m_temporaryDir.path() + QLatin1String("/alias-collision-xml/mime");
+    const QString cacheDir = m_temporaryDir.path() + QLatin1String("/alias-collision-cache/mime");
+    const QByteArray package =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<mime-info xmlns=\"http://www.freedesktop.org/standards/shared-mime-info\">\n"
+        "  <mime-type type=\"application/x-qttest-owner\">\n"
+        "    <comment>owner</comment>\n"
+        "    <alias type=\"application/x-qttest-collision\"/>\n"
+        "    <alias type=\"application/x-qttest-alias\"/>\n"
+        "  </mime-type>\n"
+        "  <mime-type type=\"application/x-qttest-collision\">\n"
+        "    <comment>collision</comment>\n"
+        "  </mime-type>\n"
+        "</mime-info>\n";
+    QStringList dirs = QStringList() << xmlDir;
+    if (qgetenv("QT_NO_MIME_CACHE").isEmpty())
+        dirs << cacheDir;
+    foreach (const QString &dir, dirs) {
+        QVERIFY(QDir().mkpath(dir + QLatin1String("/packages")));
+        QFile file(dir + QLatin1String("/packages/qttest-alias-collision.xml"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QCOMPARE(file.write(package), qint64(package.size()));
+    }
+
+    QList<QStringList> databaseDirs;
+    databaseDirs << (QStringList() << xmlDir);
+    if (dirs.contains(cacheDir)) {
+        QString errorMessage;
+        QVERIFY2(QMimeDatabase::updateMimeCache(cacheDir, &errorMessage), qPrintable(errorMessage));
+        databaseDirs << (QStringList() << cacheDir + QLatin1String("/mime.cache"));
+    }
+
+    const QString owner = QString::fromLatin1("application/x-qttest-owner");
+    foreach (const QStringList &databaseDir, databaseDirs) {
+        QMimeDatabase db(databaseDir);
+        const QMimeType ownerType = db.mimeTypeForName(owner);
+        QCOMPARE(ownerType.name(), owner);
+        QCOMPARE(ownerType.comment(), QString::fromLatin1("owner"));
+        QCOMPARE(db.mimeTypeForName(QString::fromLatin1("application/x-qttest-collision")).name(), owner);
+        QCOMPARE(db.mimeTypeForName(QString::fromLatin1("application/x-qttest-alias")).name(), owner);
+        QVERIFY(!db.mimeTypeForName(QString::fromLatin1("application/x-qttest-missing")).isValid());
+    }
+}
+
 void tst_QMimeDatabase::icons()
 {
     QMimeDatabase db;
@@ -788,13 +967,272 @@ void tst_QMimeDatabase::fromThreads()
         f.waitForFinished();
 }
 
-static bool runUpdateMimeDatabase(const QString &path) // TODO make it a QMimeDatabase method?
+static QString describeMimeType(const QMimeType &mime)
+{
+    return mime.comment() + QLatin1Char('|') + mime.iconName() + QLatin1Char('|') + mime.genericIconName()
+           + QLatin1Char('|') + mime.globPatterns().join(QLatin1String(","));
+}
+
+void tst_QMimeDatabase::sharedTypeFromThreads()
+{
+    // A database of its own, so that the types are not loaded yet when the threads ask for them
+    QMimeDatabase defaultDb;
+    QMimeDatabase db(QStringList() << m_globalXdgDir + QLatin1String("/mime"));
+    const QStringList names = QStringList() << QString::fromLatin1("text/plain")
+                                            << QString::fromLatin1("image/png")
+                                            << QString::fromLatin1("application/pdf");
+    foreach (const QString &name, names) {
+        const QMimeType mime = db.mimeTypeForName(name);
+        QVERIFY(mime.isValid());
+        QList<QFuture<QString> > futures;
+        for (int i = 0; i < 16; ++i)
+            futures << QtConcurrent::run(describeMimeType, mime);
+        const QString expected = describeMimeType(defaultDb.mimeTypeForName(name));
+        Q_FOREACH (QFuture<QString> f, futures)
+            QCOMPARE(f.result(), expected);
+        QVERIFY(mime == defaultDb.mimeTypeForName(name));
+    }
+}
+
+void tst_QMimeDatabase::statistics()
+{
+    QMimeDatabase db;
+    const QMimeDatabaseStatistics before = db.statistics();
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.txt"), QMimeDatabase::MatchExtension).name(), QString::fromLatin1("text/plain"));
+    QCOMPARE(db.mimeTypeForData(QByteArray("%PDF-")).name(), QString::fromLatin1("application/pdf"));
+    const QMimeDatabaseStatistics after = db.statistics();
+
+    QVERIFY(after.isEnabled());
+    QVERIFY(after.count(QMimeDatabaseStatistics::GlobMatching) > before.count(QMimeDatabaseStatistics::GlobMatching));
+    QVERIFY(after.count(QMimeDatabaseStatistics::MagicMatching) > before.count(QMimeDatabaseStatistics::MagicMatching));
+    QVERIFY(after.count(QMimeDatabaseStatistics::MutexWait) >= before.count(QMimeDatabaseStatistics::MutexWait) + 2);
+    for (int i = 0; i < QMimeDatabaseStatistics::StageCount; ++i) {
+        const QMimeDatabaseStatistics::Stage stage = QMimeDatabaseStatistics::Stage(i);
+        qint64 histogramTotal = 0;
+        foreach (qint64 n, after.histogram(stage))
+            histogramTotal += n;
+        QCOMPARE(histogramTotal, after.count(stage));
+    }
+}
+
+void tst_QMimeDatabase::magicStatistics()
+{
+    QMimeDatabase db;
+    QCOMPARE(db.mimeTypeForData(QByteArray("%PDF-")).name(), QString::fromLatin1("application/pdf"));
+    const QMimeDatabaseStatistics statistics = db.statistics();
+    QVERIFY(statistics.isMagicProfilingEnabled());
+
+    const QList<QMimeDatabaseStatistics::MagicMatcherCounters> matchers = statistics.magicMatcherCounters();
+    QVERIFY(!matchers.isEmpty());
+    int pdf = -1;
+    for (int i = 0; i < matchers.count(); ++i) {
+        const QMimeDatabaseStatistics::MagicMatcherCounters &counters = matchers.at(i);
+        QVERIFY(!counters.mimeType.isEmpty());
+        QVERIFY(counters.evaluations > 0);
+        QVERIFY(counters.ruleEvaluations >= counters.evaluations);
+        QVERIFY(counters.matches <= counters.evaluations);
+        if (i > 0) // most costly first
+            QVERIFY(matchers.at(i - 1).totalTime >= counters.totalTime);
+        if (counters.mimeType == QLatin1String("application/pdf"))
+            pdf = i;
+    }
+    QVERIFY(pdf != -1);
+    const QMimeDatabaseStatistics::MagicMatcherCounters &pdfCounters = matchers.at(pdf);
+    QVERIFY(pdfCounters.priority > 0);
+    QVERIFY(pdfCounters.evaluations > 0);
+    QVERIFY(pdfCounters.matches > 0);
+    QVERIFY(pdfCounters.ruleEvaluations >= pdfCounters.matches);
+    QVERIFY(pdfCounters.bytesCompared > 0);
+    QVERIFY(statistics.toString().contains(QLatin1String("application/pdf (priority")));
+}
+
+void tst_QMimeDatabase::memoryUsage()
+{
+    QMimeDatabase db;
+    QVERIFY(!db.allMimeTypes().isEmpty());
+    QCOMPARE(db.mimeTypeForName(QLatin1String("text/plain")).comment(), QString::fromLatin1("plain text document"));
+    const QMimeDatabaseMemoryUsage usage = db.memoryUsage();
+
+    QVERIFY(usage.heapBytes(QMimeDatabaseMemoryUsage::MimeTypes) > 0);
+    QVERIFY(usage.heapBytes(QMimeDatabaseMemoryUsage::LocaleComments) > 0);
+    qint64 heap = 0;
+    qint64 mapped = 0;
+    for (int i = 0; i < QMimeDatabaseMemoryUsage::ComponentCount; ++i) {
+        const QMimeDatabaseMemoryUsage::Component component = QMimeDatabaseMemoryUsage::Component(i);
+        QVERIFY(!QMimeDatabaseMemoryUsage::componentName(component).isEmpty());
+        heap += usage.heapBytes(component);
+        mapped += usage.mappedBytes(component);
+    }
+    QCOMPARE(usage.totalHeapBytes(), heap);
+    QCOMPARE(usage.totalMappedBytes(), mapped);
+    // Only mime.cache files are mapped
+    QCOMPARE(usage.totalMappedBytes(), usage.mappedBytes(QMimeDatabaseMemoryUsage::CacheFiles));
+}
+
+void tst_QMimeDatabase::localeCommentsMemory()
+{
+    // freedesktop.org.xml has about 40 translations per type, only the ones
+    // comment() looks at (the system language and its short form) are kept
+    QMimeDatabase db(QStringList() << m_globalXdgDir + QLatin1String("/mime"));
+    const QList<QMimeType> mimeTypes = db.allMimeTypes();
+    QVERIFY(mimeTypes.count() > 500);
+    foreach (const QMimeType &mime, mimeTypes)
+        mime.comment();
+    QCOMPARE(db.mimeTypeForName(QLatin1String("text/plain")).comment(), QString::fromLatin1("plain text document"));
+
+    const qint64 comments = db.memoryUsage().heapBytes(QMimeDatabaseMemoryUsage::LocaleComments);
+    qDebug() << mimeTypes.count() << "types," << comments << "bytes of comments";
+    QVERIFY(comments > 0);
+    QVERIFY(comments < mimeTypes.count() * 512);
+}
+
+void tst_QMimeDatabase::warmUp()
+{
+    QMimeDatabase db;
+    db.warmUp(QMimeDatabase::WarmUpFlags());
+    db.warmUp(QMimeDatabase::WarmUpNames | QMimeDatabase::WarmUpMagic);
+    db.warmUp();
+
+    const QMimeDatabaseMemoryUsage usage = db.memoryUsage();
+    QVERIFY(usage.heapBytes(QMimeDatabaseMemoryUsage::MimeTypes) > 0);
+    QVERIFY(usage.heapBytes(QMimeDatabaseMemoryUsage::LocaleComments) > 0);
+
+    const QMimeType plainText = db.mimeTypeForName(QLatin1String("text/plain"));
+    QCOMPARE(plainText.comment(), QString::fromLatin1("plain text document"));
+    QVERIFY(plainText.globPatterns().contains(QLatin1String("*.txt")));
+}
+
+static QStringList mimeTypeNames(QMimeDatabaseClient &client, const QStringList &fileNames, const QByteArray &data)
+{
+    QStringList names;
+    names += client.mimeTypeNamesForFiles(fileNames);
+    names += client.mimeTypeNamesForFiles(fileNames, QMimeDatabase::MatchExtension);
+    names += client.mimeTypeNamesForFiles(fileNames, QMimeDatabase::MatchContent);
+    names += client.mimeTypeNameForData(data);
+    names += client.mimeTypeNameForFileNameAndData(QLatin1String("image.txt"), data);
+    return names;
+}
+
+void tst_QMimeDatabase::databaseClient()
+{
+    QStringList fileNames;
+    fileNames << m_testSuite + QLatin1String("/README.pdf")
+              << m_testSuite + QLatin1String("/editcopy.png")
+              << m_testSuite + QLatin1String("/Makefile")
+              << m_testSuite + QLatin1String("/archive.tar")
+              << m_testSuite
+              << m_testSuite + QLatin1String("/IDontExist.txt");
+    QFile png(m_testSuite + QLatin1String("/editcopy.png"));
+    QVERIFY(png.open(QIODevice::ReadOnly));
+    const QByteArray data = png.readAll();
+
+    QMimeDatabase db;
+    QStringList expected;
+    foreach (const QString &fileName, fileNames)
+        expected += db.mimeTypeForFile(fileName).name();
+    foreach (const QString &fileName, fileNames)
+        expected += db.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension).name();
+    foreach (const QString &fileName, fileNames)
+        expected += db.mimeTypeForFile(fileName, QMimeDatabase::MatchContent).name();
+    expected += db.mimeTypeForData(data).name();
+    expected += db.mimeTypeForFileNameAndData(QLatin1String("image.txt"), data).name();
+
+    const QString socketPath = m_temporaryDir.path() + QLatin1String("/mime-daemon");
+    {
+        // No daemon: answered in this process
+        QMimeDatabaseClient client(socketPath);
+        QVERIFY(!client.isConnected());
+        QCOMPARE(mimeTypeNames(client, fileNames, data), expected);
+    }
+
+#ifdef Q_OS_UNIX
+    const pid_t pid = ::fork();
+    QVERIFY(pid != -1);
+    if (pid == 0) {
+        QMimeDatabase daemonDb;
+        daemonDb.serve(socketPath);
+        ::_exit(1);
+    }
+    bool connected = false;
+    QStringList names;
+    for (int attempt = 0; !connected && attempt < 100; ++attempt) {
+        QMimeDatabaseClient client(socketPath);
+        connected = client.isConnected();
+        if (connected)
+            names = mimeTypeNames(client, fileNames, data);
+        else
+            QTest::qSleep(50);
+    }
+    ::kill(pid, SIGTERM);
+    ::waitpid(pid, 0, 0);
+    QVERIFY(connected);
+    QCOMPARE(names, expected);
+#else
+    QSKIP("The daemon needs Unix domain sockets", SkipSingle);
+#endif
+}
+
+void tst_QMimeDatabase::magicCorpus_data()
+{
+    QTest::addColumn<QString>("filePath");
+    QTest::addColumn<QString>("ruleMimeTypeName");
+    QTest::addColumn<bool>("positive");
+    QTest::addColumn<QString>("recordedMimeTypeName");
+
+    QFile f(m_magicCorpus + QLatin1String("/list"));
+    if (m_magicCorpus.isEmpty() || !f.open(QIODevice::ReadOnly)) {
+        QTest::newRow("no corpus") << QString() << QString() << false << QString();
+        return;
+    }
+
+    while (!f.atEnd()) {
+        const QByteArray line = f.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        // The detected type is empty when it isn't in the package either
+        const QList<QByteArray> fields = line.split(' ');
+        QVERIFY2(fields.size() == 4 || fields.size() == 5, line.constData());
+        QTest::newRow(fields.at(0).constData())
+            << m_magicCorpus + QLatin1Char('/') + QString::fromLatin1(fields.at(0))
+            << QString::fromLatin1(fields.at(1))
+            << (fields.at(2) == "positive")
+            << QString::fromLatin1(fields.value(4));
+    }
+}
+
+void tst_QMimeDatabase::magicCorpus()
+{
+    QFETCH(QString, filePath);
+    QFETCH(QString, ruleMimeTypeName);
+    QFETCH(bool, positive);
+    QFETCH(QString, recordedMimeTypeName);
+    if (filePath.isEmpty())
+        QSKIP("qmime_writeMagicCorpus() is only exported from internal builds", SkipSingle);
+
+    QFile file(filePath);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QMimeDatabase db(QStringList() << m_temporaryDir.path() + QLatin1String("/magic-corpus-xdg/mime"));
+    const QString detected = db.mimeTypeForData(file.readAll()).name();
+    QCOMPARE(detected, recordedMimeTypeName);
+    // A header satisfies its rule path, a near-miss doesn't
+    if (positive)
+        QCOMPARE(detected, ruleMimeTypeName);
+    else
+        QVERIFY2(detected != ruleMimeTypeName, qPrintable(detected));
+}
+
+static bool runUpdateMimeDatabase(const QString &path)
 {
     const QString umdCommand = QString::fromLatin1("update-mime-database");
     const QString umd = QStandardPaths::findExecutable(umdCommand);
     if (umd.isEmpty()) {
-        qWarning("%s does not exist.", qPrintable(umdCommand));
-        return false;
+        QString errorMessage;
+        if (!QMimeDatabase::updateMimeCache(path, &errorMessage)) {
+            qWarning("%s does not exist and updateMimeCache() failed: %s",
+                     qPrintable(umdCommand), qPrintable(errorMessage));
+            return false;
+        }
+        return true;
     }
 
     QProcess proc;
@@ -913,6 +1351,391 @@ void tst_QMimeDatabase::installNewLocalMimeType()
     QVERIFY(!db.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
 }
 
+void tst_QMimeDatabase::explicitDirectories()
+{
+    // A directory of its own, which the default database doesn't know about
+    const QString mimeDir = m_temporaryDir.path() + QLatin1String("/explicit/mime");
+    const QString destDir = mimeDir + QLatin1String("/packages/");
+    QVERIFY(QDir().mkpath(destDir));
+    QVERIFY(QFile::copy(m_yastMimeTypes, destDir + QLatin1String(yastFileName)));
+
+    QMimeDatabase defaultDb;
+    QMimeDatabase db(QStringList() << mimeDir);
+    const QMimeType ymu = db.mimeTypeForFile(QLatin1String("foo.ymu"), QMimeDatabase::MatchExtension);
+    QCOMPARE(ymu.name(), QString::fromLatin1("text/x-suse-ymu"));
+    QCOMPARE(ymu.comment(), QString::fromLatin1("URL of a YaST Meta Package"));
+    QVERIFY(!defaultDb.mimeTypeForName(QLatin1String("text/x-suse-ymu")).isValid());
+
+    // Without freedesktop.org.xml in the directory, the built-in copy is used
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.txt"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/plain"));
+
+    if (!runUpdateMimeDatabase(mimeDir))
+        QSKIP("shared-mime-info not found, skipping mime.cache test", SkipSingle);
+
+    QMimeDatabase cacheDb(QStringList() << mimeDir + QLatin1String("/mime.cache"));
+    const QMimeType ymp = cacheDb.mimeTypeForFile(QLatin1String("foo.ymp"), QMimeDatabase::MatchExtension);
+    QCOMPARE(ymp.name(), QString::fromLatin1("text/x-suse-ymp"));
+    QCOMPARE(ymp.comment(), QString::fromLatin1("YaST Meta Package"));
+    QVERIFY(!defaultDb.mimeTypeForName(QLatin1String("text/x-suse-ymp")).isValid());
+}
+
+void tst_QMimeDatabase::registerMimeTypes()
+{
+    QByteArray tenantOneXml(
+        "<?xml version=\"1.0\"?>\n"
+        "<mime-info xmlns='http://www.freedesktop.org/standards/shared-mime-info'>\n"
+        "  <mime-type type=\"application/x-tenant-one\">\n"
+        "    <comment>Tenant One document</comment>\n"
+        "    <sub-class-of type=\"application/xml\"/>\n"
+        "    <alias type=\"application/x-t1\"/>\n"
+        "    <glob pattern=\"*.tone\"/>\n"
+        "    <magic priority=\"90\"><match type=\"string\" value=\"TONE\" offset=\"0\"/></magic>\n"
+        "  </mime-type>\n"
+        "</mime-info>\n");
+    QByteArray tenantTwoXml(
+        "<?xml version=\"1.0\"?>\n"
+        "<mime-info xmlns='http://www.freedesktop.org/standards/shared-mime-info'>\n"
+        "  <mime-type type=\"text/x-tenant-two\">\n"
+        "    <comment>Tenant Two text</comment>\n"
+        "    <glob pattern=\"*.txt\"/>\n"
+        "  </mime-type>\n"
+        "</mime-info>\n");
+
+    QMimeDatabase db;
+    QMimeDatabase tenantOne(&db);
+    QMimeDatabase tenantTwo(&db);
+    const int installedCount = db.allMimeTypes().count();
+
+    QBuffer tenantOneBuffer(&tenantOneXml);
+    QString errorMessage;
+    QVERIFY2(tenantOne.registerMimeTypes(&tenantOneBuffer, &errorMessage), qPrintable(errorMessage));
+    QVERIFY(!tenantOneBuffer.isOpen()); // initial state was restored
+    QBuffer tenantTwoBuffer(&tenantTwoXml);
+    QVERIFY2(tenantTwo.registerMimeTypes(&tenantTwoBuffer, &errorMessage), qPrintable(errorMessage));
+
+    const QMimeType tone = tenantOne.mimeTypeForFile(QLatin1String("foo.tone"), QMimeDatabase::MatchExtension);
+    QCOMPARE(tone.name(), QString::fromLatin1("application/x-tenant-one"));
+    QCOMPARE(tone.comment(), QString::fromLatin1("Tenant One document"));
+    QVERIFY(tone.inherits(QLatin1String("text/plain"))); // through the installed application/xml
+    QCOMPARE(tenantOne.mimeTypeForName(QLatin1String("application/x-t1")).name(), tone.name());
+    QCOMPARE(tenantOne.mimeTypeForData(QByteArray("TONE and more")).name(), tone.name());
+    QCOMPARE(tenantOne.mimeTypeForFile(QLatin1String("foo.txt"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/plain"));
+    QCOMPARE(tenantOne.allMimeTypes().count(), installedCount + 1);
+
+    // The registered glob wins over the installed one, in that tenant only
+    QCOMPARE(tenantTwo.mimeTypeForFile(QLatin1String("foo.txt"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/x-tenant-two"));
+    QCOMPARE(tenantTwo.mimeTypeForFile(QLatin1String("foo.tone"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/octet-stream"));
+    QVERIFY(!tenantTwo.mimeTypeForName(QLatin1String("application/x-tenant-one")).isValid());
+
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.txt"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/plain"));
+    QVERIFY(!db.mimeTypeForName(QLatin1String("application/x-tenant-one")).isValid());
+    QCOMPARE(db.allMimeTypes().count(), installedCount);
+
+    // Invalid XML registers nothing
+    QByteArray invalidXml("<?xml version=\"1.0\"?>\n<mime-info xmlns='http://www.freedesktop.org/standards/shared-mime-info'>\n"
+                          "  <mime-type type=\"application/x-broken\">\n");
+    QBuffer invalidBuffer(&invalidXml);
+    errorMessage.clear();
+    QVERIFY(!tenantTwo.registerMimeTypes(&invalidBuffer, &errorMessage));
+    QVERIFY(!errorMessage.isEmpty());
+    QVERIFY(!tenantTwo.mimeTypeForName(QLatin1String("application/x-broken")).isValid());
+}
+
+void tst_QMimeDatabase::registeredGlobWeights()
+{
+    QByteArray xml(
+        "<?xml version=\"1.0\"?>\n"
+        "<mime-info xmlns='http://www.freedesktop.org/standards/shared-mime-info'>\n"
+        "  <mime-type type=\"text/x-weak-readme\"><glob weight=\"10\" pattern=\"README*\"/></mime-type>\n"
+        "  <mime-type type=\"application/x-weak-any\"><glob weight=\"10\" pattern=\"*\"/></mime-type>\n"
+        "  <mime-type type=\"application/x-strong-gz\"><glob weight=\"60\" pattern=\"*.gz\"/></mime-type>\n"
+        "</mime-info>\n");
+    QMimeDatabase defaultDb;
+    QMimeDatabase db(&defaultDb);
+    QBuffer buffer(&xml);
+    QString errorMessage;
+    QVERIFY2(db.registerMimeTypes(&buffer, &errorMessage), qPrintable(errorMessage));
+
+    // The registered globs are weighed against the installed ones, not just tried first
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("README.tar.bz2"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/x-bzip-compressed-tar"));
+    QCOMPARE(db.suffixForFileName(QLatin1String("README.tar.bz2")), QString::fromLatin1("tar.bz2"));
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.txt"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/plain"));
+    QCOMPARE(db.mimeTypeForFileName(QByteArray("foo.txt")).name(), QString::fromLatin1("text/plain"));
+    // A heavier registered glob wins over a longer installed one
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.tar.gz"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/x-strong-gz"));
+    // The weak globs still match what nothing else does
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("README"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("text/x-weak-readme"));
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.qtnothing"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/x-weak-any"));
+}
+
+void tst_QMimeDatabase::zipContainers_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<QString>("expectedMimeType");
+
+    QTest::newRow("opendocument") << "ooo-test.odt" << "application/vnd.oasis.opendocument.text";
+    QTest::newRow("epub") << "ocf10-20060911.epub" << "application/epub+zip";
+    QTest::newRow("docx") << "sample.docx" << "application/vnd.openxmlformats-officedocument.wordprocessingml.document";
+    QTest::newRow("xlsx") << "sample.xlsx" << "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet";
+    QTest::newRow("jar") << "test.jar" << "application/x-java-archive";
+    QTest::newRow("plain zip") << "test.zip" << "application/zip";
+}
+
+void tst_QMimeDatabase::zipContainers()
+{
+    QFETCH(QString, fileName);
+    QFETCH(QString, expectedMimeType);
+
+    QMimeDatabase defaultDb;
+    QMimeDatabase db(&defaultDb);
+    QCOMPARE(db.detectionFlags(), QMimeDatabase::DetectionFlags(QMimeDatabase::NoDetectionFlags));
+    db.setDetectionFlags(QMimeDatabase::RefineZipContainers);
+    QCOMPARE(defaultDb.detectionFlags(), QMimeDatabase::DetectionFlags(QMimeDatabase::NoDetectionFlags));
+
+    QFile file(m_testSuite + QLatin1Char('/') + fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(db.mimeTypeForData(&file).name(), expectedMimeType);
+    QCOMPARE(file.pos(), qint64(0));
+    // Without a device, the whole archive is in the data
+    QCOMPARE(db.mimeTypeForData(file.readAll()).name(), expectedMimeType);
+    // The name doesn't help
+    QVERIFY(file.seek(0));
+    QCOMPARE(db.mimeTypeForFileNameAndData(QLatin1String("upload"), &file).name(), expectedMimeType);
+}
+
+void tst_QMimeDatabase::compressedData()
+{
+    QMimeDatabase db;
+    QFile file(m_testSuite + QLatin1String("/text.ps.gz"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+
+    QMimeType innerType;
+    QCOMPARE(db.mimeTypeForData(&file, &innerType).name(), QString::fromLatin1("application/x-gzip"));
+    QCOMPARE(file.pos(), qint64(0));
+    if (!innerType.isValid())
+        QSKIP("QtMimeTypes was built without zlib", SkipSingle);
+    QCOMPARE(innerType.name(), QString::fromLatin1("application/postscript"));
+
+    // Truncated data still gives what was inflated
+    innerType = QMimeType();
+    QCOMPARE(db.mimeTypeForData(file.read(4096), &innerType).name(), QString::fromLatin1("application/x-gzip"));
+    QCOMPARE(innerType.name(), QString::fromLatin1("application/postscript"));
+
+    // Not compressed
+    innerType = db.mimeTypeForName(QLatin1String("text/plain"));
+    QCOMPARE(db.mimeTypeForData(QByteArray("%!PS-Adobe-3.0\n"), &innerType).name(), QString::fromLatin1("application/postscript"));
+    QVERIFY(!innerType.isValid());
+
+    // The first bzip2 block of this one is 20 KB: the peeked 16 KB hold no payload yet
+    QFile bzip2File(m_testSuite + QLatin1String("/text.ps.bz2"));
+    QVERIFY(bzip2File.open(QIODevice::ReadOnly));
+    QVERIFY(bzip2File.size() > 16384);
+    innerType = QMimeType();
+    QCOMPARE(db.mimeTypeForData(&bzip2File, &innerType).name(), QString::fromLatin1("application/x-bzip"));
+    QCOMPARE(bzip2File.pos(), qint64(0));
+    if (!innerType.isValid())
+        QSKIP("QtMimeTypes was built without bzip2", SkipSingle);
+    QCOMPARE(innerType.name(), QString::fromLatin1("application/postscript"));
+    // From memory, only what was given is inflated
+    innerType = QMimeType();
+    QCOMPARE(db.mimeTypeForData(bzip2File.read(16384), &innerType).name(), QString::fromLatin1("application/x-bzip"));
+    QVERIFY(!innerType.isValid());
+}
+
+void tst_QMimeDatabase::detectionBudget()
+{
+    QMimeDatabase db;
+    QFile file(m_testSuite + QLatin1String("/editcopy.png"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray data = file.readAll();
+    const QString png = QString::fromLatin1("image/png");
+
+    QMimeDetectionBudget budget;
+    QVERIFY(budget.isUnlimited());
+    bool exhausted = true;
+    QCOMPARE(db.mimeTypeForData(data, budget, &exhausted).name(), png);
+    QVERIFY(!exhausted);
+
+    // Enough for the rules of PNG
+    budget.setMaxBytes(1024);
+    budget.setMaxRuleEvaluations(1000000);
+    budget.setMaxTime(60000);
+    QVERIFY(!budget.isUnlimited());
+    QCOMPARE(db.mimeTypeForData(data, budget, &exhausted).name(), png);
+
+    // No rule at all: what is left is the default type
+    QMimeDetectionBudget noRules;
+    noRules.setMaxRuleEvaluations(0);
+    QCOMPARE(db.mimeTypeForData(data, noRules, &exhausted).name(), QString::fromLatin1("application/octet-stream"));
+    QVERIFY(exhausted);
+
+    // Less data than the rules look at
+    QMimeDetectionBudget fewBytes = noRules;
+    fewBytes.setMaxRuleEvaluations(-1);
+    fewBytes.setMaxBytes(4);
+    QCOMPARE(noRules.maxRuleEvaluations(), 0);
+    QCOMPARE(noRules.maxBytes(), -1);
+    exhausted = false;
+    QVERIFY(db.mimeTypeForData(data, fewBytes, &exhausted).isValid());
+    QVERIFY(exhausted);
+
+    // Only the budgeted bytes are read from the device
+    QVERIFY(file.seek(0));
+    exhausted = false;
+    QVERIFY(db.mimeTypeForData(&file, fewBytes, &exhausted).isValid());
+    QVERIFY(exhausted);
+    QCOMPARE(file.pos(), qint64(0));
+
+    // The name decides, the budget doesn't matter
+    exhausted = true;
+    QCOMPARE(db.mimeTypeForFileNameAndData(QLatin1String("editcopy.png"), &file, noRules, &exhausted).name(), png);
+    QVERIFY(!exhausted);
+    QCOMPARE(db.mimeTypeForFileNameAndData(QLatin1String("upload"), &file, budget, &exhausted).name(), png);
+    QVERIFY(!exhausted);
+}
+
+void tst_QMimeDatabase::adaptiveMagicOrder()
+{
+    // The directory of the default database, loaded again with an order of its own
+    QMimeDatabase defaultDb;
+    QMimeDatabase db(QStringList() << m_globalXdgDir + QLatin1String("/mime"));
+    db.setDetectionFlags(QMimeDatabase::AdaptiveMagicOrder);
+    QCOMPARE(defaultDb.detectionFlags(), QMimeDatabase::DetectionFlags(QMimeDatabase::NoDetectionFlags));
+
+    const QDir testSuite(m_testSuite);
+    QList<QByteArray> samples;
+    QStringList expectedMimeTypes;
+    foreach (const QString &fileName, testSuite.entryList(QDir::Files)) {
+        QFile file(testSuite.filePath(fileName));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        samples.append(file.read(16384));
+        expectedMimeTypes.append(defaultDb.mimeTypeForData(samples.last()).name());
+    }
+    QFile pngFile(m_testSuite + QLatin1String("/editcopy.png"));
+    QVERIFY(pngFile.open(QIODevice::ReadOnly));
+    const QByteArray png = pngFile.readAll();
+    const QString pngName = QString::fromLatin1("image/png");
+
+    // The order is built by the first detection, a single hit doesn't change it
+    QCOMPARE(db.mimeTypeForData(png).name(), pngName);
+#ifdef QMIME_BUILD_INTERNAL
+    const QStringList initialOrder = qmime_adaptiveMagicOrder(db);
+    QVERIFY(initialOrder.contains(pngName));
+#endif
+
+    // PNG moves up within its priority, and every answer stays the same
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 500; ++i)
+            QCOMPARE(db.mimeTypeForData(png).name(), pngName);
+        QThreadPool::globalInstance()->waitForDone();
+        for (int i = 0; i < samples.count(); ++i)
+            QCOMPARE(db.mimeTypeForData(samples.at(i)).name(), expectedMimeTypes.at(i));
+    }
+
+#ifdef QMIME_BUILD_INTERNAL
+    const QStringList learnedOrder = qmime_adaptiveMagicOrder(db);
+    qDebug() << pngName << "moved from" << initialOrder.indexOf(pngName) << "to" << learnedOrder.indexOf(pngName);
+    QCOMPARE(learnedOrder.count(), initialOrder.count());
+    QVERIFY(learnedOrder.indexOf(pngName) < initialOrder.indexOf(pngName));
+#else
+    QSKIP("Needs an internal build (CONFIG+=mime_build_internal) to look at the order", SkipSingle);
+#endif
+}
+
+void tst_QMimeDatabase::fastPatterns()
+{
+    QByteArray xml(
+        "<?xml version=\"1.0\"?>\n"
+        "<mime-info xmlns='http://www.freedesktop.org/standards/shared-mime-info'>\n"
+        "  <mime-type type=\"application/x-fast-one\"><glob pattern=\"*.qtfast\"/></mime-type>\n"
+        "  <mime-type type=\"application/x-fast-two\"><glob pattern=\"*.qtfast\"/></mime-type>\n"
+        "  <mime-type type=\"application/x-fast-three\"><glob pattern=\"*.QtFast\"/></mime-type>\n"
+        "  <mime-type type=\"application/x-fast-four\"><glob pattern=\"*.qtfast\"/></mime-type>\n"
+        "  <mime-type type=\"application/x-fast-latin1\"><glob pattern=\"*.qtcaf\xc3\xa9\"/></mime-type>\n"
+        "  <mime-type type=\"application/x-fast-long\"><glob pattern=\"*.qtmorethanfifteenchars\"/></mime-type>\n"
+        "  <mime-type type=\"application/x-fast-cyrillic\"><glob pattern=\"*.qt\xd1\x84\xd0\xb0\xd0\xb9\xd0\xbb\"/></mime-type>\n"
+        "</mime-info>\n");
+
+    QMimeDatabase defaultDb;
+    QMimeDatabase db(&defaultDb);
+    QBuffer buffer(&xml);
+    QString errorMessage;
+    QVERIFY2(db.registerMimeTypes(&buffer, &errorMessage), qPrintable(errorMessage));
+
+    // More types than fit in a slot of the table, in any case
+    QStringList names;
+    foreach (const QMimeType &mime, db.mimeTypesForFileName(QLatin1String("foo.QTFAST")))
+        names.append(mime.name());
+    names.sort();
+    QCOMPARE(names, QStringList() << QLatin1String("application/x-fast-four") << QLatin1String("application/x-fast-one")
+                                  << QLatin1String("application/x-fast-three") << QLatin1String("application/x-fast-two"));
+
+    // Latin-1, lowercased while looking it up
+    QCOMPARE(db.mimeTypeForFile(QString::fromUtf8("CAFE.QTCAF\xc3\x89"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/x-fast-latin1"));
+    // Extensions that don't fit in the table
+    QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.QtMoreThanFifteenChars"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/x-fast-long"));
+    QCOMPARE(db.mimeTypeForFile(QString::fromUtf8("foo.QT\xd0\xa4\xd0\x90\xd0\x99\xd0\x9b"), QMimeDatabase::MatchExtension).name(),
+             QString::fromLatin1("application/x-fast-cyrillic"));
+    QVERIFY(db.mimeTypesForFileName(QLatin1String("foo.qtfas")).isEmpty());
+    QVERIFY(db.mimeTypesForFileName(QLatin1String("foo.qtfast.")).isEmpty());
+}
+
+void tst_QMimeDatabase::generatedMimeCache()
+{
+    if (!qgetenv("QT_NO_MIME_CACHE").isEmpty())
+        QSKIP("mime.cache is disabled", SkipSingle);
+
+    // The same package files, once parsed and once compiled by updateMimeCache()
+    const QString packageFile = m_globalXdgDir + QLatin1String("/mime/packages/freedesktop.org.xml");
+    const QString xmlDir = m_temporaryDir.path() + QLatin1String("/generated-xml/mime");
+    const QString cacheDir = m_temporaryDir.path() + QLatin1String("/generated-cache/mime");
+    QVERIFY(QDir().mkpath(xmlDir + QLatin1String("/packages")));
+    QVERIFY(QDir().mkpath(cacheDir + QLatin1String("/packages")));
+    foreach (const QString &dir, QStringList() << xmlDir << cacheDir) {
+        QVERIFY(QFile::copy(packageFile, dir + QLatin1String("/packages/freedesktop.org.xml")));
+        QVERIFY(QFile::copy(m_yastMimeTypes, dir + QLatin1String("/packages/") + QLatin1String(yastFileName)));
+    }
+    QString errorMessage;
+    QVERIFY2(QMimeDatabase::updateMimeCache(cacheDir, &errorMessage), qPrintable(errorMessage));
+    QVERIFY(!QFile::exists(cacheDir + QLatin1String("/mime.cache.new")));
+
+    QMimeDatabase xmlDb(QStringList() << xmlDir);
+    QMimeDatabase cacheDb(QStringList() << cacheDir + QLatin1String("/mime.cache"));
+    QCOMPARE(cacheDb.allMimeTypes().count(), xmlDb.allMimeTypes().count());
+
+    const QMimeType ymu = cacheDb.mimeTypeForFile(QLatin1String("foo.ymu"), QMimeDatabase::MatchExtension);
+    QCOMPARE(ymu.name(), QString::fromLatin1("text/x-suse-ymu"));
+    QCOMPARE(cacheDb.mimeTypeForName(QLatin1String("application/x-pdf")).name(), QString::fromLatin1("application/pdf"));
+    QCOMPARE(cacheDb.mimeTypeForName(QLatin1String("application/x-shellscript")).parentMimeTypes(),
+             xmlDb.mimeTypeForName(QLatin1String("application/x-shellscript")).parentMimeTypes());
+    QCOMPARE(cacheDb.mimeTypeForName(QLatin1String("text/plain")).genericIconName(),
+             xmlDb.mimeTypeForName(QLatin1String("text/plain")).genericIconName());
+
+    // Globs and magic give the same answers
+    const QDir testSuite(m_testSuite);
+    foreach (const QString &fileName, testSuite.entryList(QDir::Files)) {
+        const QString filePath = testSuite.filePath(fileName);
+        QFile file(filePath);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray data = file.read(16384);
+        QCOMPARE(cacheDb.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension).name(),
+                 xmlDb.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension).name());
+        QCOMPARE(cacheDb.mimeTypeForData(data).name(), xmlDb.mimeTypeForData(data).name());
+    }
+}
+
 #define QTEST_GUILESS_MAIN(TestObject) \
 int main(int argc, char *argv[]) \
 { \
@@ -59,10 +59,14 @@ private slots:
     void mimeTypeForName();
     void mimeTypeForFileName_data();
     void mimeTypeForFileName();
+    void mimeTypeForEncodedFileName_data();
+    void mimeTypeForEncodedFileName();
     void mimeTypesForFileName_data();
     void mimeTypesForFileName();
     void inheritance();
     void aliases();
+    void nameIndex();
+    void aliasNameCollision();
     void icons();
     void mimeTypeForFileWithContent();
     void mimeTypeForUrl();
@@ -76,6 +80,15 @@ private slots:
     void suffixes();
     void knownSuffix();
     void fromThreads();
+    void sharedTypeFromThreads();
+    void statistics();
+    void magicStatistics();
+    void memoryUsage();
+    void localeCommentsMemory();
+    void warmUp();
+    void databaseClient();
+    void magicCorpus_data();
+    void magicCorpus();
 
     // shared-mime-info test suite
 
@@ -92,6 +105,16 @@ private slots:
 
     void installNewGlobalMimeType();
     void installNewLocalMimeType();
+    void explicitDirectories();
+    void registerMimeTypes();
+    void registeredGlobWeights();
+    void fastPatterns();
+    void generatedMimeCache();
+    void zipContainers_data();
+    void zipContainers();
+    void compressedData();
+    void detectionBudget();
+    void adaptiveMagicOrder();
 
 private:
     void init(); // test-specific
@@ -101,6 +124,7 @@ private:
     QString m_yastMimeTypes;
     QDir m_temporaryDir;
     QString m_testSuite;
+    QString m_magicCorpus; // empty if the library doesn't export qmime_writeMagicCorpus()
 };
 
 #endif   // TST_QMIMEDATABASE_H
@@ -0,0 +1,30 @@
+include(../../../../mimetypes-nolibs.pri)
+LIBS += -L$$OUT_PWD/../../../../src/mimetypes -lQtMimeTypes
+
+TEMPLATE = app
+
+TARGET = tst_bench_qmimedatabase-cache
+
+QT       += testlib
+
+QT       -= widgets gui
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+CONFIG += depend_includepath
+
+SOURCES = tst_bench_qmimedatabase-cache.cpp
+HEADERS = ../tst_bench_qmimedatabase.h
+
+DEFINES += SRCDIR='"\\"$$PWD/../../../auto/qmimedatabase/\\""'
+
+# Results are written in testlib's XML format (one BenchmarkResult element per
+# function and data tag), so that runs can be compared by scripts.
+QMAKE_EXTRA_TARGETS += benchmark
+benchmark.depends = $$TARGET
+benchmark.commands = LD_LIBRARY_PATH=$$(LD_LIBRARY_PATH):$$OUT_PWD/../../../../src/mimetypes ./$$TARGET -xml -o $${TARGET}.xml
+
+DEFINES += CORE_SOURCES='"\\"$$PWD/../../../../src\\""'
+
+*-g++*:QMAKE_CXXFLAGS += -W -Wall -Wextra -Wnon-virtual-dtor
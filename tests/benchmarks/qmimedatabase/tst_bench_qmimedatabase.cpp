@@ -0,0 +1,426 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <qmimedatabase.h>
+#include "qmimedatabase_p.h"
+
+#include "qstandardpaths.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFileInfo>
+#include <QtCore/QProcess>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtCore/QXmlStreamReader>
+
+#include <QtTest/QtTest>
+
+// Environment variable naming a directory of sample files to use as the header corpus
+// instead of the shared-mime-info test files, typically written by tools/mimecorpusgen.
+static const char headerCorpusEnvironmentVariable[] = "QT_MIME_CORPUS";
+
+// Each file name synthesized from a glob pattern is classified under that many directories,
+// so that the corpus is large enough to dwarf the per-iteration overhead.
+static const int fileNameCopies = 16;
+
+// One name in that many of the mostly-miss corpus matches a glob pattern, the others
+// are hashes, temporary files and extensionless blobs matching nothing.
+static const int matchingNameInterval = 10;
+
+// Amount of data read from each sample file, the same as QMimeDatabase peeks from a device.
+static const int headerSize = 16384;
+
+static int initializeLang()
+{
+    qputenv("LC_ALL", "");
+    qputenv("LANG", "C");
+    QCoreApplication::setApplicationName("tst_bench_qmimedatabase"); // temporary directory pattern
+    return 1;
+}
+
+// Set LANG before QCoreApplication is created
+#ifndef Q_CONSTRUCTOR_FUNCTION
+#define Q_CONSTRUCTOR_FUNCTION0(initalizeLang) \
+ static const void initalizeLang ## __init_lang__ = initializeLang();
+#define Q_CONSTRUCTOR_FUNCTION(initalizeLang) Q_CONSTRUCTOR_FUNCTION0(initalizeLang)
+#endif
+Q_CONSTRUCTOR_FUNCTION(initializeLang)
+
+static bool runUpdateMimeDatabase(const QString &path)
+{
+    const QString umdCommand = QString::fromLatin1("update-mime-database");
+    const QString umd = QStandardPaths::findExecutable(umdCommand);
+    if (umd.isEmpty()) {
+        qWarning("%s does not exist.", qPrintable(umdCommand));
+        return false;
+    }
+
+    QProcess proc;
+    proc.setProcessChannelMode(QProcess::MergedChannels); // silence output
+    proc.start(umd, QStringList(path));
+    if (!proc.waitForStarted()) {
+        qWarning("Cannot start %s: %s",
+                 qPrintable(umd), qPrintable(proc.errorString()));
+        return false;
+    }
+    proc.waitForFinished();
+    return true;
+}
+
+// Turns a glob pattern into a file name matching it, or returns an empty string
+// for the few patterns using character classes.
+static QString fileNameForPattern(const QString &pattern)
+{
+    if (pattern.contains(QLatin1Char('[')))
+        return QString();
+    QString fileName = pattern;
+    fileName.replace(QLatin1Char('*'), QLatin1String("name"));
+    fileName.replace(QLatin1Char('?'), QLatin1Char('x'));
+    return fileName;
+}
+
+// A name matching no glob pattern, like those of content-addressed stores and temporary files
+static QString unmatchedFileName(int i)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+    uint seed = 2654435761u * uint(i + 1);
+    QString name;
+    switch (i % 3) {
+    case 0: // a SHA-1
+        for (int j = 0; j < 40; ++j, seed = seed * 1103515245u + 12345u)
+            name += QLatin1Char(hexDigits[(seed >> 16) & 0xf]);
+        break;
+    case 1:
+        name = QLatin1String("tmp");
+        for (int j = 0; j < 6; ++j, seed = seed * 1103515245u + 12345u)
+            name += QLatin1Char(char('a' + (seed >> 16) % 26));
+        break;
+    default:
+        name = QString::fromLatin1("blob%1").arg(seed % 100000);
+        break;
+    }
+    return name;
+}
+
+static int classify(const QStringList &fileNames, const QList<QByteArray> &headers)
+{
+    QMimeDatabase db;
+    int valid = 0;
+    foreach (const QString &fileName, fileNames)
+        valid += db.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension).isValid();
+    foreach (const QByteArray &header, headers)
+        valid += db.mimeTypeForData(header).isValid();
+    return valid;
+}
+
+class ClassifyRunnable : public QRunnable
+{
+public:
+    ClassifyRunnable(const QStringList &fileNames, const QList<QByteArray> &headers)
+        : m_fileNames(fileNames), m_headers(headers)
+    {}
+
+    void run()
+    {
+        classify(m_fileNames, m_headers);
+    }
+
+private:
+    const QStringList &m_fileNames;
+    const QList<QByteArray> &m_headers;
+};
+
+tst_QMimeDatabaseBenchmark::tst_QMimeDatabaseBenchmark()
+{
+}
+
+void tst_QMimeDatabaseBenchmark::initTestCase()
+{
+    QTemporaryFile _name;
+    QString _dirName;
+    if (_name.open()) {
+        _dirName = QFileInfo(_name.fileName()).absoluteFilePath();
+        _name.remove();
+    }
+    QVERIFY(QDir().mkdir(_dirName));
+
+    m_temporaryDir.setPath(_dirName);
+
+    // Same layout as the unit test: a "global" XDG data dir holding a copy of
+    // freedesktop.org.xml, and an empty "local" one.
+
+    const QDir here = QDir(_dirName);
+
+    m_globalXdgDir = m_temporaryDir.path() + QLatin1String("/global");
+    m_localXdgDir = m_temporaryDir.path() + QLatin1String("/local");
+
+    const QString globalPackageDir = m_globalXdgDir + QLatin1String("/mime/packages");
+    QVERIFY(here.mkpath(globalPackageDir) && here.mkpath(m_localXdgDir));
+
+    qputenv("XDG_DATA_DIRS", QFile::encodeName(m_globalXdgDir));
+    qputenv("XDG_DATA_HOME", QFile::encodeName(m_localXdgDir));
+
+    const QString freeDesktopXml = QLatin1String("freedesktop.org.xml");
+    const QString xmlFileName = QLatin1String(CORE_SOURCES)
+                          + QLatin1String("/mimetypes/mime/packages/")
+                          + freeDesktopXml;
+    QFile xml(xmlFileName);
+    QVERIFY2(xml.copy(globalPackageDir + QLatin1Char('/') + freeDesktopXml), qPrintable(xmlFileName));
+
+    // The corpora are derived from the XML directly, so that they do not depend on
+    // the provider being measured.
+    QVERIFY(xml.open(QIODevice::ReadOnly));
+    QStringList patternFileNames;
+    QXmlStreamReader reader(&xml);
+    while (!reader.atEnd()) {
+        if (reader.readNext() != QXmlStreamReader::StartElement)
+            continue;
+        const QXmlStreamAttributes atts = reader.attributes();
+        if (reader.name() == QLatin1String("mime-type")) {
+            m_names.append(atts.value(QLatin1String("type")).toString());
+        } else if (reader.name() == QLatin1String("alias")) {
+            m_aliases.append(atts.value(QLatin1String("type")).toString());
+        } else if (reader.name() == QLatin1String("glob")) {
+            const QString fileName = fileNameForPattern(atts.value(QLatin1String("pattern")).toString());
+            if (!fileName.isEmpty())
+                patternFileNames.append(fileName);
+        }
+    }
+    QVERIFY2(!reader.hasError(), qPrintable(reader.errorString()));
+    QVERIFY(!m_names.isEmpty() && !m_aliases.isEmpty() && !patternFileNames.isEmpty());
+
+    for (int copy = 0; copy < fileNameCopies; ++copy) {
+        const QString dir = QString::fromLatin1("/home/user/dir%1/").arg(copy);
+        foreach (const QString &fileName, patternFileNames) {
+            m_fileNames.append(dir + fileName);
+            m_missingFileNames.append(dir + fileName + QLatin1String(".unknown") + QString::number(copy));
+        }
+    }
+    for (int i = 0; i < m_fileNames.count(); ++i) {
+        if (i % matchingNameInterval == 0)
+            m_mostlyUnmatchedFileNames.append(m_fileNames.at(i));
+        else
+            m_mostlyUnmatchedFileNames.append(QLatin1String("/var/cache/objects/") + unmatchedFileName(i));
+    }
+
+    QString corpusDir = QFile::decodeName(qgetenv(headerCorpusEnvironmentVariable));
+    if (corpusDir.isEmpty())
+        corpusDir = QLatin1String(SRCDIR "testfiles");
+    QDirIterator it(corpusDir, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QFile file(it.next());
+        if (it.fileName() == QLatin1String("list")) // the manifest
+            continue;
+        if (file.open(QIODevice::ReadOnly))
+            m_headers.append(file.read(headerSize));
+    }
+    QVERIFY2(!m_headers.isEmpty(), qPrintable(corpusDir + QLatin1String(" contains no files.")));
+    qDebug() << m_names.count() << "types," << m_aliases.count() << "aliases,"
+             << m_fileNames.count() << "file names," << m_headers.count() << "headers from" << corpusDir;
+
+    init();
+}
+
+void tst_QMimeDatabaseBenchmark::coldStart()
+{
+    // Measures loading the provider and answering a first glob and magic query.
+    // Note that the files involved are in the page cache after the first iteration.
+#ifndef QMIME_BUILD_INTERNAL
+    QSKIP("Needs an internal build (CONFIG+=mime_build_internal) for qmime_resetProvider()", SkipSingle);
+#else
+    QMimeDatabase db;
+    QBENCHMARK {
+        qmime_resetProvider();
+        QCOMPARE(db.mimeTypeForFile(QLatin1String("foo.txt"), QMimeDatabase::MatchExtension).name(),
+                 QString::fromLatin1("text/plain"));
+        QCOMPARE(db.mimeTypeForData(QByteArray("%PDF-")).name(), QString::fromLatin1("application/pdf"));
+    }
+#endif
+}
+
+void tst_QMimeDatabaseBenchmark::mimeTypeForName()
+{
+    QMimeDatabase db;
+    QBENCHMARK {
+        foreach (const QString &name, m_names)
+            db.mimeTypeForName(name);
+    }
+}
+
+void tst_QMimeDatabaseBenchmark::aliases()
+{
+    QMimeDatabase db;
+    QBENCHMARK {
+        foreach (const QString &alias, m_aliases)
+            db.mimeTypeForName(alias);
+    }
+}
+
+void tst_QMimeDatabaseBenchmark::mimeTypeForFileName_data()
+{
+    QTest::addColumn<QStringList>("fileNames");
+
+    QTest::newRow("matching") << m_fileNames;
+    QTest::newRow("missing") << m_missingFileNames;
+    QTest::newRow("mostly unmatched") << m_mostlyUnmatchedFileNames;
+}
+
+void tst_QMimeDatabaseBenchmark::mimeTypeForFileName()
+{
+    QFETCH(QStringList, fileNames);
+
+    QMimeDatabase db;
+    QBENCHMARK {
+        foreach (const QString &fileName, fileNames)
+            db.mimeTypeForFile(fileName, QMimeDatabase::MatchExtension);
+    }
+}
+
+void tst_QMimeDatabaseBenchmark::mimeTypeForData_data()
+{
+    QTest::addColumn<int>("flags");
+
+    QTest::newRow("file order") << int(QMimeDatabase::NoDetectionFlags);
+    QTest::newRow("adaptive order") << int(QMimeDatabase::AdaptiveMagicOrder);
+}
+
+void tst_QMimeDatabaseBenchmark::mimeTypeForData()
+{
+    QFETCH(int, flags);
+
+    QMimeDatabase db;
+    const QMimeDatabase::DetectionFlags defaultFlags = db.detectionFlags();
+    db.setDetectionFlags(QMimeDatabase::DetectionFlags(flags));
+    QBENCHMARK {
+        foreach (const QByteArray &header, m_headers)
+            db.mimeTypeForData(header);
+    }
+    db.setDetectionFlags(defaultFlags);
+}
+
+void tst_QMimeDatabaseBenchmark::allMimeTypes()
+{
+    QMimeDatabase db;
+    QBENCHMARK {
+        QVERIFY(!db.allMimeTypes().isEmpty());
+    }
+}
+
+void tst_QMimeDatabaseBenchmark::comment()
+{
+    QMimeDatabase db;
+    const QList<QMimeType> mimeTypes = db.allMimeTypes();
+    QBENCHMARK {
+        foreach (const QMimeType &mime, mimeTypes)
+            mime.comment();
+    }
+}
+
+void tst_QMimeDatabaseBenchmark::threadedThroughput_data()
+{
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("1") << 1;
+    QTest::newRow("2") << 2;
+    QTest::newRow("4") << 4;
+    QTest::newRow("8") << 8;
+    QTest::newRow("16") << 16;
+}
+
+void tst_QMimeDatabaseBenchmark::threadedThroughput()
+{
+    // Every thread classifies the whole corpus, so with perfect scaling the time
+    // per iteration stays the same whatever the number of threads.
+    QFETCH(int, threads);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    QBENCHMARK {
+        for (int i = 0; i < threads; ++i)
+            pool.start(new ClassifyRunnable(m_fileNames, m_headers));
+        pool.waitForDone();
+    }
+}
+
+void tst_QMimeDatabaseBenchmark::memoryUsage_data()
+{
+    QTest::addColumn<int>("component");
+    QTest::addColumn<bool>("mapped");
+
+    for (int i = 0; i < QMimeDatabaseMemoryUsage::ComponentCount; ++i) {
+        const QMimeDatabaseMemoryUsage::Component component = QMimeDatabaseMemoryUsage::Component(i);
+        const QByteArray name = QMimeDatabaseMemoryUsage::componentName(component).toLatin1();
+        QTest::newRow(QByteArray(name + " heap").constData()) << i << false;
+        QTest::newRow(QByteArray(name + " mapped").constData()) << i << true;
+    }
+}
+
+void tst_QMimeDatabaseBenchmark::memoryUsage()
+{
+    // Not timed: the result is the number of bytes after the whole corpus was
+    // classified and all comments were read, which loads everything there is.
+    // Qt 4 has no byte metric, so they are reported as events.
+    QFETCH(int, component);
+    QFETCH(bool, mapped);
+
+    QMimeDatabase db;
+    foreach (const QMimeType &mime, db.allMimeTypes())
+        mime.comment();
+    classify(m_fileNames, m_headers);
+
+    const QMimeDatabaseMemoryUsage usage = db.memoryUsage();
+    if (component == 0 && !mapped)
+        qDebug("%s", qPrintable(usage.toString()));
+    QVERIFY(usage.totalHeapBytes() > 0);
+    const QMimeDatabaseMemoryUsage::Component c = QMimeDatabaseMemoryUsage::Component(component);
+    QTest::setBenchmarkResult(mapped ? usage.mappedBytes(c) : usage.heapBytes(c), QTest::Events);
+}
+
+#define QTEST_GUILESS_MAIN(TestObject) \
+int main(int argc, char *argv[]) \
+{ \
+    QCoreApplication app(argc, argv); \
+    TestObject tc; \
+    return QTest::qExec(&tc, argc, argv); \
+}
+
+QTEST_GUILESS_MAIN(tst_QMimeDatabaseBenchmark)
@@ -0,0 +1,89 @@
+/****************************************************************************
+**
+** Copyright (C) 2013 Digia Plc and/or its subsidiary(-ies).
+** Contact: http://www.qt-project.org/legal
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and Digia.  For licensing terms and
+** conditions see http://qt.digia.com/licensing.  For further information
+** use the contact form at http://qt.digia.com/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 as published by the Free Software
+** Foundation and appearing in the file LICENSE.LGPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU Lesser General Public License version 2.1 requirements
+** will be met: http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** In addition, as a special exception, Digia gives you certain additional
+** rights.  These rights are described in the Digia Qt LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3.0 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.  Please review the following information to
+** ensure the GNU General Public License version 3.0 requirements will be
+** met: http://www.gnu.org/copyleft/gpl.html.
+**
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef TST_BENCH_QMIMEDATABASE_H
+#define TST_BENCH_QMIMEDATABASE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QByteArray>
+#include <QtCore/QDir>
+#include <QtCore/QList>
+#include <QtCore/QStringList>
+
+class tst_QMimeDatabaseBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_QMimeDatabaseBenchmark();
+
+private slots:
+    void initTestCase();
+
+    void coldStart();
+    void mimeTypeForName();
+    void aliases();
+    void mimeTypeForFileName_data();
+    void mimeTypeForFileName();
+    void mimeTypeForData_data();
+    void mimeTypeForData();
+    void allMimeTypes();
+    void comment();
+    void threadedThroughput_data();
+    void threadedThroughput();
+    void memoryUsage_data();
+    void memoryUsage();
+
+private:
+    void init(); // provider specific setup, see the qmimedatabase-xml and qmimedatabase-cache subdirs
+
+    QDir m_temporaryDir;
+    QString m_globalXdgDir;
+    QString m_localXdgDir;
+    QStringList m_names;
+    QStringList m_aliases;
+    QStringList m_fileNames;
+    QStringList m_missingFileNames;
+    QStringList m_mostlyUnmatchedFileNames;
+    QList<QByteArray> m_headers;
+};
+
+#endif   // TST_BENCH_QMIMEDATABASE_H
@@ -0,0 +1,56 @@
+#include "qmimedatabase.h"
+#include "qmimemagiccorpus_p.h"
+
+#include "qstandardpaths.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QStringList>
+
+#include <stdio.h>
+
+/*
+   Writes one minimal header per path through the magic rule trees, and its near-miss,
+   with qmime_writeMagicCorpus(). The library has to be an internal build, see
+   mimetypes-nolibs.pri.
+ */
+
+static QStringList defaultPackageFiles()
+{
+    QStringList result;
+    const QStringList packageDirs = QStandardPaths::locateAll(QStandardPaths::GenericDataLocation, QLatin1String("mime/packages"), QStandardPaths::LocateDirectory);
+    QListIterator<QString> dirIter(packageDirs);
+    dirIter.toBack();
+    while (dirIter.hasPrevious()) { // global first, then local.
+        const QString packageDir = dirIter.previous();
+        foreach (const QString &file, QDir(packageDir).entryList(QStringList() << QLatin1String("*.xml"), QDir::Files))
+            result.append(packageDir + QLatin1Char('/') + file);
+    }
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+    args.removeFirst();
+    if (args.isEmpty()) {
+        printf("Usage: mimecorpusgen <output directory> [package.xml ...]\n");
+        return 1;
+    }
+    const QString outputDir = args.takeFirst();
+    const QStringList packageFiles = args.isEmpty() ? defaultPackageFiles() : args;
+
+    QMimeDatabase db;
+    QMimeMagicCorpusCounts counts;
+    QString errorMessage;
+    if (!qmime_writeMagicCorpus(outputDir, packageFiles, db, &counts, &errorMessage)) {
+        fprintf(stderr, "%s\n", qPrintable(errorMessage));
+        return 1;
+    }
+
+    printf("%d positive and %d negative samples written to %s, %d rule paths could not be satisfied\n",
+           counts.positives, counts.negatives, qPrintable(outputDir), counts.unsatisfiable);
+    return 0;
+}
@@ -0,0 +1,17 @@
+include(../../mimetypes-nolibs.pri)
+
+QT       = core
+
+TEMPLATE = app
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+# qmime_writeMagicCorpus() is only exported from internal builds of the library
+LIBS += -L$$OUT_PWD/../../src/mimetypes -lQtMimeTypes
+
+CONFIG += depend_includepath
+
+SOURCES += main.cpp
+
+QMAKE_CXXFLAGS += -W -Wall -Wextra -Wshadow -Wnon-virtual-dtor
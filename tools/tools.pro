@@ -0,0 +1,6 @@
+TEMPLATE = subdirs
+
+SUBDIRS += updatemimecache
+
+# Needs the QMIME_AUTOTEST_EXPORT symbols, see mimetypes-nolibs.pri
+CONFIG(debug, debug|release)|mime_build_internal: SUBDIRS += mimecorpusgen
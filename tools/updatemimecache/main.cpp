@@ -0,0 +1,37 @@
+#include "qmimedatabase.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+
+#include <stdio.h>
+
+/*
+   Stand-in for update-mime-database where shared-mime-info is not installed:
+   compiles <mime directory>/packages/*.xml into mime.cache and types.
+ */
+
+static void usage()
+{
+    fprintf(stderr, "Usage: updatemimecache <mime directory>...\n");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    const QStringList directories = app.arguments().mid(1);
+    if (directories.isEmpty()) {
+        usage();
+        return 1;
+    }
+
+    int result = 0;
+    foreach (const QString &directory, directories) {
+        QString errorMessage;
+        if (!QMimeDatabase::updateMimeCache(directory, &errorMessage)) {
+            fprintf(stderr, "updatemimecache: %s\n", qPrintable(errorMessage));
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,15 @@
+QT       = core
+
+TEMPLATE = app
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+LIBS += -L$$OUT_PWD/../../src/mimetypes -lQtMimeTypes
+
+INCLUDEPATH *= $$PWD/../../include/QtMimeTypes
+CONFIG += depend_includepath
+
+SOURCES += main.cpp
+
+QMAKE_CXXFLAGS += -W -Wall -Wextra -Wshadow -Wnon-virtual-dtor